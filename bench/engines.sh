@@ -0,0 +1,86 @@
+#!/bin/sh
+#
+# MIT License
+#
+# Copyright (c) 2019 Philip Kovacs
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# Compare summa's panel engines, broadcasts and one-sided MPI_Rget, with
+# and without a deliberately slow process: rank 0 runs its local multiply
+# with the scalar micro-kernel (--slow 0). With broadcasts every rank of
+# the slow rank's row and column waits for it at each panel; with MPI_Rget
+# only the ranks that need its panels wait, and only when they run out of
+# panels fetched ahead.
+#
+# usage: engines.sh <build directory> [output.csv]
+#
+# Each run is a CSV row of the engine, whether a rank was slowed, and the
+# minimum, mean and maximum time of the multiply loop over the processes,
+# in seconds, with the GFLOP/s of the slowest.
+#
+
+BUILD=${1:?usage: engines.sh <build directory> [output.csv]}
+OUTPUT=${2:-engines.csv}
+
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIEXEC_NUMPROC_FLAG=${MPIEXEC_NUMPROC_FLAG:--n}
+PROCS=${PROCS:-4 9 16}
+SIZE=${SIZE:-2048}
+DTYPE=${DTYPE:-double}
+REPEAT=${REPEAT:-3}
+
+# Run one benchmark point and print its CSV rows
+run() {
+    engine=$1 np=$2 slow=$3
+    r=1
+    while [ "$r" -le "$REPEAT" ]; do
+        # MPIEXEC_FLAGS is split into words on purpose
+        if ! out=$("$MPIEXEC" $MPIEXEC_FLAGS "$MPIEXEC_NUMPROC_FLAG" "$np" \
+                   "$BUILD/summa/summa" --generate "$SIZE" --dtype "$DTYPE" \
+                   --engine "$engine" --slow "$slow" --quiet 2>&1); then
+            printf 'summa failed on %d processes:\n%s\n' "$np" "$out" >&2
+            return 1
+        fi
+        printf '%s,%d,%d,%d,%s,%d,%s,%s\n' "$engine" "$np" \
+            "$([ "$slow" -ge 0 ] && echo 1 || echo 0)" "$SIZE" "$DTYPE" "$r" \
+            "$(printf '%s\n' "$out" | sed -n 's/^Loop times: min \([0-9.]*\), mean \([0-9.]*\), max \([0-9.]*\).*/\1,\2,\3/p')" \
+            "$(printf '%s\n' "$out" | sed -n 's/^Performance: \([0-9.]*\) GFLOP.*/\1/p')"
+        r=$((r + 1))
+    done
+}
+
+{
+    echo "engine,procs,slow,N,dtype,run,min_loop,mean_loop,max_loop,gflops"
+    for np in $PROCS; do
+        if [ "$np" -lt 2 ]; then
+            echo "Skipping $np processes, nothing to fetch" >&2
+            continue
+        fi
+        for slow in -1 0; do
+            for engine in bcast rma; do
+                run "$engine" "$np" "$slow" || exit 1
+            done
+        done
+    done
+} > "$OUTPUT" || exit 1
+
+echo "Wrote $OUTPUT"
@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# MIT License
+#
+# Copyright (c) 2019 Philip Kovacs
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+#
+# Compare the pages of the local blocks, --pages small, thp and huge, on
+# large blocks: the page faults of setting up, loading and multiplying them
+# over all processes, and the time of the multiply loop. huge needs pages
+# reserved in the huge page pool (vm.nr_hugepages); without them the
+# programs fall back to transparent huge pages and say so.
+#
+# usage: pages.sh <build directory> [output.csv]
+#
+# Each run is a CSV row of the program, the pages asked for and got, the
+# page faults, the time of the multiply loop in seconds and its GFLOP/s.
+#
+
+BUILD=${1:?usage: pages.sh <build directory> [output.csv]}
+OUTPUT=${2:-pages.csv}
+
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIEXEC_NUMPROC_FLAG=${MPIEXEC_NUMPROC_FLAG:--n}
+PROCS=${PROCS:-1 4 9 16}
+SIZE=${SIZE:-4096}
+DTYPE=${DTYPE:-double}
+REPEAT=${REPEAT:-3}
+
+# Run one benchmark point and print its CSV rows
+run() {
+    program=$1 np=$2 pages=$3
+    r=1
+    while [ "$r" -le "$REPEAT" ]; do
+        # MPIEXEC_FLAGS is split into words on purpose
+        if ! out=$("$MPIEXEC" $MPIEXEC_FLAGS "$MPIEXEC_NUMPROC_FLAG" "$np" \
+                   "$BUILD/$program/$program" --generate "$SIZE" \
+                   --dtype "$DTYPE" --pages "$pages" --quiet 2>&1); then
+            printf '%s failed on %d processes:\n%s\n' "$program" "$np" "$out" >&2
+            return 1
+        fi
+        printf '%s,%d,%d,%s,%s,%d,%s,%s,%s\n' "$program" "$np" "$SIZE" \
+            "$DTYPE" "$pages" "$r" \
+            "$(printf '%s\n' "$out" | sed -n 's/^Page faults: \([0-9]*\) .* on \([a-z]*\) pages.*/\2,\1/p')" \
+            "$(printf '%s\n' "$out" | sed -n 's/^Phase times: .*loop \([0-9.]*\),.*/\1/p')" \
+            "$(printf '%s\n' "$out" | sed -n 's/^Performance: \([0-9.]*\) GFLOP.*/\1/p')"
+        r=$((r + 1))
+    done
+}
+
+{
+    echo "program,procs,N,dtype,pages,run,got,faults,loop,gflops"
+    for np in $PROCS; do
+        for program in cannon summa; do
+            for pages in small thp huge; do
+                run "$program" "$np" "$pages" || exit 1
+            done
+        done
+    done
+} > "$OUTPUT" || exit 1
+
+echo "Wrote $OUTPUT"
@@ -0,0 +1,202 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "libmatrix/context.h"
+#include "libmatrix/dist.h"
+#include "libmatrix/gemm.h"
+#include "libmatrix/types.h"
+
+/*
+ * Print program usage.
+ */
+void usage()
+{
+    fprintf(stderr, "usage: requests <options>\n"
+                    "  Options are:\n"
+                    "    --help|-h:        print this help\n"
+                    "    --sizes|-s:       comma separated local block sizes (default\n"
+                    "                      8,16,32,64,128)\n"
+                    "    --repeat|-n:      multiplies per context (default 100)\n"
+                    "    --dtype|-d:       element type (default double)\n"
+    );
+}
+
+/*
+ * Time repeat multiplies of a context with and without persistent requests
+ * and print a CSV row of the loop time per step of each. Every process
+ * holds n x n blocks, one per step: M = n * prows, N = n * pcols and
+ * K = n * lcm(prows, pcols), so Cannon runs lcm(prows, pcols) steps and
+ * SUMMA as many panels of width n. The slowest process bounds each
+ * multiply.
+ */
+static void run(const char *algorithm, const struct matrix_type *type, int n,
+                int repeat, int persistent)
+{
+    struct matrix_config config;
+    struct matrix_context *ctx;
+    struct matrix_context_stats stats;
+    const struct matrix_dist *dist_A, *dist_B, *dist_C;
+    void *local_A, *local_B, *local_C;
+    double loop = 0.0, max_loop;
+    int procs, rank, prows = 0, pcols = 0, steps, i;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
+    matrix_dist_grid(procs, &prows, &pcols);
+    for (steps = prows; steps % pcols != 0; steps += prows)
+        ;
+
+    memset(&config, '\0', sizeof(config));
+    config.algorithm = strcmp(algorithm, "cannon") == 0 ? MATRIX_CANNON
+                     : MATRIX_SUMMA;
+    config.type = type;
+    config.M = n * prows;
+    config.K = n * steps;
+    config.N = n * pcols;
+    config.block = n;
+    config.panel = n;
+    config.overlap = 1;
+    config.persistent = persistent;
+    matrix_context_create(MPI_COMM_WORLD, &config, &ctx);
+    MPI_Comm_rank(matrix_context_comm(ctx), &rank);
+
+    dist_A = matrix_context_dist(ctx, 0);
+    dist_B = matrix_context_dist(ctx, 1);
+    dist_C = matrix_context_dist(ctx, 2);
+    local_A = calloc((size_t)dist_A->local_rows * dist_A->local_cols, type->size);
+    local_B = calloc((size_t)dist_B->local_rows * dist_B->local_cols, type->size);
+    local_C = calloc((size_t)dist_C->local_rows * dist_C->local_cols, type->acc->size);
+    assert(local_A != NULL && local_B != NULL && local_C != NULL);
+    matrix_dist_generate(dist_A, type, 1, local_A);
+    matrix_dist_generate(dist_B, type, 2, local_B);
+
+    // One multiply warms up the buffers and connections
+    for (i = -1; i < repeat; ++i) {
+        MPI_Barrier(matrix_context_comm(ctx));
+        matrix_context_multiply(ctx, local_A, local_B, local_C, &stats);
+        MPI_Reduce(&stats.loop_time, &max_loop, 1, MPI_DOUBLE, MPI_MAX, 0,
+                   matrix_context_comm(ctx));
+        if (i >= 0) {
+            loop += max_loop;
+        }
+    }
+
+    if (rank == 0) {
+        printf("%s,%s,%d,%dx%d,%d,%s,%d,%d,%.3f\n", algorithm,
+               matrix_context_persistent(ctx) ? "persistent" : "plain", procs,
+               prows, pcols, n, type->name, repeat, steps,
+               loop / repeat / steps * 1e6);
+    }
+
+    free(local_A);
+    free(local_B);
+    free(local_C);
+    matrix_context_free(ctx);
+}
+
+/*
+ * Compare Cannon's shifts and SUMMA's broadcasts posted anew every step
+ * with persistent requests set up once per context, at block sizes small
+ * enough for the per-step setup to show. Rank 0 prints one CSV row per
+ * algorithm, request kind and block size: algorithm, requests, procs,
+ * grid, n, dtype, repeat, steps and the loop time per step in
+ * microseconds.
+ */
+int main(int argc, char *argv[])
+{
+    char sizes[256] = "8,16,32,64,128";
+    char dtype[16] = "double";
+    const struct matrix_type *type;
+    char *size;
+    int repeat = 100, c, help = 0;
+
+    MPI_Init(&argc, &argv);
+
+    while (1) {
+        static struct option long_options[] = {
+            {"help",       no_argument,       0, 'h' },
+            {"sizes",      required_argument, 0, 's' },
+            {"repeat",     required_argument, 0, 'n' },
+            {"dtype",      required_argument, 0, 'd' },
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "hs:n:d:", long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                help = 1;
+                break;
+            case 's':
+                strncpy(sizes, optarg, sizeof(sizes)-1);
+                break;
+            case 'n':
+                repeat = atoi(optarg);
+                if (repeat <= 0) {
+                    help = 2;
+                }
+                break;
+            case 'd':
+                strncpy(dtype, optarg, sizeof(dtype)-1);
+                break;
+            default:
+                break;
+        }
+    }
+    type = matrix_type_find(dtype);
+    if (help || type == NULL) {
+        usage();
+        MPI_Finalize();
+        return help == 1 ? 0 : 2;
+    }
+
+    matrix_gemm_set_kernel("auto");
+    for (size = strtok(sizes, ","); size != NULL; size = strtok(NULL, ",")) {
+        if (atoi(size) <= 0) {
+            continue;
+        }
+        run("cannon", type, atoi(size), repeat, 0);
+        run("cannon", type, atoi(size), repeat, 1);
+        run("summa", type, atoi(size), repeat, 0);
+        run("summa", type, atoi(size), repeat, 1);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
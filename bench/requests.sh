@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# MIT License
+#
+# Copyright (c) 2019 Philip Kovacs
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+#
+# Compare the multiply loops of Cannon's algorithm and SUMMA with their
+# transfers posted anew every step and set up once per context as
+# persistent requests, at local block sizes small enough for the per-step
+# setup of the transfers to show.
+#
+# usage: requests.sh <build directory> [output.csv]
+#
+# bench/requests runs REPEAT multiplies per context. Each row is the
+# algorithm, the kind of requests, the process grid, the local block size
+# n, the steps per multiply and the loop time per step, in microseconds.
+# SUMMA stays plain where MPI lacks persistent collectives. Its persistent
+# rows include the owners' copy of every panel into the fixed buffers,
+# which decides whether summa should leave plain broadcasts, its default.
+#
+
+BUILD=${1:?usage: requests.sh <build directory> [output.csv]}
+OUTPUT=${2:-requests.csv}
+
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIEXEC_NUMPROC_FLAG=${MPIEXEC_NUMPROC_FLAG:--n}
+PROCS=${PROCS:-4 9 16}
+SIZES=${SIZES:-8,16,32,64,128}
+DTYPE=${DTYPE:-double}
+REPEAT=${REPEAT:-100}
+
+{
+    echo "algorithm,requests,procs,grid,n,dtype,repeat,steps,step_us"
+    for np in $PROCS; do
+        if [ "$np" -lt 2 ]; then
+            echo "Skipping $np processes, nothing to transfer" >&2
+            continue
+        fi
+        # MPIEXEC_FLAGS is split into words on purpose
+        if ! "$MPIEXEC" $MPIEXEC_FLAGS "$MPIEXEC_NUMPROC_FLAG" "$np" \
+             "$BUILD/bench/requests" --sizes "$SIZES" --repeat "$REPEAT" \
+             --dtype "$DTYPE"; then
+            echo "requests failed on $np processes" >&2
+            exit 1
+        fi
+    done
+} > "$OUTPUT" || exit 1
+
+echo "Wrote $OUTPUT"
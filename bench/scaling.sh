@@ -0,0 +1,113 @@
+#!/bin/sh
+#
+# MIT License
+#
+# Copyright (c) 2019 Philip Kovacs
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# Strong and weak scaling sweeps of cannon, summa and matrix25d on local
+# mpiexec.
+#
+# usage: scaling.sh <build directory> [output.csv]
+#
+# All programs multiply generated matrices with --generate --quiet, so the
+# runs do no file I/O. Strong scaling multiplies SIZE x SIZE matrices on
+# every process count; weak scaling grows the matrices with the square root
+# of the process count so that each process of a 2D grid holds as many
+# elements as one process does with WEAK_SIZE. cannon and summa run on the
+# grid MPI_Dims_create picks for any process count; matrix25d stacks as many
+# layers as fit and skips counts that fit none. Each run is a CSV row of the
+# number of layers, the phase times, in seconds, and the GFLOP/s of the
+# multiply; summa has no skew phase and only matrix25d replicates and
+# reduces.
+
+BUILD=${1:?usage: scaling.sh <build directory> [output.csv]}
+OUTPUT=${2:-benchmark.csv}
+
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIEXEC_NUMPROC_FLAG=${MPIEXEC_NUMPROC_FLAG:--n}
+PROCS=${PROCS:-1 4 6 8 9 16}
+SIZE=${SIZE:-2048}
+WEAK_SIZE=${WEAK_SIZE:-1024}
+DTYPE=${DTYPE:-double}
+REPEAT=${REPEAT:-3}
+
+# Print the value that follows a word on the matching line of the output
+field() {
+    printf '%s\n' "$1" | sed -n "/^$2/s/.* $3 \([0-9.]*\).*/\1/p"
+}
+
+# Print the most layers c of matrix25d on np = c * q * q processes, c
+# dividing q, or 0 if none fit
+layers() {
+    awk -v p="$1" 'BEGIN {
+        best = 0
+        for (c = 1; c * c * c <= p; ++c) {
+            q = int(sqrt(p / c) + 0.5)
+            if (q * q * c == p && q % c == 0) best = c
+        }
+        print best
+    }'
+}
+
+# Run one benchmark point and print its CSV rows
+run() {
+    program=$1 scaling=$2 np=$3 n=$4
+    r=1
+    while [ "$r" -le "$REPEAT" ]; do
+        # MPIEXEC_FLAGS is split into words on purpose
+        if ! out=$("$MPIEXEC" $MPIEXEC_FLAGS "$MPIEXEC_NUMPROC_FLAG" "$np" \
+                   "$BUILD/$program/$program" --generate "$n" --dtype "$DTYPE" \
+                   --quiet 2>&1); then
+            printf '%s failed on %d processes:\n%s\n' "$program" "$np" "$out" >&2
+            return 1
+        fi
+        c=$(printf '%s\n' "$out" | sed -n 's/^Using \([0-9]*\) layers.*/\1/p')
+        printf '%s,%s,%d,%d,%d,%d,%d,%s,%d,%s,%s,%s,%s,%s,%s,%s\n' \
+            "$program" "$scaling" "$np" "${c:-1}" "$n" "$n" "$n" "$DTYPE" "$r" \
+            "$(field "$out" 'Phase times' load)" \
+            "$(field "$out" 'Phase times' replicate)" \
+            "$(field "$out" 'Phase times' skew)" \
+            "$(field "$out" 'Phase times' loop)" \
+            "$(field "$out" 'Phase times' reduce)" \
+            "$(field "$out" 'Phase times' store)" \
+            "$(printf '%s\n' "$out" | sed -n 's/^Performance: \([0-9.]*\) GFLOP.*/\1/p')"
+        r=$((r + 1))
+    done
+}
+
+{
+    echo "program,scaling,procs,layers,M,K,N,dtype,run,load,replicate,skew,loop,reduce,store,gflops"
+    for np in $PROCS; do
+        weak=$(awk -v p="$np" -v n="$WEAK_SIZE" 'BEGIN { print int(n * sqrt(p) + 0.5) }')
+        for program in cannon summa matrix25d; do
+            if [ "$program" = matrix25d ] && [ "$(layers "$np")" -eq 0 ]; then
+                echo "Skipping $np processes for $program, no layers fit" >&2
+                continue
+            fi
+            run "$program" strong "$np" "$SIZE" || exit 1
+            run "$program" weak "$np" "$weak" || exit 1
+        done
+    done
+} > "$OUTPUT" || exit 1
+
+echo "Wrote $OUTPUT"
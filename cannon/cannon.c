@@ -27,353 +27,140 @@
 #include "config.h"
 #endif
 
-#include <assert.h>
-#include <errno.h>
 #include <getopt.h>
-#include <math.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <mpi.h>
 
-#ifdef HAVE_ATTRIBUTE_CLEANUP
-#define AUTO_PTR(fn) __attribute__((cleanup(fn)))
-#else
-#define AUTO_PTR(fn)
-#endif
+#include "libmatrix/context.h"
+#include "libmatrix/dist.h"
+#include "libmatrix/program.h"
 
-void free_buffer(int **A);
-void initialize(int argc, char *argv[], int *N, int **A, int **B, int **C);
-void matrix_mult(int N, int *A, int *B, int *C);
-void matrix_read(FILE *fp, int *N, int **A, int **B);
-void matrix_print(const char *desc, int N, int *A);
+void describe(const struct matrix_program_run *run,
+              const struct matrix_context *ctx);
+void report(const struct matrix_program_run *run,
+            const struct matrix_program_times *times);
+int parse_option(struct matrix_options *opts, int c, const char *arg);
 
 /*
- * Print program usage.
+ * Options of Cannon's algorithm, listed among the shared options of
+ * libmatrix.
  */
-void usage()
-{
-    fprintf(stderr, "usage: cannon <options>\n"
-                    "  Options are:\n"
-                    "    --help|-h:        print this help\n"
-                    "    --matrix|-m:      matrix input file\n"
-    );
-}
+static const struct matrix_program_option cannon_options[] = {
+    { "shift", required_argument, 's',
+      "    --shift|-s:       block shifts: overlap (default) posts nonblocking\n"
+      "                      shifts into a second buffer pair during the\n"
+      "                      multiply, blocking uses MPI_Sendrecv\n" },
+    { NULL, 0, 0, NULL }
+};
+
+static const struct matrix_program program = {
+    "cannon",
+    MATRIX_CANNON,
+    MATRIX_PROGRAM_GRID | MATRIX_PROGRAM_SPARSE | MATRIX_PROGRAM_BATCH
+    | MATRIX_PROGRAM_PROFILE,
+    cannon_options,
+    parse_option,
+    NULL,
+    describe,
+    report
+};
 
 /*
- * Read a file of two square (N x N) matrices and multiply them in parallel
- * using Cannon's generalized algorithm. The number of processes assigned
- * must be in the range [1 <= np <= N*N] where np is a perfect square and
- * N/sqrt(np) is an integral number.
+ * Read a file of an M x K and a K x N matrix and multiply them in parallel
+ * using Cannon's generalized algorithm. Any number of processes np is
+ * arranged as a prows x pcols grid, as square as possible unless --grid
+ * gives its shape.
  *
  * If 1 process is indicated, sequential multiplication is used which can be
  * useful for reference to the parallel algorithm.
  *
- * If N*N is indicated, each cell of the resultant matrix is assigned a single
- * process.
- *
- * If np is indicated, a submatrix (block) of size N/sqrt(np) x N/sqrt(np)
- * is assigned to each process.
+ * The matrices are distributed 2D block-cyclically: they are cut into
+ * nb x nb blocks, dealt out round-robin along both grid dimensions, and each
+ * process packs the blocks it owns into one local matrix. Any M, K and N
+ * work; ragged edge blocks are stored at their real size. After the initial
+ * skew, process (i, j) holds the columns of A owned by process column
+ * (i + j + s) mod pcols and the rows of B owned by process row
+ * (i + j + s) mod prows in step s. On a square grid the local matrices
+ * always have matching inner dimensions and are multiplied whole. On a
+ * rectangular grid the inner dimension is cut into L = lcm(prows, pcols)
+ * slices of blocks, and step s multiplies the blocks of slice (i + j + s)
+ * mod L, which both hold; L steps cover them all.
  *
  * Example:
  *
  * Two 6x6 matrices may be multiplied sequentially with np = 1 or in parallel
  * with np = 4 (4 blocks of 3x3); np = 9 (9 blocks of 2x2); or np = 36
- * (1 cell per process).
+ * (1 cell per process). Two 7x7 matrices may use np = 4 with blocks of 2x2
+ * (--block 2), giving processes 4x4, 4x3, 3x4 and 3x3 local matrices. On
+ * np = 6 the grid is 3x2, the inner dimension has 6 slices and the default
+ * block size is 1, one column of A and row of B per step.
  */
 int main(int argc, char *argv[])
 {
-    // Rank 0 matrices
-    AUTO_PTR(free_buffer) int *A = NULL;
-    AUTO_PTR(free_buffer) int *B = NULL;
-    AUTO_PTR(free_buffer) int *C = NULL;
-
-    // Local submatrices
-    AUTO_PTR(free_buffer) int *local_A = NULL;
-    AUTO_PTR(free_buffer) int *local_B = NULL;
-    AUTO_PTR(free_buffer) int *local_C = NULL;
-
-    int N = 0;
-    int i;
-    int rank, procs;
-    int left, right, down, up;
-    int coords[2];
-    const int periods[2] = { 1, 1 };
-    const int starts[2] = { 0, 0 };
-    const int reorder = 1;
-    MPI_Comm cart_comm;
-    MPI_Datatype block_t, resized_block_t;
-
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &procs);
-
-    if (rank == 0) {
-        initialize(argc, argv, &N, &A, &B, &C);
-        if (procs == 1) {
-            // Use sequential multiplication if just 1 proc
-            printf("Using sequential multiplication on 1 process.\n");
-            matrix_print("Matrix A", N, A);
-            matrix_print("Matrix B", N, B);
-            matrix_mult(N, A, B, C);
-            matrix_print("Matrix C", N, C);
-        }
-    }
-
-    if (procs == 1) {
-        MPI_Finalize();
-        return 0;
-    }
-
-    // Number of processes must be a perfect square
-    const double fprocs_sqrt = sqrt(procs);
-    const int procs_sqrt = fprocs_sqrt;
-    if (procs_sqrt != fprocs_sqrt) {
-        if (rank == 0) {
-            fprintf(stderr, "Number of processes (%d) is not a perfect square\n", procs);
-        }
-        MPI_Finalize();
-        return 0;
-    }
-
-    // Broadcast N, the matrix dimension, to all processes
-    MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-    // Matrices must be partitioned into equal sized blocks
-    if (N % procs_sqrt != 0) {
-        if (rank == 0) {
-            fprintf(stderr, "Cannot partition %dx%d matrices on %d processes. "
-                    "Ensure N/SQRT(processes) is an integral number.\n", N, N, procs);
-        }
-        MPI_Finalize();
-        return 0;
-    }
-
-    // Runtime knowledge
-    const int N_sub = N / procs_sqrt;
-    const int N_sub_squared = N_sub * N_sub;
-    const int array_sizes[2] = { N, N };
-    const int block_sizes[2] = { N_sub, N_sub };
-    const int cart_dims[2] = { procs_sqrt, procs_sqrt };
-    AUTO_PTR(free_buffer) int *block_counts = calloc(procs, sizeof(int));
-    AUTO_PTR(free_buffer) int *block_displs = calloc(procs, sizeof(int));
-
-    // One block per process
-    for (i = 0; i < procs; ++i) {
-        block_counts[i] = 1;
-    }
-
-    // The starting extents of each block
-    for (i = 0; i < procs; ++i) {
-        int row = i / procs_sqrt;
-        int col = i % procs_sqrt;
-        block_displs[i] = row * N_sub * procs_sqrt + col;
-    }
-
-    // Create subarray type to scatter blocks with one message
-    MPI_Type_create_subarray(2, array_sizes, block_sizes, starts, MPI_ORDER_C,
-                             MPI_INT, &block_t);
-    MPI_Type_create_resized(block_t, 0, N_sub * sizeof(int), &resized_block_t);
-    MPI_Type_commit(&resized_block_t);
-
-    // Use a cartesian process topology
-    MPI_Cart_create(MPI_COMM_WORLD, 2, cart_dims, periods, reorder, &cart_comm);
-    MPI_Comm_rank(cart_comm, &rank);
-
-    // Allocate local submatrices (blocks)
-    local_A = calloc(N_sub_squared, sizeof(*local_A));
-    local_B = calloc(N_sub_squared, sizeof(*local_B));
-    local_C = calloc(N_sub_squared, sizeof(*local_C));
-
-    // Rank 0 scatters blocks of size N_sub x N_sub to all processes
-    MPI_Scatterv(A, block_counts, block_displs, resized_block_t,
-                 local_A, N_sub_squared, MPI_INT, 0, cart_comm);
-    MPI_Scatterv(B, block_counts, block_displs, resized_block_t,
-                 local_B, N_sub_squared, MPI_INT, 0, cart_comm);
-
-    // Use cartesian coordinates to guide Cannon's initial block shifts:
-    // Row 0 shifts left 0 ranks, row 1 shifts left 1 rank, etc.
-    // Col 0 shifts up 0 ranks, col 1 shifts up 1 rank, etc.
-    MPI_Cart_coords(cart_comm, rank, 2, coords);
-    MPI_Cart_shift(cart_comm, 1, coords[0], &left, &right);
-    MPI_Cart_shift(cart_comm, 0, coords[1], &up, &down);
-    MPI_Sendrecv_replace(local_A, N_sub_squared, MPI_INT, left, 1, right, 1,
-                         cart_comm, MPI_STATUS_IGNORE);
-    MPI_Sendrecv_replace(local_B, N_sub_squared, MPI_INT, up, 1, down, 1,
-                         cart_comm, MPI_STATUS_IGNORE);
-
-    // Set left and up block shifts to 1 rank for the rest of the algorithm
-    MPI_Cart_shift(cart_comm, 1, 1, &left, &right);
-    MPI_Cart_shift(cart_comm, 0, 1, &up, &down);
+    struct matrix_program_run run;
+    struct matrix_config config;
 
-    if (rank == 0) {
-        printf("Partitioned the %dx%d matrices on %d processes of %dx%d each.\n",
-               N, N, procs, N_sub, N_sub);
-        matrix_print("Matrix A", N, A);
-        matrix_print("Matrix B", N, B);
+    if (matrix_program_start(&program, &argc, &argv, &run) != 0) {
+        return matrix_program_finish(&run);
     }
 
-    // Each process multiplies, accumulates and shifts its local data
-    for (i = 0; i < procs_sqrt; ++i) {
-        // Multiply and accumulate local block
-        matrix_mult(N_sub, local_A, local_B, local_C);
-
-        // Shift block local_A left by one rank and local_B up by one rank
-        MPI_Sendrecv_replace(local_A, N_sub_squared, MPI_INT, left, 1,
-                             right, 1, cart_comm, MPI_STATUS_IGNORE);
-        MPI_Sendrecv_replace(local_B, N_sub_squared, MPI_INT, up, 1,
-                             down, 1, cart_comm, MPI_STATUS_IGNORE);
+    // Sparse matrices always take the parallel path, which handles 1 process
+    if (run.procs == 1 && !run.opts.sparse) {
+        matrix_program_sequential(&run);
+    } else {
+        // The context sets up the process grid, the distributions of A, B
+        // and C and the shift buffers
+        matrix_program_config(&run.opts, MATRIX_CANNON, run.type, run.M,
+                              run.K, run.N, &config);
+        matrix_program_parallel(&run, &config);
     }
-
-    // Rank 0 gathers the final C matrix from all process local_C blocks
-    MPI_Gatherv(local_C, N_sub_squared, MPI_INT, C, block_counts,
-                block_displs, resized_block_t, 0, cart_comm);
-
-    if (rank == 0) {
-        matrix_print("Matrix C", N, C);
-    }
-
-    MPI_Type_free(&resized_block_t);
-    MPI_Finalize();
-
-#ifndef HAVE_ATTRIBUTE_CLEANUP
-    if (rank == 0) {
-        free(A);
-        free(B);
-        free(C);
-    }
-    free(local_A);
-    free(local_B);
-    free(local_C);
-    free(block_count);
-    free(block_displs);
-#endif
-
-    return 0;
+    return matrix_program_finish(&run);
 }
 
 
 /*
- * Free a buffer.
+ * Print the grid and blocks of the distributed matrices.
  */
-void free_buffer(int **A)
+void describe(const struct matrix_program_run *run,
+              const struct matrix_context *ctx)
 {
-    free (*A);
-}
-
-/*
- * Initialize rank 0 only: parse options, read and set up matrices.
- */
-void initialize(int argc, char *argv[], int *N, int **A, int **B, int **C)
-{
-    FILE *fp = NULL;
-    char filename[256];
-    int c, help = 0;
-
-    memset(filename, '\0', sizeof(filename));
-
-    while (1) {
-        static struct option long_options[] = {
-            {"help",       no_argument,       0, 'h' },
-            {"matrix",     required_argument, 0, 'm' },
-            {0, 0, 0, 0}
-        };
-
-        int option_index = 0;
-        c = getopt_long(argc, argv, "hm:", long_options, &option_index);
+    const struct matrix_dist *dist_C = matrix_context_dist(ctx, 2);
 
-        if (c == -1)
-            break;
-
-        switch (c) {
-            case 'h':
-                help = 1;
-                break;
-            case 'm':
-                strncpy(filename, optarg, sizeof(filename)-1);
-                break;
-            default:
-                break;
-        }
-    }
-
-    if (help) {
-        usage();
-        exit(0);
-    }
-    if (filename[0] == '\0') {
-        usage();
-        exit(2);
+    printf("Distributed the %dx%d and %dx%d matrices on a %dx%d grid of "
+           "%d processes in %dx%d blocks.\n", run->M, run->K, run->K, run->N,
+           dist_C->prows, dist_C->pcols, run->procs, dist_C->nb, dist_C->nb);
+    if (matrix_context_persistent(ctx)) {
+        printf("Shifting blocks with persistent requests.\n");
     }
-
-    fp = fopen(filename, "r");
-    if (fp == NULL) {
-        fprintf(stderr,"%s (%s)\n", strerror(errno), filename);
-        exit(1);
-    }
-    matrix_read(fp, N, A, B);
-    fclose(fp);
-
-    *C = calloc(*N * *N, sizeof(*C));
-    assert(*C != NULL);
 }
 
 /*
- * Multiply arrays A, B sequentially and accumulate result in C.
+ * Print the time of the multiply and its shifts.
  */
-void matrix_mult(int N, int *A, int *B, int *C)
+void report(const struct matrix_program_run *run,
+            const struct matrix_program_times *times)
 {
-    int i, j, k;
-    for (i = 0; i < N; ++i) {
-        for (j = 0; j < N; ++j) {
-            for (k = 0; k < N; ++k) {
-                C[i*N+j] += A[i*N+k] * B[k*N+j];
-            }
-        }
-    }
+    printf("Multiply and shift time: %.6f seconds with %s shifts.\n",
+           times->loop, run->opts.overlap ? "overlapped" : "blocking");
 }
 
 /*
- * Read N and two N x N integer matrices from file.
+ * Parse an option of Cannon's algorithm. Returns nonzero if arg is invalid.
  */
-void matrix_read(FILE *fp, int *N, int **A, int **B)
+int parse_option(struct matrix_options *opts, int c, const char *arg)
 {
-    int i;
-    int N_squared = 0;
-
-    fscanf(fp, "%d", N);
-    assert((N != NULL) && (*N >= 1) && (*N <= 1000));
-    N_squared = *N * *N;
-
-    *A = calloc(N_squared, sizeof(**A));
-    assert(*A != NULL);
-
-    *B = calloc(N_squared, sizeof(**B));
-    assert(*B != NULL);
-
-    i = 0;
-    while(i < N_squared) {
-        fscanf(fp, "%d", &(*A)[i]);
-        ++i;
-    }
-
-    i = 0;
-    while(i < N_squared) {
-        fscanf(fp, "%d", &(*B)[i]);
-        ++i;
-    }
-}
-
-/*
- * Print a matrix.
- */
-void matrix_print(const char *desc, int N, int *A)
-{
-    printf("---- %s ----\n", desc);
-    int i, j;
-    for (i = 0; i < N; ++i) {
-        for (j = 0; j < N; ++j) {
-            printf("%5d%c", A[i*N+j], (j == N-1) ? '\n' : ' ');
-        }
+    switch (c) {
+        case 's':
+            if (strcmp(arg, "overlap") == 0) {
+                opts->overlap = 1;
+            } else if (strcmp(arg, "blocking") == 0) {
+                opts->overlap = 0;
+            } else {
+                return 1;
+            }
+            break;
+        default:
+            break;
     }
+    return 0;
 }
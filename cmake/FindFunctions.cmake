@@ -34,6 +34,11 @@ if(NOT HAVE_FCLOSE)
     message(FATAL_ERROR "fclose not found")
 endif()
 
+check_function_exists("fgets" HAVE_FGETS)
+if(NOT HAVE_FGETS)
+    message(FATAL_ERROR "fgets not found")
+endif()
+
 check_function_exists("fopen" HAVE_FOPEN)
 if(NOT HAVE_FOPEN)
     message(FATAL_ERROR "fopen not found")
@@ -44,11 +49,31 @@ if(NOT HAVE_FPRINTF)
     message(FATAL_ERROR "fprintf not found")
 endif()
 
+check_function_exists("fread" HAVE_FREAD)
+if(NOT HAVE_FREAD)
+    message(FATAL_ERROR "fread not found")
+endif()
+
 check_function_exists("fscanf" HAVE_FSCANF)
 if(NOT HAVE_FSCANF)
     message(FATAL_ERROR "fscanf not found")
 endif()
 
+check_function_exists("fseek" HAVE_FSEEK)
+if(NOT HAVE_FSEEK)
+    message(FATAL_ERROR "fseek not found")
+endif()
+
+check_function_exists("ftell" HAVE_FTELL)
+if(NOT HAVE_FTELL)
+    message(FATAL_ERROR "ftell not found")
+endif()
+
+check_function_exists("fwrite" HAVE_FWRITE)
+if(NOT HAVE_FWRITE)
+    message(FATAL_ERROR "fwrite not found")
+endif()
+
 check_function_exists("getopt_long" HAVE_GETOPT_LONG)
 if(NOT HAVE_GETOPT_LONG)
     message(FATAL_ERROR "getopt_long not found")
@@ -64,6 +89,11 @@ if(NOT HAVE_PRINTF)
     message(FATAL_ERROR "printf not found")
 endif()
 
+check_function_exists("sscanf" HAVE_SSCANF)
+if(NOT HAVE_SSCANF)
+    message(FATAL_ERROR "sscanf not found")
+endif()
+
 check_function_exists("strerror" HAVE_STRERROR)
 if(NOT HAVE_STRERROR)
     message(FATAL_ERROR "strerror not found")
@@ -74,6 +104,14 @@ if(NOT HAVE_STRNCPY)
     message(FATAL_ERROR "strncpy not found")
 endif()
 
+# Optional: used to pin threads to cores
+check_function_exists("sched_setaffinity" HAVE_SCHED_SETAFFINITY)
+
+# Optional: block arenas map huge pages and count page faults
+check_function_exists("mmap" HAVE_MMAP)
+check_function_exists("madvise" HAVE_MADVISE)
+check_function_exists("getrusage" HAVE_GETRUSAGE)
+
 set(CMAKE_REQUIRED_LIBRARIES ${MPI_C_LIBRARIES})
 check_function_exists("MPI_Init" HAVE_MPI_INIT)
 if(NOT HAVE_MPI_INIT)
@@ -84,4 +122,22 @@ check_function_exists("MPI_Finalize" HAVE_MPI_FINALIZE)
 if(NOT HAVE_MPI_FINALIZE)
     message(FATAL_ERROR "MPI_Finalize not found")
 endif()
+
+check_function_exists("MPI_Init_thread" HAVE_MPI_INIT_THREAD)
+if(NOT HAVE_MPI_INIT_THREAD)
+    message(FATAL_ERROR "MPI_Init_thread not found")
+endif()
+
+check_function_exists("MPI_Ibcast" HAVE_MPI_IBCAST)
+if(NOT HAVE_MPI_IBCAST)
+    message(FATAL_ERROR "MPI_Ibcast not found (MPI-3 is required)")
+endif()
+check_function_exists("MPI_File_read_all" HAVE_MPI_FILE_READ_ALL)
+if(NOT HAVE_MPI_FILE_READ_ALL)
+    message(FATAL_ERROR "MPI_File_read_all not found (MPI-IO is required)")
+endif()
+check_function_exists("MPI_File_iread_all" HAVE_MPI_FILE_IREAD_ALL)
+# Optional: persistent broadcasts of MPI-4, or of Open MPI's extension
+check_function_exists("MPI_Bcast_init" HAVE_MPI_BCAST_INIT)
+check_function_exists("MPIX_Bcast_init" HAVE_MPIX_BCAST_INIT)
 unset(CMAKE_REQUIRED_LIBRARIES)
@@ -59,9 +59,18 @@ if(NOT HAVE_STRING_H)
     message(FATAL_ERROR "string.h not found")
 endif()
 
+check_include_files("sched.h" HAVE_SCHED_H)
+
+# Optional: block arenas map huge pages and count page faults
+check_include_files("sys/mman.h" HAVE_SYS_MMAN_H)
+check_include_files("sys/resource.h" HAVE_SYS_RESOURCE_H)
+check_include_files("unistd.h" HAVE_UNISTD_H)
+
 set(CMAKE_REQUIRED_INCLUDES ${MPI_C_INCLUDE_PATH})
 check_include_files("mpi.h" HAVE_MPI_H)
 if(NOT HAVE_MPI_H)
     message(FATAL_ERROR "mpi.h not found")
 endif()
+# Optional: MPI extensions, such as Open MPI's persistent collectives
+check_include_files("mpi.h;mpi-ext.h" HAVE_MPI_EXT_H)
 unset(CMAKE_REQUIRED_INCLUDES)
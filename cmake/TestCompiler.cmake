@@ -35,3 +35,57 @@ check_c_source_compiles("
    }
 "  HAVE_ATTRIBUTE_CLEANUP
 )
+
+check_c_source_compiles("
+   int main(void)
+   {
+     __builtin_cpu_init();
+     return __builtin_cpu_supports(\"avx2\") ? 0 : 1;
+   }
+"  HAVE_BUILTIN_CPU_SUPPORTS
+)
+
+set(CMAKE_REQUIRED_FLAGS "-msse4.1")
+check_c_source_compiles("
+   #include <immintrin.h>
+   int main(void)
+   {
+     __m128i a = _mm_set1_epi32(1);
+     return _mm_cvtsi128_si32(_mm_mullo_epi32(a, a)) - 1;
+   }
+"  HAVE_KERNEL_SSE41
+)
+
+set(CMAKE_REQUIRED_FLAGS "-mavx2")
+check_c_source_compiles("
+   #include <immintrin.h>
+   int main(void)
+   {
+     __m256i a = _mm256_set1_epi32(1);
+     return _mm256_extract_epi32(_mm256_mullo_epi32(a, a), 0) - 1;
+   }
+"  HAVE_KERNEL_AVX2
+)
+
+set(CMAKE_REQUIRED_FLAGS "-mavx512f")
+check_c_source_compiles("
+   #include <immintrin.h>
+   int main(void)
+   {
+     __m512i a = _mm512_set1_epi32(1);
+     return _mm512_reduce_add_epi32(_mm512_mullo_epi32(a, a)) - 16;
+   }
+"  HAVE_KERNEL_AVX512
+)
+
+set(CMAKE_REQUIRED_FLAGS "-mavx512f -mavx512bw")
+check_c_source_compiles("
+   #include <immintrin.h>
+   int main(void)
+   {
+     __m512i a = _mm512_set1_epi16(1);
+     return _mm512_reduce_add_epi32(_mm512_madd_epi16(a, a)) - 32;
+   }
+"  HAVE_KERNEL_AVX512BW
+)
+unset(CMAKE_REQUIRED_FLAGS)
@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/file.h"
+#include "libmatrix/types.h"
+
+#ifdef HAVE_ATTRIBUTE_CLEANUP
+#define AUTO_PTR(fn) __attribute__((cleanup(fn)))
+#else
+#define AUTO_PTR(fn)
+#endif
+
+void free_buffer(void **A);
+
+/*
+ * Print program usage.
+ */
+void usage()
+{
+    fprintf(stderr, "usage: convert <options>\n"
+                    "  Options are:\n"
+                    "    --help|-h:        print this help\n"
+                    "    --matrix|-m:      text matrix input file\n"
+                    "    --dtype|-d:       element type: int (default), int64, float,\n"
+                    "                      double, complex, int8 or int16\n"
+                    "    --output|-o:      binary matrix output file\n"
+    );
+}
+
+/*
+ * Convert a text matrix file into the binary format that cannon and summa
+ * read in parallel with MPI-IO.
+ */
+int main(int argc, char *argv[])
+{
+    AUTO_PTR(free_buffer) void *A = NULL;
+    AUTO_PTR(free_buffer) void *B = NULL;
+
+    const struct matrix_type *type;
+    char input[256], output[256], dtype[16];
+    FILE *fp = NULL;
+    int M, K, N;
+    int c, help = 0;
+
+    memset(input, '\0', sizeof(input));
+    memset(output, '\0', sizeof(output));
+    memset(dtype, '\0', sizeof(dtype));
+    strncpy(dtype, "int", sizeof(dtype)-1);
+
+    while (1) {
+        static struct option long_options[] = {
+            {"help",       no_argument,       0, 'h' },
+            {"matrix",     required_argument, 0, 'm' },
+            {"dtype",      required_argument, 0, 'd' },
+            {"output",     required_argument, 0, 'o' },
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "hm:d:o:", long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                help = 1;
+                break;
+            case 'm':
+                strncpy(input, optarg, sizeof(input)-1);
+                break;
+            case 'd':
+                strncpy(dtype, optarg, sizeof(dtype)-1);
+                break;
+            case 'o':
+                strncpy(output, optarg, sizeof(output)-1);
+                break;
+            default:
+                break;
+        }
+    }
+
+    type = matrix_type_find(dtype);
+    if (help || type == NULL || input[0] == '\0' || output[0] == '\0') {
+        usage();
+        exit(help == 1 ? 0 : 2);
+    }
+
+    fp = fopen(input, "r");
+    if (fp == NULL) {
+        fprintf(stderr,"%s (%s)\n", strerror(errno), input);
+        exit(1);
+    }
+    if (matrix_file_read_text(fp, type, &M, &K, &N, &A, &B) != 0) {
+        fprintf(stderr, "Malformed matrix file (%s)\n", input);
+        exit(1);
+    }
+    fclose(fp);
+
+    fp = fopen(output, "wb");
+    if (fp == NULL) {
+        fprintf(stderr,"%s (%s)\n", strerror(errno), output);
+        exit(1);
+    }
+    if (matrix_file_write(fp, type, M, K, N, A, B) != 0 || fclose(fp) != 0) {
+        fprintf(stderr, "%s (%s)\n", strerror(errno), output);
+        exit(1);
+    }
+    printf("Wrote the %dx%d and %dx%d %s matrices to %s.\n",
+           M, K, K, N, dtype, output);
+
+#ifndef HAVE_ATTRIBUTE_CLEANUP
+    free(A);
+    free(B);
+#endif
+
+    return 0;
+}
+
+/*
+ * Free a buffer.
+ */
+void free_buffer(void **A)
+{
+    free (*A);
+}
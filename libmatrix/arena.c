@@ -0,0 +1,340 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// Needed for MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "libmatrix/arena.h"
+#include "libmatrix/threads.h"
+
+#define ROUND_UP(a, b) ((((a) + (b) - 1) / (b)) * (b))
+
+#ifdef _OPENMP
+#define OMP(directive) _Pragma(#directive)
+#else
+#define OMP(directive)
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(MAP_ANONYMOUS)
+#define HAVE_ANONYMOUS_MAP
+#endif
+
+/*
+ * Huge pages are taken to be 2 MiB, the default on x86-64 and on AArch64
+ * with 4 KiB base pages. Mappings for transparent huge pages are aligned to
+ * it so that the kernel can back all of them with huge pages.
+ */
+#define HUGE_PAGE ((size_t)2 << 20)
+
+/*
+ * Pages of a block arena, in the order of page_names.
+ */
+enum pages {
+    PAGES_HEAP,
+    PAGES_SMALL,
+    PAGES_THP,
+    PAGES_HUGE
+};
+
+static const char *const page_names[] = { "heap", "small", "thp", "huge" };
+
+static enum pages selected_pages = PAGES_THP;
+
+/*
+ * Free the buffer of an arena, mapped or from the heap.
+ */
+static void release_buffer(struct matrix_arena *arena)
+{
+#ifdef HAVE_ANONYMOUS_MAP
+    if (arena->mapped > 0) {
+        munmap(arena->base, arena->mapped);
+    } else {
+        free(arena->base);
+    }
+#else
+    free(arena->base);
+#endif
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+    arena->mapped = 0;
+    arena->pages = PAGES_HEAP;
+}
+
+size_t matrix_arena_bytes(size_t size)
+{
+    return (size + MATRIX_ARENA_ALIGN - 1) / MATRIX_ARENA_ALIGN * MATRIX_ARENA_ALIGN;
+}
+
+int matrix_arena_reserve(struct matrix_arena *arena, size_t size)
+{
+    char *base;
+
+    assert(arena->used == 0);
+    if (size <= arena->size) {
+        return 0;
+    }
+
+    // The old contents need not survive, so there is nothing to copy
+    size = matrix_arena_bytes(size);
+    base = aligned_alloc(MATRIX_ARENA_ALIGN, size);
+    if (base == NULL) {
+        return -1;
+    }
+    release_buffer(arena);
+    arena->base = base;
+    arena->size = size;
+    return 0;
+}
+
+void *matrix_arena_alloc(struct matrix_arena *arena, size_t size)
+{
+    void *piece;
+
+    size = matrix_arena_bytes(size);
+    if (size > arena->size - arena->used) {
+        return NULL;
+    }
+    piece = arena->base + arena->used;
+    arena->used += size;
+    return piece;
+}
+
+size_t matrix_arena_mark(const struct matrix_arena *arena)
+{
+    return arena->used;
+}
+
+void matrix_arena_release(struct matrix_arena *arena, size_t mark)
+{
+    assert(mark <= arena->used);
+    arena->used = mark;
+}
+
+/*
+ * Select the pages of later block arenas.
+ */
+int matrix_arena_set_pages(const char *name)
+{
+    int i;
+
+    for (i = PAGES_SMALL; i <= PAGES_HUGE; ++i) {
+        if (strcmp(name, page_names[i]) == 0) {
+            selected_pages = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *matrix_arena_pages(const struct matrix_arena *arena)
+{
+    return page_names[arena != NULL ? arena->pages : (int)selected_pages];
+}
+
+#ifdef HAVE_ANONYMOUS_MAP
+/*
+ * Map length bytes aligned to align, a multiple of the page size, with the
+ * given extra flags. Returns NULL if the mapping fails.
+ */
+static char *map_aligned(size_t length, size_t align, int flags)
+{
+    char *map, *base;
+    size_t head;
+
+    map = mmap(NULL, length + align, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Trim the mapping to the aligned length inside it
+    base = (char *)ROUND_UP((uintptr_t)map, align);
+    head = base - map;
+    if (head > 0) {
+        munmap(map, head);
+    }
+    if (align - head > 0) {
+        munmap(base + length, align - head);
+    }
+    return base;
+}
+#endif
+
+/*
+ * Map the block arena with the selected pages, falling back from the huge
+ * page pool to transparent huge pages, from them to small pages and from
+ * mappings to the heap.
+ */
+int matrix_arena_map(struct matrix_arena *arena, size_t size)
+{
+    assert(arena->base == NULL);
+
+    // Even an arena for empty blocks hands out valid pointers
+    size = matrix_arena_bytes(size > 0 ? size : 1);
+    arena->used = 0;
+
+#ifdef HAVE_ANONYMOUS_MAP
+    size_t length;
+    enum pages pages = selected_pages;
+
+#ifdef MAP_HUGETLB
+    // The pool hands out whole huge pages, always aligned
+    if (pages == PAGES_HUGE) {
+        length = ROUND_UP(size, HUGE_PAGE);
+        arena->base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (arena->base != MAP_FAILED) {
+            arena->size = size;
+            arena->mapped = length;
+            arena->pages = PAGES_HUGE;
+            return 0;
+        }
+        arena->base = NULL;
+    }
+#endif
+    pages = pages == PAGES_HUGE ? PAGES_THP : pages;
+
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+    if (pages == PAGES_THP) {
+        length = ROUND_UP(size, HUGE_PAGE);
+        arena->base = map_aligned(length, HUGE_PAGE, 0);
+        if (arena->base != NULL) {
+            madvise(arena->base, length, MADV_HUGEPAGE);
+            arena->size = size;
+            arena->mapped = length;
+            arena->pages = PAGES_THP;
+            return 0;
+        }
+    }
+#endif
+
+    // Small pages, even if the system makes every mapping huge by default
+    length = ROUND_UP(size, (size_t)sysconf(_SC_PAGESIZE));
+    arena->base = map_aligned(length, (size_t)sysconf(_SC_PAGESIZE), 0);
+    if (arena->base == NULL) {
+        return -1;
+    }
+#if defined(HAVE_MADVISE) && defined(MADV_NOHUGEPAGE)
+    madvise(arena->base, length, MADV_NOHUGEPAGE);
+#endif
+    arena->size = size;
+    arena->mapped = length;
+    arena->pages = PAGES_SMALL;
+    return 0;
+#else
+    arena->base = aligned_alloc(MATRIX_ARENA_ALIGN, size);
+    if (arena->base == NULL) {
+        return -1;
+    }
+    arena->size = size;
+    arena->pages = PAGES_HEAP;
+    return 0;
+#endif
+}
+
+/*
+ * Hand out a block and zero it in one contiguous range of whole pages per
+ * thread of the local multiply.
+ */
+void *matrix_arena_zeros(struct matrix_arena *arena, int rows, int cols,
+                         size_t size)
+{
+    const int threads = matrix_threads();
+    const size_t bytes = (size_t)rows * cols * size;
+    size_t page = MATRIX_ARENA_ALIGN;
+    char *block;
+
+    block = matrix_arena_alloc(arena, bytes);
+    if (block == NULL || rows <= 0 || cols <= 0) {
+        return block;
+    }
+#ifdef HAVE_ANONYMOUS_MAP
+    if (arena->pages == PAGES_SMALL) {
+        page = (size_t)sysconf(_SC_PAGESIZE);
+    } else if (arena->pages != PAGES_HEAP) {
+        page = HUGE_PAGE;
+    }
+#endif
+
+    OMP(omp parallel num_threads(threads) if(threads > 1))
+    {
+        int t = 0, nt = 1;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+        nt = omp_get_num_threads();
+#endif
+        // Split the block evenly, moving each split up to a page boundary
+        const uintptr_t begin = (uintptr_t)block, end = begin + bytes;
+        uintptr_t first = t == 0 ? begin
+                        : ROUND_UP(begin + bytes * t / nt, page);
+        uintptr_t last = t == nt - 1 ? end
+                       : ROUND_UP(begin + bytes * (t + 1) / nt, page);
+        first = first < end ? first : end;
+        last = last < end ? last : end;
+        if (last > first) {
+            memset((char *)first, '\0', last - first);
+        }
+    }
+    return block;
+}
+
+long matrix_arena_faults(void)
+{
+#if defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_GETRUSAGE)
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_minflt + usage.ru_majflt;
+    }
+#endif
+    return 0;
+}
+
+void matrix_arena_free(struct matrix_arena *arena)
+{
+    release_buffer(arena);
+}
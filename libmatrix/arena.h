@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_ARENA_H
+#define LIBMATRIX_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * A workspace arena: one buffer reserved up front and handed out in
+ * aligned pieces by bumping an offset, so that code which needs scratch
+ * space at every level of a recursion allocates nothing while it runs.
+ * Pieces are returned in reverse order by releasing back to a mark.
+ *
+ * A block arena holds the local blocks of a run or a context instead, in
+ * one mapping of the selected pages; mapped is the length of the mapping,
+ * or 0 for a buffer from the heap, and pages the pages it got.
+ */
+struct matrix_arena {
+    char *base;
+    size_t size;
+    size_t used;
+    size_t mapped;
+    int pages;
+};
+
+/*
+ * Alignment of every piece, enough for any SIMD load.
+ */
+#define MATRIX_ARENA_ALIGN 64
+
+/*
+ * Return the arena bytes a piece of size bytes takes up, alignment included.
+ */
+size_t matrix_arena_bytes(size_t size);
+
+/*
+ * Make sure the arena holds at least size bytes, growing its buffer if
+ * needed; only allowed while no piece is in use. Returns 0 on success and -1
+ * if memory is exhausted.
+ */
+int matrix_arena_reserve(struct matrix_arena *arena, size_t size);
+
+/*
+ * Hand out a piece of size bytes aligned to MATRIX_ARENA_ALIGN, or NULL if
+ * the arena is too small.
+ */
+void *matrix_arena_alloc(struct matrix_arena *arena, size_t size);
+
+/*
+ * Return the current fill of the arena, and release every piece handed out
+ * since that mark.
+ */
+size_t matrix_arena_mark(const struct matrix_arena *arena);
+void matrix_arena_release(struct matrix_arena *arena, size_t mark);
+
+/*
+ * Select the pages of block arenas by name: small for the base page size,
+ * thp to ask for transparent huge pages (the default), or huge for pages
+ * of the huge page pool (MAP_HUGETLB), with transparent huge pages if the
+ * pool runs short. Returns 0 on success and -1 if the name is unknown.
+ */
+int matrix_arena_set_pages(const char *name);
+
+/*
+ * Return the name of the pages a block arena got, or of the selected pages
+ * if arena is NULL; heap for an arena not mapped.
+ */
+const char *matrix_arena_pages(const struct matrix_arena *arena);
+
+/*
+ * Make an empty arena a block arena of size bytes: one mapping, aligned to
+ * its page size, whose pages are left untouched until matrix_arena_zeros
+ * hands them out. Falls back to the heap where mappings are unavailable.
+ * Returns 0 on success and -1 if memory is exhausted.
+ */
+int matrix_arena_map(struct matrix_arena *arena, size_t size);
+
+/*
+ * Hand out a zeroed rows x cols block of elements of size bytes, or NULL if
+ * the arena is too small. The threads of the local multiply zero it, each
+ * one contiguous range of whole pages, so that with a first touch policy
+ * every page is placed by a single thread and the block spreads over the
+ * NUMA nodes of the threads. The multiply splits C by columns, which pages
+ * of a row-major block cannot follow, so a page is not always local to
+ * every thread that uses it.
+ */
+void *matrix_arena_zeros(struct matrix_arena *arena, int rows, int cols,
+                         size_t size);
+
+/*
+ * Return the page faults of this process so far, minor and major, or 0 if
+ * the system does not count them.
+ */
+long matrix_arena_faults(void);
+
+/*
+ * Free the buffer of the arena, leaving it empty.
+ */
+void matrix_arena_free(struct matrix_arena *arena);
+
+#endif /* LIBMATRIX_ARENA_H */
@@ -0,0 +1,360 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "libmatrix/arena.h"
+#include "libmatrix/batch.h"
+#include "libmatrix/dist.h"
+#include "libmatrix/file.h"
+
+/*
+ * What every load and store of a batch shares: the grid, the distributions
+ * and file views of A, B and C, and the file layout of one item.
+ */
+struct batch {
+    const struct matrix_type *type;
+    MPI_Comm comm;
+    const struct matrix_dist *dist[3];
+    MPI_Datatype views[3];
+    struct matrix_file_header input, output;
+    double wait_time;
+};
+
+/*
+ * A load of A and B in flight. Each matrix has its own handle so that its
+ * file view stays set while the read proceeds.
+ */
+struct batch_load {
+    MPI_File fh[2];
+    MPI_Request requests[2];
+};
+
+/*
+ * A write of C in flight, or none if fh is MPI_FILE_NULL.
+ */
+struct batch_store {
+    MPI_File fh;
+    MPI_Request request;
+};
+
+/*
+ * Begin a collective read of count elements through the file view of fh,
+ * or read them at once where MPI lacks nonblocking collective I/O.
+ */
+static int batch_iread(MPI_File fh, void *buf, int count, MPI_Datatype type,
+                       MPI_Request *request)
+{
+#ifdef HAVE_MPI_FILE_IREAD_ALL
+    return MPI_File_iread_all(fh, buf, count, type, request);
+#else
+    *request = MPI_REQUEST_NULL;
+    return MPI_File_read_all(fh, buf, count, type, MPI_STATUS_IGNORE);
+#endif
+}
+
+/*
+ * Begin a collective write, the counterpart of batch_iread.
+ */
+static int batch_iwrite(MPI_File fh, const void *buf, int count,
+                        MPI_Datatype type, MPI_Request *request)
+{
+#ifdef HAVE_MPI_FILE_IREAD_ALL
+    return MPI_File_iwrite_all(fh, buf, count, type, request);
+#else
+    *request = MPI_REQUEST_NULL;
+    return MPI_File_write_all(fh, buf, count, type, MPI_STATUS_IGNORE);
+#endif
+}
+
+/*
+ * Open the input of item and start reading the local blocks of A and B.
+ */
+static int load_begin(struct batch *b, const struct matrix_batch_item *item,
+                      void *local_A, void *local_B, struct batch_load *load)
+{
+    void *local[2] = { local_A, local_B };
+    int i, rc = MPI_SUCCESS;
+
+    for (i = 0; i < 2; ++i) {
+        const struct matrix_dist *d = b->dist[i];
+        load->fh[i] = MPI_FILE_NULL;
+        load->requests[i] = MPI_REQUEST_NULL;
+        if (rc == MPI_SUCCESS) {
+            rc = MPI_File_open(b->comm, item->input, MPI_MODE_RDONLY,
+                               MPI_INFO_NULL, &load->fh[i]);
+        }
+        if (rc == MPI_SUCCESS) {
+            rc = MPI_File_set_view(load->fh[i],
+                                   matrix_file_offset(&b->input, b->type->size, i),
+                                   b->type->mpi, b->views[i], "native",
+                                   MPI_INFO_NULL);
+        }
+        if (rc == MPI_SUCCESS) {
+            rc = batch_iread(load->fh[i], local[i], d->local_rows * d->local_cols,
+                             b->type->mpi, &load->requests[i]);
+        }
+    }
+    return rc;
+}
+
+/*
+ * Wait for a load and close its handles.
+ */
+static int load_end(struct batch *b, struct batch_load *load)
+{
+    double start = MPI_Wtime();
+    int i, rc;
+
+    rc = MPI_Waitall(2, load->requests, MPI_STATUSES_IGNORE);
+    for (i = 0; i < 2; ++i) {
+        if (load->fh[i] != MPI_FILE_NULL) {
+            MPI_File_close(&load->fh[i]);
+        }
+    }
+    b->wait_time += MPI_Wtime() - start;
+    return rc;
+}
+
+/*
+ * Start writing the local blocks of C to the output of item after rank 0
+ * has written the header, or reduce the checksum of C if it has none.
+ */
+static int store_begin(struct batch *b, struct matrix_batch_item *item,
+                       const void *local_C, struct batch_store *store)
+{
+    const struct matrix_dist *d = b->dist[2];
+    int rank, rc;
+
+    store->fh = MPI_FILE_NULL;
+    store->request = MPI_REQUEST_NULL;
+    if (item->output[0] == '\0') {
+        matrix_dist_checksum(d, b->type->acc, local_C, 0, b->comm, &item->digest,
+                             &item->norm);
+        return MPI_SUCCESS;
+    }
+
+    MPI_Comm_rank(b->comm, &rank);
+    rc = MPI_File_open(b->comm, item->output, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                       MPI_INFO_NULL, &store->fh);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_set_size(store->fh, 0);
+    }
+    if (rc == MPI_SUCCESS && rank == 0) {
+        rc = MPI_File_write_at(store->fh, 0, &b->output, sizeof(b->output),
+                               MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_set_view(store->fh, sizeof(b->output), b->type->acc->mpi,
+                               b->views[2], "native", MPI_INFO_NULL);
+    }
+    if (rc == MPI_SUCCESS) {
+        rc = batch_iwrite(store->fh, local_C, d->local_rows * d->local_cols,
+                          b->type->acc->mpi, &store->request);
+    }
+    return rc;
+}
+
+/*
+ * Wait for a store and close its handle.
+ */
+static int store_end(struct batch *b, struct batch_store *store)
+{
+    double start = MPI_Wtime();
+    int rc;
+
+    rc = MPI_Wait(&store->request, MPI_STATUS_IGNORE);
+    if (store->fh != MPI_FILE_NULL) {
+        MPI_File_close(&store->fh);
+    }
+    b->wait_time += MPI_Wtime() - start;
+    return rc;
+}
+
+/*
+ * Check every input header against the first one.
+ */
+int matrix_batch_read(const char *manifest, const struct matrix_type **type,
+                      int *M, int *K, int *N,
+                      struct matrix_batch_item **items, int *count)
+{
+    struct matrix_file_header header, first;
+    struct matrix_batch_item item, *list = NULL;
+    char line[1024];
+    FILE *fp, *in;
+    int n = 0, rc = 0;
+
+    fp = fopen(manifest, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    while (rc == 0 && fgets(line, sizeof(line), fp) != NULL) {
+        memset(&item, '\0', sizeof(item));
+        if (sscanf(line, "%255s %255s", item.input, item.output) < 1 ||
+            item.input[0] == '#') {
+            continue;
+        }
+        list = realloc(list, (n + 1) * sizeof(*list));
+        assert(list != NULL);
+        list[n++] = item;
+
+        in = fopen(item.input, "rb");
+        if (in == NULL || matrix_file_read_header(in, &header) != 0) {
+            rc = n;
+        } else if (n == 1) {
+            first = header;
+        } else if (strcmp(header.dtype, first.dtype) != 0 ||
+                   header.M != first.M || header.K != first.K ||
+                   header.N != first.N) {
+            rc = n;
+        }
+        if (in != NULL) {
+            fclose(in);
+        }
+    }
+    fclose(fp);
+
+    if (rc == 0 && n == 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        free(list);
+        return rc;
+    }
+    *type = matrix_type_find(first.dtype);
+    *M = first.M;
+    *K = first.K;
+    *N = first.N;
+    *items = list;
+    *count = n;
+    return 0;
+}
+
+/*
+ * Run the batch as a pipeline over two sets of local buffers: while item i
+ * is multiplied in one set, item i + 1 loads into the other set and item
+ * i - 1 is still being written from it.
+ */
+int matrix_batch_run(struct matrix_context *ctx, const struct matrix_type *type,
+                     struct matrix_batch_item *items, int count,
+                     struct matrix_batch_stats *stats)
+{
+    struct batch b;
+    struct batch_load load[2];
+    struct batch_store store[2];
+    struct matrix_context_stats multiply;
+    struct matrix_arena blocks;
+    void *local[3][2];
+    size_t bytes = 0;
+    double start;
+    int i, j, cur, rc = MPI_SUCCESS;
+
+    memset(&b, '\0', sizeof(b));
+    memset(&blocks, '\0', sizeof(blocks));
+    memset(stats, '\0', sizeof(*stats));
+    if (matrix_context_layers(ctx) > 1) {
+        return MPI_ERR_ARG;
+    }
+    b.type = type;
+    b.comm = matrix_context_comm(ctx);
+    // C holds the accumulator type of a quantized type
+    for (j = 0; j < 3; ++j) {
+        const struct matrix_type *t = j < 2 ? type : type->acc;
+        b.dist[j] = matrix_context_dist(ctx, j);
+        matrix_dist_view(b.dist[j], t->mpi, &b.views[j]);
+        bytes += 2 * matrix_arena_bytes((size_t)b.dist[j]->local_rows
+                                        * b.dist[j]->local_cols * t->size);
+    }
+
+    // Both sets of buffers are reserved at once
+    rc = matrix_arena_map(&blocks, bytes);
+    assert(rc == 0);
+    for (j = 0; j < 3; ++j) {
+        for (i = 0; i < 2; ++i) {
+            local[j][i] = matrix_arena_zeros(&blocks, b.dist[j]->local_rows,
+                                             b.dist[j]->local_cols,
+                                             j < 2 ? type->size : type->acc->size);
+            assert(local[j][i] != NULL);
+        }
+    }
+    matrix_file_header_init(&b.input, MATRIX_FILE_MAGIC, type, b.dist[0]->rows,
+                            b.dist[0]->cols, b.dist[1]->cols);
+    matrix_file_header_init(&b.output, MATRIX_FILE_MAGIC_C, type->acc, b.dist[2]->rows,
+                            b.dist[0]->cols, b.dist[2]->cols);
+
+    start = MPI_Wtime();
+    items[0].latency = start;
+    rc = load_begin(&b, &items[0], local[0][0], local[1][0], &load[0]);
+    if (rc == MPI_SUCCESS) {
+        rc = load_end(&b, &load[0]);
+    }
+    for (i = 0; i < count && rc == MPI_SUCCESS; ++i) {
+        cur = i & 1;
+        if (i + 1 < count) {
+            items[i+1].latency = MPI_Wtime();
+            rc = load_begin(&b, &items[i+1], local[0][cur^1], local[1][cur^1],
+                            &load[cur^1]);
+        }
+
+        // The store of item i - 2 from this set finished during item i - 1
+        memset(local[2][cur], '\0',
+               (size_t)b.dist[2]->local_rows * b.dist[2]->local_cols
+               * type->acc->size);
+        matrix_context_multiply(ctx, local[0][cur], local[1][cur], local[2][cur],
+                                &multiply);
+        stats->compute_time += multiply.compute_time;
+
+        if (i > 0 && rc == MPI_SUCCESS) {
+            rc = store_end(&b, &store[cur^1]);
+            items[i-1].latency = MPI_Wtime() - items[i-1].latency;
+        }
+        if (rc == MPI_SUCCESS) {
+            rc = store_begin(&b, &items[i], local[2][cur], &store[cur]);
+        }
+        if (i + 1 < count && rc == MPI_SUCCESS) {
+            rc = load_end(&b, &load[cur^1]);
+        }
+    }
+    if (rc == MPI_SUCCESS) {
+        rc = store_end(&b, &store[(count - 1) & 1]);
+        items[count-1].latency = MPI_Wtime() - items[count-1].latency;
+    }
+    stats->total_time = MPI_Wtime() - start;
+    stats->wait_time = b.wait_time;
+
+    for (j = 0; j < 3; ++j) {
+        MPI_Type_free(&b.views[j]);
+    }
+    matrix_arena_free(&blocks);
+    return rc;
+}
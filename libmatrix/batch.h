@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_BATCH_H
+#define LIBMATRIX_BATCH_H
+
+#include <stdint.h>
+
+#include "libmatrix/context.h"
+#include "libmatrix/types.h"
+
+/*
+ * One product of a batch: the binary matrix file of A and B and, unless
+ * empty, the binary file C is written to. A multiply fills in the time from
+ * the start of its load to the end of its store on this process and, for an
+ * item without output, the checksum of C on rank 0 of the grid.
+ */
+struct matrix_batch_item {
+    char input[256];
+    char output[256];
+    double latency;
+    uint64_t digest;
+    double norm;
+};
+
+/*
+ * Timings of a whole batch on one process: from the first load to the last
+ * store, in the local multiplies, and waiting for loads and stores that the
+ * multiplies did not hide.
+ */
+struct matrix_batch_stats {
+    double total_time;
+    double compute_time;
+    double wait_time;
+};
+
+/*
+ * Read a manifest, one item per line: an input file and an optional output
+ * file, separated by white space. Blank lines and lines starting with # are
+ * skipped. Every input must be a binary matrix file of the same element
+ * type and shape, which are returned with the items. Returns 0 on success,
+ * -1 if the manifest cannot be read or lists no items, and otherwise the
+ * 1-based number of the first item whose input does not match the first.
+ */
+int matrix_batch_read(const char *manifest, const struct matrix_type **type,
+                      int *M, int *K, int *N,
+                      struct matrix_batch_item **items, int *count);
+
+/*
+ * Multiply every item of a batch with ctx, collectively over its grid. The
+ * loads of item i + 1 are nonblocking collective reads that proceed while
+ * item i is multiplied, and the write of C of item i proceeds while item
+ * i + 1 is multiplied, so for large enough products the batch runs at the
+ * speed of the multiplies alone. The communicators, distributions, file
+ * views and buffers are set up once for the whole batch. Returns an MPI
+ * error code: MPI_ERR_ARG for a 2.5D context with more than 1 layer.
+ */
+int matrix_batch_run(struct matrix_context *ctx, const struct matrix_type *type,
+                     struct matrix_batch_item *items, int count,
+                     struct matrix_batch_stats *stats);
+
+#endif /* LIBMATRIX_BATCH_H */
@@ -0,0 +1,1588 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#if !defined(HAVE_MPI_BCAST_INIT) && defined(HAVE_MPIX_BCAST_INIT) && defined(HAVE_MPI_EXT_H)
+#include <mpi-ext.h>
+#endif
+
+#include "libmatrix/arena.h"
+#include "libmatrix/context.h"
+#include "libmatrix/gemm.h"
+#include "libmatrix/trace.h"
+
+/*
+ * Persistent broadcasts are MPI-4; Open MPI 4 has them as an extension
+ */
+#if defined(HAVE_MPI_BCAST_INIT)
+#define BCAST_INIT MPI_Bcast_init
+#elif defined(HAVE_MPIX_BCAST_INIT) && defined(HAVE_MPI_EXT_H)
+#define BCAST_INIT MPIX_Bcast_init
+#endif
+
+/*
+ * A panel of kb columns of A and kb rows of B. a and b point at the panel
+ * data, either a receive buffer or, on the process that owns the panel, its
+ * own local matrix.
+ */
+struct panel {
+    int kb;
+    void *recv_A, *recv_B;
+    const void *a, *b;
+    int lda;
+    MPI_Request requests[2];
+};
+
+/*
+ * A persistent broadcast of SUMMA into the buffer of panel slot, from root,
+ * of a panel width columns (or rows) wide.
+ */
+struct persistent_bcast {
+    int slot, root, width;
+    MPI_Request request;
+};
+
+/*
+ * Byte offsets of the local arrays of A and B and of the panel buffers in
+ * the shared memory segment of a rank, and the row stride of its local A.
+ */
+struct shared_layout {
+    MPI_Aint A, B;
+    MPI_Aint panels_A, panels_B;
+    int lda_A;
+};
+
+/*
+ * Node-aware SUMMA along one dimension of the grid: panels of A travel along
+ * process rows and panels of B along process columns. The first rank of a
+ * row (or column) on each node leads: only the leaders exchange panels
+ * between nodes, in leader_comm. For every rank of the row, leader is the
+ * rank in leader_comm of the leader of its node and peer its rank in the
+ * node communicator, or MPI_UNDEFINED on other nodes. lead_peer is the rank
+ * of this rank's own leader in the node communicator.
+ */
+struct shared_dim {
+    MPI_Comm leader_comm;
+    int *leader;
+    int *peer;
+    int lead_peer;
+};
+
+struct matrix_context {
+    struct matrix_config config;
+    int prows, pcols;
+    int coords[2];
+    MPI_Comm cart_comm, cart_row_comm, cart_col_comm;
+    struct matrix_dist dist_A, dist_B, dist_C;
+
+    // The shift, copy and panel buffers, reserved at once
+    struct matrix_arena blocks;
+
+    // Cannon: the number of slices of the inner dimension, lcm(prows,
+    // pcols), the first and the number of steps this process runs,
+    // neighbors of the initial skew and of every later shift, and the two
+    // buffer pairs that blocks of A and B are shifted through
+    int slices;
+    int first_step, steps;
+    int skew_left, skew_right, skew_up, skew_down;
+    int left, right, up, down;
+    void *shift_A[2], *shift_B[2];
+
+    // Persistent shifts, if set up, in shift_request's order
+    MPI_Request *shift_requests;
+
+    // 2.5D: the layer of this process in the stack of grids and the
+    // communicator along the stack; A, B and partial C of layers above 0
+    int layer, layers;
+    MPI_Comm stack_comm, depth_comm;
+    void *copy_A, *copy_B, *partial_C;
+
+    // SUMMA: the panel width, the two panels of the look-ahead and the
+    // strided type of a full width panel of local A
+    int panel;
+    struct panel panels[2];
+    MPI_Datatype columns_t;
+
+    // Persistent broadcasts into the panel buffers, if set up, one per
+    // distinct buffer, root and width: panel j travels through panels[j % 2]
+    struct persistent_bcast *bcast_A, *bcast_B;
+    int bcast_count_A, bcast_count_B;
+
+    // Shared SUMMA: the ranks that share memory with this one, the window
+    // of their segments, and the address and layout of every segment. Panel
+    // buffers are in the segments of the leaders, three per dimension.
+    MPI_Comm node_comm;
+    MPI_Win window;
+    int node_rank, node_ranks;
+    char **segments;
+    struct shared_layout *layouts;
+    struct shared_dim shared_A, shared_B;
+    size_t panel_A_bytes, panel_B_bytes;
+
+    // One-sided SUMMA: the windows exposing the local A and B of every rank
+    // of the grid
+    MPI_Win window_A, window_B;
+    void *exposed_A, *exposed_B;
+
+    // Sparse multiplies: buffer pairs that shifted blocks or broadcast
+    // panels of A and B arrive in, and the copies of layers above 0, all
+    // grown to the largest block so far
+    void *sparse_A[2], *sparse_B[2], *sparse_copy[2];
+    size_t sparse_A_size[2], sparse_B_size[2], sparse_copy_size[2];
+
+    // Sparse Cannon on a rectangular grid: the columns of A and rows of B
+    // of one block of a slice
+    void *sparse_slice[2];
+    size_t sparse_slice_size[2];
+};
+
+#define SHARED_ALIGN 64
+
+/*
+ * Round bytes up to the alignment of the arrays in a shared segment.
+ */
+static size_t shared_round(size_t bytes)
+{
+    return (bytes + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN;
+}
+
+/*
+ * Find the leaders of the ranks of comm, a row or column of the grid, and
+ * their ranks in the node communicator. Returns nonzero if this rank leads.
+ */
+static int shared_dim_init(struct matrix_context *c, struct shared_dim *dim,
+                           MPI_Comm comm, int node_id)
+{
+    MPI_Comm node_dim;
+    MPI_Group group, node_group;
+    int rank, size, dim_rank, i;
+    int lead[2] = { MPI_UNDEFINED, 0 };
+    int *ranks;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Comm_split(comm, node_id, rank, &node_dim);
+    MPI_Comm_rank(node_dim, &dim_rank);
+    MPI_Comm_split(comm, dim_rank == 0 ? 0 : MPI_UNDEFINED, rank,
+                   &dim->leader_comm);
+
+    // The leader tells its node peers its ranks in leader_comm and comm
+    if (dim_rank == 0) {
+        MPI_Comm_rank(dim->leader_comm, &lead[0]);
+        lead[1] = rank;
+    }
+    MPI_Bcast(lead, 2, MPI_INT, 0, node_dim);
+    MPI_Comm_free(&node_dim);
+
+    dim->leader = malloc(size * sizeof(int));
+    dim->peer = malloc(size * sizeof(int));
+    ranks = malloc(size * sizeof(int));
+    assert(dim->leader != NULL && dim->peer != NULL && ranks != NULL);
+    MPI_Allgather(&lead[0], 1, MPI_INT, dim->leader, 1, MPI_INT, comm);
+    for (i = 0; i < size; ++i) {
+        ranks[i] = i;
+    }
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_group(c->node_comm, &node_group);
+    MPI_Group_translate_ranks(group, size, ranks, node_group, dim->peer);
+    MPI_Group_free(&group);
+    MPI_Group_free(&node_group);
+    free(ranks);
+    dim->lead_peer = dim->peer[lead[1]];
+    return dim_rank == 0;
+}
+
+/*
+ * Group the ranks that share memory, split into groups of node_size if
+ * set, and allocate their window: each rank's segment holds its local A
+ * and B and, on leaders, the panel buffers. Segments need not be
+ * contiguous, so each may live on its own rank's NUMA node.
+ */
+static void shared_init(struct matrix_context *c)
+{
+    const struct matrix_type *type = c->config.type;
+    struct shared_layout mine;
+    MPI_Comm node_comm;
+    MPI_Info info;
+    MPI_Aint size;
+    char *base;
+    int rank, node_id, lead_A, lead_B, disp, i;
+
+    MPI_Comm_rank(c->cart_comm, &rank);
+    MPI_Comm_split_type(c->cart_comm, MPI_COMM_TYPE_SHARED, rank,
+                        MPI_INFO_NULL, &node_comm);
+    if (c->config.node_size > 0) {
+        MPI_Comm_rank(node_comm, &i);
+        MPI_Comm_split(node_comm, i / c->config.node_size, rank, &c->node_comm);
+        MPI_Comm_free(&node_comm);
+    } else {
+        c->node_comm = node_comm;
+    }
+    MPI_Comm_rank(c->node_comm, &c->node_rank);
+    MPI_Comm_size(c->node_comm, &c->node_ranks);
+
+    // The first rank of a node names it
+    node_id = rank;
+    MPI_Bcast(&node_id, 1, MPI_INT, 0, c->node_comm);
+    lead_A = shared_dim_init(c, &c->shared_A, c->cart_col_comm, node_id);
+    lead_B = shared_dim_init(c, &c->shared_B, c->cart_row_comm, node_id);
+
+    c->panel_A_bytes = shared_round((size_t)c->dist_A.local_rows * c->panel * type->size);
+    c->panel_B_bytes = shared_round((size_t)c->panel * c->dist_B.local_cols * type->size);
+    mine.A = 0;
+    mine.B = shared_round((size_t)c->dist_A.local_rows * c->dist_A.local_cols * type->size);
+    mine.panels_A = mine.B +
+        shared_round((size_t)c->dist_B.local_rows * c->dist_B.local_cols * type->size);
+    mine.panels_B = mine.panels_A + (lead_A ? 3 * c->panel_A_bytes : 0);
+    mine.lda_A = c->dist_A.local_cols;
+    size = mine.panels_B + (lead_B ? 3 * c->panel_B_bytes : 0);
+
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    MPI_Win_allocate_shared(size, 1, info, c->node_comm, &base, &c->window);
+    MPI_Info_free(&info);
+    memset(base, '\0', size);
+
+    c->segments = malloc(c->node_ranks * sizeof(char *));
+    c->layouts = malloc(c->node_ranks * sizeof(struct shared_layout));
+    assert(c->segments != NULL && c->layouts != NULL);
+    MPI_Allgather(&mine, sizeof(mine), MPI_BYTE, c->layouts, sizeof(mine),
+                  MPI_BYTE, c->node_comm);
+    for (i = 0; i < c->node_ranks; ++i) {
+        MPI_Win_shared_query(c->window, i, &size, &disp, &c->segments[i]);
+    }
+
+    // One passive epoch for the life of the context; MPI_Win_sync and
+    // barriers order the loads and stores of the ranks
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, c->window);
+}
+
+/*
+ * Return the width of the panel at global index k of the inner dimension K:
+ * at most panel, and clipped at the end of its nb wide block.
+ */
+static int panel_width(int k, int K, int nb, int panel)
+{
+    int kb = nb - k % nb;
+
+    if (kb > panel) {
+        kb = panel;
+    }
+    if (kb > K - k) {
+        kb = K - k;
+    }
+    return kb;
+}
+
+/*
+ * Return the persistent receive and send of a shift out of buffer pair i:
+ * of the columns of A of process column j, or if which is 1 of the rows of
+ * B of process row j.
+ */
+static MPI_Request *shift_request(const struct matrix_context *c, int which,
+                                  int i, int j)
+{
+    if (which == 0) {
+        return &c->shift_requests[(i * c->pcols + j) * 2];
+    }
+    return &c->shift_requests[(4 * c->pcols) + (i * c->prows + j) * 2];
+}
+
+/*
+ * Set up the persistent shifts of Cannon's algorithm. Counts depend on the
+ * process column (and row) whose blocks move, so each buffer pair i has a
+ * request pair per column of A: it sends the columns of column j from pair
+ * i to the left and receives those of column j + 1 into pair i ^ 1. B
+ * likewise has a pair per process row.
+ */
+static void shift_init(struct matrix_context *c)
+{
+    const MPI_Datatype type = c->config.type->mpi;
+    const int K = c->config.K;
+    const int nb = c->dist_C.nb;
+    const int M_local = c->dist_C.local_rows;
+    const int N_local = c->dist_C.local_cols;
+    MPI_Request *r;
+    int i, j;
+
+    c->shift_requests = malloc(4 * (c->pcols + c->prows) * sizeof(MPI_Request));
+    assert(c->shift_requests != NULL);
+    for (i = 0; i < 2; ++i) {
+        for (j = 0; j < c->pcols; ++j) {
+            r = shift_request(c, 0, i, j);
+            MPI_Recv_init(c->shift_A[i ^ 1],
+                          M_local * matrix_numroc(K, nb, (j + 1) % c->pcols, c->pcols),
+                          type, c->right, 1, c->cart_comm, &r[0]);
+            MPI_Send_init(c->shift_A[i],
+                          M_local * matrix_numroc(K, nb, j, c->pcols),
+                          type, c->left, 1, c->cart_comm, &r[1]);
+        }
+        for (j = 0; j < c->prows; ++j) {
+            r = shift_request(c, 1, i, j);
+            MPI_Recv_init(c->shift_B[i ^ 1],
+                          matrix_numroc(K, nb, (j + 1) % c->prows, c->prows) * N_local,
+                          type, c->down, 2, c->cart_comm, &r[0]);
+            MPI_Send_init(c->shift_B[i],
+                          matrix_numroc(K, nb, j, c->prows) * N_local,
+                          type, c->up, 2, c->cart_comm, &r[1]);
+        }
+    }
+}
+
+/*
+ * Return the persistent broadcast of table into the buffers of slot from
+ * root with the given width, or NULL if there is none.
+ */
+static struct persistent_bcast *bcast_find(struct persistent_bcast *table,
+                                           int count, int slot, int root,
+                                           int width)
+{
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        if (table[i].slot == slot && table[i].root == root &&
+            table[i].width == width) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+#ifdef BCAST_INIT
+/*
+ * Add a persistent broadcast of count elements of buf to table unless one
+ * with the same slot, root and width is there already. Every process of comm
+ * walks the panels in the same order, so the collective inits match.
+ */
+static void bcast_add(struct persistent_bcast **table, int *n, int slot,
+                      int root, int width, void *buf, int count,
+                      MPI_Datatype type, MPI_Comm comm)
+{
+    struct persistent_bcast *b;
+
+    if (bcast_find(*table, *n, slot, root, width) != NULL) {
+        return;
+    }
+    *table = realloc(*table, (*n + 1) * sizeof(**table));
+    assert(*table != NULL);
+    b = &(*table)[(*n)++];
+    b->slot = slot;
+    b->root = root;
+    b->width = width;
+    BCAST_INIT(buf, count, type, root, comm, MPI_INFO_NULL, &b->request);
+}
+
+/*
+ * Set up the persistent broadcasts of SUMMA's panels. A request is bound to
+ * its buffer, root and count, so panels always travel through the panel
+ * buffers and panels that agree on all three share one. Their number is
+ * bounded by the two buffers, the roots and the few distinct widths rather
+ * than growing with K.
+ */
+static void bcast_init(struct matrix_context *c)
+{
+    const struct matrix_type *type = c->config.type;
+    const int K = c->config.K;
+    const int nb = c->dist_A.nb;
+    const int rows = c->dist_A.local_rows;
+    const int cols = c->dist_B.local_cols;
+    int j, k, kb;
+
+    for (j = 0, k = 0; k < K; k += kb, ++j) {
+        kb = panel_width(k, K, nb, c->panel);
+        bcast_add(&c->bcast_A, &c->bcast_count_A, j % 2,
+                  (k / nb) % c->dist_A.pcols, kb, c->panels[j % 2].recv_A,
+                  rows * kb, type->mpi, c->cart_col_comm);
+        bcast_add(&c->bcast_B, &c->bcast_count_B, j % 2,
+                  (k / nb) % c->dist_B.prows, kb, c->panels[j % 2].recv_B,
+                  kb * cols, type->mpi, c->cart_row_comm);
+    }
+}
+#endif
+
+/*
+ * Set up the grid, the distributions and the buffers of the algorithm.
+ */
+int matrix_context_create(MPI_Comm comm, const struct matrix_config *config,
+                          struct matrix_context **ctx)
+{
+    struct matrix_context *c;
+    const struct matrix_type *type = config->type;
+    const int periods[3] = { 1, 1, 0 };
+    const int reorder = 1;
+    const int cart_row_dims[2] = { 1, 0 };
+    const int cart_col_dims[2] = { 0, 1 };
+    const int layer_dims[3] = { 1, 1, 0 };
+    const int depth_dims[3] = { 0, 0, 1 };
+    int procs, rank, prows, pcols, slices, nb, i, rc;
+    int cart_dims[3], stack_coords[3];
+
+    // The 2.5D algorithm stacks layers of square grids; the grid side must
+    // split Cannon's steps evenly between the layers. The other algorithms
+    // take any grid.
+    MPI_Comm_size(comm, &procs);
+    const int layers = (config->algorithm == MATRIX_25D && config->replicas > 1)
+                     ? config->replicas : 1;
+    if (config->algorithm == MATRIX_25D) {
+        prows = pcols = (int)(sqrt(procs / layers) + 0.5);
+        if (prows * pcols * layers != procs || prows % layers != 0) {
+            return MPI_ERR_DIMS;
+        }
+    } else {
+        prows = config->prows;
+        pcols = config->pcols;
+        if (matrix_dist_grid(procs, &prows, &pcols) != 0) {
+            return MPI_ERR_DIMS;
+        }
+    }
+    if (config->shared && config->rma) {
+        return MPI_ERR_ARG;
+    }
+    for (slices = prows; slices % pcols != 0; slices += prows)
+        ;
+
+    c = calloc(1, sizeof(*c));
+    assert(c != NULL);
+    c->config = *config;
+    c->prows = prows;
+    c->pcols = pcols;
+    c->slices = slices;
+    c->layers = layers;
+    c->columns_t = MPI_DATATYPE_NULL;
+    c->stack_comm = c->depth_comm = MPI_COMM_NULL;
+    c->node_comm = MPI_COMM_NULL;
+
+    // Use a cartesian process topology with subtopologies for rows and cols;
+    // the 2.5D algorithm stacks one such grid per layer
+    cart_dims[0] = prows;
+    cart_dims[1] = pcols;
+    cart_dims[2] = layers;
+    if (config->algorithm == MATRIX_25D) {
+        MPI_Cart_create(comm, 3, cart_dims, periods, reorder, &c->stack_comm);
+        MPI_Cart_sub(c->stack_comm, layer_dims, &c->cart_comm);
+        MPI_Cart_sub(c->stack_comm, depth_dims, &c->depth_comm);
+        MPI_Comm_rank(c->stack_comm, &rank);
+        MPI_Cart_coords(c->stack_comm, rank, 3, stack_coords);
+        c->layer = stack_coords[2];
+    } else {
+        MPI_Cart_create(comm, 2, cart_dims, periods, reorder, &c->cart_comm);
+    }
+    MPI_Cart_sub(c->cart_comm, cart_row_dims, &c->cart_row_comm);
+    MPI_Cart_sub(c->cart_comm, cart_col_dims, &c->cart_col_comm);
+    MPI_Comm_rank(c->cart_comm, &rank);
+    MPI_Cart_coords(c->cart_comm, rank, 2, c->coords);
+
+    // Distribute A, B and C block-cyclically in nb x nb blocks. By default
+    // Cannon's algorithm also gives each of its slices of the inner
+    // dimension a block, so that no step of a rectangular grid idles.
+    nb = config->block > 0 ? config->block
+       : matrix_dist_block(config->M, config->K, config->N, prows, pcols);
+    if (config->block <= 0 && config->algorithm == MATRIX_CANNON
+        && (config->K + slices - 1) / slices < nb) {
+        nb = (config->K + slices - 1) / slices;
+    }
+    matrix_dist_init(&c->dist_A, config->M, config->K, nb, prows, pcols,
+                     c->coords[0], c->coords[1]);
+    matrix_dist_init(&c->dist_B, config->K, config->N, nb, prows, pcols,
+                     c->coords[0], c->coords[1]);
+    matrix_dist_init(&c->dist_C, config->M, config->N, nb, prows, pcols,
+                     c->coords[0], c->coords[1]);
+    const int M_local = c->dist_C.local_rows;
+    const int N_local = c->dist_C.local_cols;
+
+    if (config->algorithm != MATRIX_SUMMA) {
+        // Each layer runs its own share of Cannon's steps, one per slice
+        c->steps = slices / layers;
+        c->first_step = c->layer * c->steps;
+
+        // Process column 0 and row 0 own the most columns of A and rows of B,
+        // so their share bounds every buffer a block of A or B is shifted into
+        const int max_K_A = matrix_numroc(config->K, nb, 0, pcols);
+        const int max_K_B = matrix_numroc(config->K, nb, 0, prows);
+        const size_t shift_bytes =
+            matrix_arena_bytes((size_t)M_local * max_K_A * type->size)
+          + matrix_arena_bytes((size_t)max_K_B * N_local * type->size);
+        const size_t copy_bytes = c->layer == 0 ? 0
+          : matrix_arena_bytes((size_t)M_local * c->dist_A.local_cols * type->size)
+          + matrix_arena_bytes((size_t)c->dist_B.local_rows * N_local * type->size)
+          + matrix_arena_bytes((size_t)M_local * N_local * type->acc->size);
+        rc = matrix_arena_map(&c->blocks, 2 * shift_bytes + copy_bytes);
+        assert(rc == 0);
+        if (c->layer > 0) {
+            c->copy_A = matrix_arena_zeros(&c->blocks, M_local,
+                                           c->dist_A.local_cols, type->size);
+            c->copy_B = matrix_arena_zeros(&c->blocks, c->dist_B.local_rows,
+                                           N_local, type->size);
+            c->partial_C = matrix_arena_zeros(&c->blocks, M_local, N_local,
+                                              type->acc->size);
+            assert(c->copy_A != NULL && c->copy_B != NULL && c->partial_C != NULL);
+        }
+        for (i = 0; i < 2; ++i) {
+            c->shift_A[i] = matrix_arena_zeros(&c->blocks, M_local, max_K_A,
+                                               type->size);
+            c->shift_B[i] = matrix_arena_zeros(&c->blocks, max_K_B, N_local,
+                                               type->size);
+            assert(c->shift_A[i] != NULL && c->shift_B[i] != NULL);
+        }
+
+        // Row i shifts left i ranks and column j shifts up j ranks in the
+        // initial skew, plus the steps of the layers below, every row and
+        // column by 1 rank afterwards
+        MPI_Cart_shift(c->cart_comm, 1, c->coords[0] + c->first_step,
+                       &c->skew_left, &c->skew_right);
+        MPI_Cart_shift(c->cart_comm, 0, c->coords[1] + c->first_step,
+                       &c->skew_up, &c->skew_down);
+        MPI_Cart_shift(c->cart_comm, 1, 1, &c->left, &c->right);
+        MPI_Cart_shift(c->cart_comm, 0, 1, &c->up, &c->down);
+
+        if (config->persistent && config->overlap) {
+            shift_init(c);
+        }
+    } else {
+        // Panels never straddle blocks so that each has a single owner
+        c->panel = (config->panel <= 0 || config->panel > nb) ? nb : config->panel;
+        if (config->shared) {
+            shared_init(c);
+        }
+        if (config->rma) {
+            // Windows span the whole grid: windows over the row and column
+            // communicators, which are split and may share a context id,
+            // break some MPI libraries
+            MPI_Win_allocate((MPI_Aint)M_local * c->dist_A.local_cols * type->size,
+                             type->size, MPI_INFO_NULL, c->cart_comm,
+                             &c->exposed_A, &c->window_A);
+            MPI_Win_allocate((MPI_Aint)c->dist_B.local_rows * N_local * type->size,
+                             type->size, MPI_INFO_NULL, c->cart_comm,
+                             &c->exposed_B, &c->window_B);
+            MPI_Win_lock_all(MPI_MODE_NOCHECK, c->window_A);
+            MPI_Win_lock_all(MPI_MODE_NOCHECK, c->window_B);
+        }
+        if (!config->shared) {
+            rc = matrix_arena_map(&c->blocks, 2 * (
+                matrix_arena_bytes((size_t)M_local * c->panel * type->size)
+              + matrix_arena_bytes((size_t)c->panel * N_local * type->size)));
+            assert(rc == 0);
+        }
+        for (i = 0; i < 2 && !config->shared; ++i) {
+            c->panels[i].recv_A = matrix_arena_zeros(&c->blocks, M_local,
+                                                     c->panel, type->size);
+            c->panels[i].recv_B = matrix_arena_zeros(&c->blocks, c->panel,
+                                                     N_local, type->size);
+            assert(c->panels[i].recv_A != NULL && c->panels[i].recv_B != NULL);
+        }
+        MPI_Type_vector(M_local, c->panel, c->dist_A.local_cols, type->mpi,
+                        &c->columns_t);
+        MPI_Type_commit(&c->columns_t);
+#ifdef BCAST_INIT
+        if (config->persistent && !config->shared && !config->rma) {
+            bcast_init(c);
+        }
+#endif
+    }
+
+    *ctx = c;
+    return MPI_SUCCESS;
+}
+
+void matrix_context_free(struct matrix_context *ctx)
+{
+    int i;
+
+    if (ctx == NULL) {
+        return;
+    }
+    for (i = 0; ctx->shift_requests != NULL && i < 4 * (ctx->pcols + ctx->prows); ++i) {
+        MPI_Request_free(&ctx->shift_requests[i]);
+    }
+    free(ctx->shift_requests);
+    for (i = 0; i < ctx->bcast_count_A; ++i) {
+        MPI_Request_free(&ctx->bcast_A[i].request);
+    }
+    for (i = 0; i < ctx->bcast_count_B; ++i) {
+        MPI_Request_free(&ctx->bcast_B[i].request);
+    }
+    free(ctx->bcast_A);
+    free(ctx->bcast_B);
+    for (i = 0; i < 2; ++i) {
+        free(ctx->sparse_A[i]);
+        free(ctx->sparse_B[i]);
+        free(ctx->sparse_copy[i]);
+        free(ctx->sparse_slice[i]);
+    }
+    matrix_arena_free(&ctx->blocks);
+    if (ctx->columns_t != MPI_DATATYPE_NULL) {
+        MPI_Type_free(&ctx->columns_t);
+    }
+    if (ctx->config.algorithm == MATRIX_SUMMA && ctx->config.rma) {
+        MPI_Win_unlock_all(ctx->window_A);
+        MPI_Win_unlock_all(ctx->window_B);
+        MPI_Win_free(&ctx->window_A);
+        MPI_Win_free(&ctx->window_B);
+    }
+    if (ctx->node_comm != MPI_COMM_NULL) {
+        MPI_Win_unlock_all(ctx->window);
+        MPI_Win_free(&ctx->window);
+        MPI_Comm_free(&ctx->node_comm);
+        if (ctx->shared_A.leader_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&ctx->shared_A.leader_comm);
+        }
+        if (ctx->shared_B.leader_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&ctx->shared_B.leader_comm);
+        }
+        free(ctx->shared_A.leader);
+        free(ctx->shared_A.peer);
+        free(ctx->shared_B.leader);
+        free(ctx->shared_B.peer);
+        free(ctx->segments);
+        free(ctx->layouts);
+    }
+    MPI_Comm_free(&ctx->cart_row_comm);
+    MPI_Comm_free(&ctx->cart_col_comm);
+    MPI_Comm_free(&ctx->cart_comm);
+    if (ctx->stack_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&ctx->depth_comm);
+        MPI_Comm_free(&ctx->stack_comm);
+    }
+    free(ctx);
+}
+
+MPI_Comm matrix_context_comm(const struct matrix_context *ctx)
+{
+    return ctx->cart_comm;
+}
+
+const struct matrix_dist *matrix_context_dist(const struct matrix_context *ctx,
+                                              int which)
+{
+    switch (which) {
+        case 0:
+            return &ctx->dist_A;
+        case 1:
+            return &ctx->dist_B;
+        default:
+            return &ctx->dist_C;
+    }
+}
+
+int matrix_context_layer(const struct matrix_context *ctx)
+{
+    return ctx->layer;
+}
+
+int matrix_context_layers(const struct matrix_context *ctx)
+{
+    return ctx->layers;
+}
+
+int matrix_context_panel(const struct matrix_context *ctx)
+{
+    return ctx->panel;
+}
+
+int matrix_context_persistent(const struct matrix_context *ctx)
+{
+    return ctx->shift_requests != NULL || ctx->bcast_A != NULL;
+}
+
+int matrix_context_node_ranks(const struct matrix_context *ctx)
+{
+    return ctx->node_comm != MPI_COMM_NULL ? ctx->node_ranks : 0;
+}
+
+void *matrix_context_window(const struct matrix_context *ctx, int which)
+{
+    const struct shared_layout *mine;
+
+    if (ctx->config.algorithm == MATRIX_SUMMA && ctx->config.rma) {
+        return which == 0 ? ctx->exposed_A : ctx->exposed_B;
+    }
+    if (ctx->node_comm == MPI_COMM_NULL) {
+        return NULL;
+    }
+    mine = &ctx->layouts[ctx->node_rank];
+    return ctx->segments[ctx->node_rank] + (which == 0 ? mine->A : mine->B);
+}
+
+/*
+ * Multiply slice x of the inner dimension, global blocks x, x + L, x + 2L,
+ * ... with L = lcm(prows, pcols), out of the shifted local matrices a, the
+ * K_A columns of A of process column x mod pcols, and b, the rows of B of
+ * process row x mod prows. On a square grid the slice is every block they
+ * hold, so they are multiplied whole.
+ */
+static void cannon_gemm(const struct matrix_context *ctx, int x,
+                        const void *a, int K_A, const void *b, void *local_C)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int M_local = ctx->dist_C.local_rows;
+    const int N_local = ctx->dist_C.local_cols;
+    int block, width;
+
+    if (ctx->prows == ctx->pcols) {
+        matrix_gemm(type, M_local, N_local, K_A, a, K_A, b, N_local,
+                    local_C, N_local);
+        return;
+    }
+    for (block = x % ctx->slices; block * nb < K; block += ctx->slices) {
+        width = K - block * nb < nb ? K - block * nb : nb;
+        matrix_gemm(type, M_local, N_local, width,
+                    (const char *)a + (size_t)(block / ctx->pcols) * nb * type->size,
+                    K_A,
+                    (const char *)b
+                    + (size_t)(block / ctx->prows) * nb * N_local * type->size,
+                    N_local, local_C, N_local);
+    }
+}
+
+/*
+ * Cannon's generalized algorithm. After the initial skew, process (i, j)
+ * holds the columns of A owned by process column (i + j + s) mod pcols and
+ * the rows of B owned by process row (i + j + s) mod prows in step s, and
+ * multiplies the blocks of the inner dimension both hold. Over lcm(prows,
+ * pcols) steps every pair of columns and rows meets once, and on a square
+ * grid the local matrices always match and are multiplied whole. A layer of
+ * the 2.5D algorithm runs only its own steps.
+ */
+static void cannon_multiply(struct matrix_context *ctx, const void *local_A,
+                            const void *local_B, void *local_C,
+                            struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int prows = ctx->prows, pcols = ctx->pcols;
+    const int M_local = ctx->dist_C.local_rows;
+    const int N_local = ctx->dist_C.local_cols;
+    void *cur_A = ctx->shift_A[0], *next_A = ctx->shift_A[1];
+    void *cur_B = ctx->shift_B[0], *next_B = ctx->shift_B[1];
+    void *swap;
+    double start;
+    int i, x;
+
+    // Use cartesian coordinates to guide Cannon's initial block shifts:
+    // Row 0 shifts left 0 ranks, row 1 shifts left 1 rank, etc.
+    // Col 0 shifts up 0 ranks, col 1 shifts up 1 rank, etc.
+    // Afterwards this process holds the columns of A and the rows of B of
+    // slice x.
+    start = MPI_Wtime();
+    matrix_trace_begin("skew");
+    x = ctx->coords[0] + ctx->coords[1] + ctx->first_step;
+    const int K_skewed_A = matrix_numroc(K, nb, x % pcols, pcols);
+    const int K_skewed_B = matrix_numroc(K, nb, x % prows, prows);
+    MPI_Sendrecv(local_A, M_local * ctx->dist_A.local_cols, type->mpi,
+                 ctx->skew_left, 1, cur_A, M_local * K_skewed_A, type->mpi,
+                 ctx->skew_right, 1, ctx->cart_comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(local_B, ctx->dist_B.local_rows * N_local, type->mpi,
+                 ctx->skew_up, 2, cur_B, K_skewed_B * N_local, type->mpi,
+                 ctx->skew_down, 2, ctx->cart_comm, MPI_STATUS_IGNORE);
+    matrix_trace_end();
+    stats->skew_time = MPI_Wtime() - start;
+
+    // Each process multiplies, accumulates and shifts its local data. Blocks
+    // arriving from the right (and from below) belong to the next process
+    // column (and row), which may own a different number of columns of A
+    // (and rows of B). The blocks need not return home after the last
+    // multiply, so it skips the shift.
+    stats->loop_time = MPI_Wtime();
+    matrix_trace_begin("loop");
+    for (i = 0; i < ctx->steps; ++i) {
+        MPI_Request requests[4];
+        const int shift = (i < ctx->steps - 1);
+        const int K_cur_A = matrix_numroc(K, nb, x % pcols, pcols);
+        const int K_cur_B = matrix_numroc(K, nb, x % prows, prows);
+        const int K_next_A = matrix_numroc(K, nb, (x + 1) % pcols, pcols);
+        const int K_next_B = matrix_numroc(K, nb, (x + 1) % prows, prows);
+
+        if (shift && ctx->shift_requests != NULL) {
+            // The same shifts as below, set up once with the context
+            memcpy(&requests[0], shift_request(ctx, 0, i % 2, x % pcols),
+                   2 * sizeof(MPI_Request));
+            memcpy(&requests[2], shift_request(ctx, 1, i % 2, x % prows),
+                   2 * sizeof(MPI_Request));
+            MPI_Startall(4, requests);
+        } else if (shift && ctx->config.overlap) {
+            // Overlap: the next blocks travel into the second buffer pair
+            // while the current pair is multiplied
+            MPI_Irecv(next_A, M_local * K_next_A, type->mpi, ctx->right, 1,
+                      ctx->cart_comm, &requests[0]);
+            MPI_Irecv(next_B, K_next_B * N_local, type->mpi, ctx->down, 2,
+                      ctx->cart_comm, &requests[1]);
+            MPI_Isend(cur_A, M_local * K_cur_A, type->mpi, ctx->left, 1,
+                      ctx->cart_comm, &requests[2]);
+            MPI_Isend(cur_B, K_cur_B * N_local, type->mpi, ctx->up, 2,
+                      ctx->cart_comm, &requests[3]);
+        }
+
+        // Multiply and accumulate local block; pending sends only read it
+        start = MPI_Wtime();
+        cannon_gemm(ctx, x, cur_A, K_cur_A, cur_B, local_C);
+        stats->compute_time += MPI_Wtime() - start;
+
+        if (shift && ctx->config.overlap) {
+            MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+        } else if (shift) {
+            // Shift block cur_A left by one rank and cur_B up by one rank
+            MPI_Sendrecv(cur_A, M_local * K_cur_A, type->mpi, ctx->left, 1,
+                         next_A, M_local * K_next_A, type->mpi, ctx->right, 1,
+                         ctx->cart_comm, MPI_STATUS_IGNORE);
+            MPI_Sendrecv(cur_B, K_cur_B * N_local, type->mpi, ctx->up, 2,
+                         next_B, K_next_B * N_local, type->mpi, ctx->down, 2,
+                         ctx->cart_comm, MPI_STATUS_IGNORE);
+        }
+        if (shift) {
+            swap = cur_A; cur_A = next_A; next_A = swap;
+            swap = cur_B; cur_B = next_B; next_B = swap;
+            ++x;
+        }
+    }
+    matrix_trace_end();
+    stats->loop_time = MPI_Wtime() - stats->loop_time;
+}
+
+/*
+ * Post the broadcasts of panel j, of width kb at global index k: columns of
+ * A travel along each process row from the process column that owns them, and
+ * rows of B along each process column from the owning process row. The owner
+ * broadcasts straight from its local matrix, using a strided type for the
+ * columns of A, and multiplies from there; everyone else receives into p's
+ * buffers. Full width panels use the type cached in the context. Persistent
+ * broadcasts start instead, after the owners copy the panel into p.
+ */
+static void panel_bcast(const struct matrix_context *ctx, struct panel *p,
+                        int j, int k, int kb, const void *local_A,
+                        const void *local_B)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const struct matrix_dist *dist_A = &ctx->dist_A;
+    const struct matrix_dist *dist_B = &ctx->dist_B;
+    const int block = k / dist_A->nb;
+    const int owner_col = block % dist_A->pcols;
+    const int owner_row = block % dist_B->prows;
+    const int offset_A = (block / dist_A->pcols) * dist_A->nb + k % dist_A->nb;
+    const int offset_B = (block / dist_B->prows) * dist_B->nb + k % dist_B->nb;
+    const int rows = dist_A->local_rows;
+    const int cols = dist_B->local_cols;
+    char *panel_A = (char *)local_A + (size_t)offset_A * type->size;
+    char *panel_B = (char *)local_B + (size_t)offset_B * cols * type->size;
+    MPI_Datatype columns_t;
+    int i;
+
+    p->kb = kb;
+
+    if (ctx->bcast_A != NULL) {
+        if (dist_A->mycol == owner_col) {
+            for (i = 0; i < rows; ++i) {
+                memcpy((char *)p->recv_A + (size_t)i * kb * type->size,
+                       panel_A + (size_t)i * dist_A->local_cols * type->size,
+                       (size_t)kb * type->size);
+            }
+        }
+        if (dist_B->myrow == owner_row) {
+            memcpy(p->recv_B, panel_B, (size_t)kb * cols * type->size);
+        }
+        p->a = p->recv_A;
+        p->lda = kb;
+        p->b = p->recv_B;
+        p->requests[0] = bcast_find(ctx->bcast_A, ctx->bcast_count_A, j % 2,
+                                    owner_col, kb)->request;
+        p->requests[1] = bcast_find(ctx->bcast_B, ctx->bcast_count_B, j % 2,
+                                    owner_row, kb)->request;
+        MPI_Startall(2, p->requests);
+        return;
+    }
+
+    if (dist_A->mycol == owner_col) {
+        if (kb == ctx->panel) {
+            columns_t = ctx->columns_t;
+        } else {
+            MPI_Type_vector(rows, kb, dist_A->local_cols, type->mpi, &columns_t);
+            MPI_Type_commit(&columns_t);
+        }
+        MPI_Ibcast(panel_A, 1, columns_t, owner_col, ctx->cart_col_comm,
+                   &p->requests[0]);
+        if (kb != ctx->panel) {
+            MPI_Type_free(&columns_t);
+        }
+        p->a = panel_A;
+        p->lda = dist_A->local_cols;
+    } else {
+        MPI_Ibcast(p->recv_A, rows * kb, type->mpi, owner_col,
+                   ctx->cart_col_comm, &p->requests[0]);
+        p->a = p->recv_A;
+        p->lda = kb;
+    }
+
+    if (dist_B->myrow == owner_row) {
+        MPI_Ibcast(panel_B, kb * cols, type->mpi, owner_row, ctx->cart_row_comm,
+                   &p->requests[1]);
+        p->b = panel_B;
+    } else {
+        MPI_Ibcast(p->recv_B, kb * cols, type->mpi, owner_row,
+                   ctx->cart_row_comm, &p->requests[1]);
+        p->b = p->recv_B;
+    }
+}
+
+/*
+ * SUMMA. The inner dimension is processed in panels of a chosen width that
+ * need not match the block size. Each process broadcasts its panels and then
+ * accumulates its local data; the broadcasts of panel i+1 are posted before
+ * panel i is multiplied.
+ */
+static void summa_multiply(struct matrix_context *ctx, const void *local_A,
+                           const void *local_B, void *local_C,
+                           struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int M_local = ctx->dist_C.local_rows;
+    const int N_local = ctx->dist_C.local_cols;
+    struct panel *panels = ctx->panels;
+    double start;
+    int i, j, k, kb, next;
+
+    stats->loop_time = MPI_Wtime();
+    matrix_trace_begin("loop");
+    panel_bcast(ctx, &panels[0], 0, 0, panel_width(0, K, nb, ctx->panel),
+                local_A, local_B);
+    for (i = 0, j = 0, k = 0; k < K; k += kb, i ^= 1, ++j) {
+        kb = panels[i].kb;
+        next = k + kb;
+        if (next < K) {
+            panel_bcast(ctx, &panels[i ^ 1], j + 1, next,
+                        panel_width(next, K, nb, ctx->panel), local_A, local_B);
+        }
+        MPI_Waitall(2, panels[i].requests, MPI_STATUSES_IGNORE);
+
+        // Multiply and accumulate the panel product
+        start = MPI_Wtime();
+        matrix_gemm(type, M_local, N_local, kb, panels[i].a, panels[i].lda,
+                    panels[i].b, N_local, local_C, N_local);
+        stats->compute_time += MPI_Wtime() - start;
+    }
+    matrix_trace_end();
+    stats->loop_time = MPI_Wtime() - stats->loop_time;
+}
+
+/*
+ * Post the transfers of the panel of width kb at global index k in node-aware
+ * SUMMA. Panels owned on this node are read in place from the owner's
+ * segment. Panels from other nodes travel between the leaders only: the
+ * leader of the owner's node broadcasts from the owner's segment, and every
+ * other leader receives into its panel buffer j, which its node peers read.
+ */
+static void shared_panel_bcast(const struct matrix_context *ctx,
+                               struct panel *p, int j, int k, int kb)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const struct matrix_dist *dist_A = &ctx->dist_A;
+    const struct matrix_dist *dist_B = &ctx->dist_B;
+    const struct shared_dim *shared_A = &ctx->shared_A;
+    const struct shared_dim *shared_B = &ctx->shared_B;
+    const struct shared_layout *layouts = ctx->layouts;
+    const int block = k / dist_A->nb;
+    const int owner_col = block % dist_A->pcols;
+    const int owner_row = block % dist_B->prows;
+    const int offset_A = (block / dist_A->pcols) * dist_A->nb + k % dist_A->nb;
+    const int offset_B = (block / dist_B->prows) * dist_B->nb + k % dist_B->nb;
+    const int peer_A = shared_A->peer[owner_col];
+    const int peer_B = shared_B->peer[owner_row];
+    const int lead_A = shared_A->lead_peer;
+    const int lead_B = shared_B->lead_peer;
+    const int rows = dist_A->local_rows;
+    const int cols = dist_B->local_cols;
+    MPI_Datatype columns_t;
+
+    p->kb = kb;
+    p->requests[0] = p->requests[1] = MPI_REQUEST_NULL;
+
+    if (peer_A != MPI_UNDEFINED) {
+        p->a = ctx->segments[peer_A] + layouts[peer_A].A
+             + (size_t)offset_A * type->size;
+        p->lda = layouts[peer_A].lda_A;
+    } else {
+        p->a = ctx->segments[lead_A] + layouts[lead_A].panels_A
+             + j * ctx->panel_A_bytes;
+        p->lda = kb;
+    }
+    if (shared_A->leader_comm != MPI_COMM_NULL) {
+        if (peer_A != MPI_UNDEFINED) {
+            MPI_Type_vector(rows, kb, p->lda, type->mpi, &columns_t);
+            MPI_Type_commit(&columns_t);
+            MPI_Ibcast((void *)p->a, 1, columns_t, shared_A->leader[owner_col],
+                       shared_A->leader_comm, &p->requests[0]);
+            MPI_Type_free(&columns_t);
+        } else {
+            MPI_Ibcast((void *)p->a, rows * kb, type->mpi,
+                       shared_A->leader[owner_col], shared_A->leader_comm,
+                       &p->requests[0]);
+        }
+    }
+
+    if (peer_B != MPI_UNDEFINED) {
+        p->b = ctx->segments[peer_B] + layouts[peer_B].B
+             + (size_t)offset_B * cols * type->size;
+    } else {
+        p->b = ctx->segments[lead_B] + layouts[lead_B].panels_B
+             + j * ctx->panel_B_bytes;
+    }
+    if (shared_B->leader_comm != MPI_COMM_NULL) {
+        MPI_Ibcast((void *)p->b, kb * cols, type->mpi,
+                   shared_B->leader[owner_row], shared_B->leader_comm,
+                   &p->requests[1]);
+    }
+}
+
+/*
+ * Node-aware SUMMA. The ranks of a node pass a barrier after each panel
+ * arrives, so that panels received by the leaders are complete before their
+ * peers read them. With three panel buffers a leader never receives into a
+ * buffer a slower peer still multiplies from.
+ */
+static void summa_multiply_shared(struct matrix_context *ctx,
+                                  const void *local_A, const void *local_B,
+                                  void *local_C,
+                                  struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int M_local = ctx->dist_C.local_rows;
+    const int N_local = ctx->dist_C.local_cols;
+    struct panel *panels = ctx->panels;
+    void *shared_A = matrix_context_window(ctx, 0);
+    void *shared_B = matrix_context_window(ctx, 1);
+    double start;
+    int i, j, k, kb, next;
+
+    // Peers read this rank's blocks in place from its segment
+    if (local_A != shared_A) {
+        memcpy(shared_A, local_A, (size_t)M_local * ctx->dist_A.local_cols * type->size);
+    }
+    if (local_B != shared_B) {
+        memcpy(shared_B, local_B, (size_t)ctx->dist_B.local_rows * N_local * type->size);
+    }
+
+    stats->loop_time = MPI_Wtime();
+    matrix_trace_begin("loop");
+    MPI_Win_sync(ctx->window);
+    MPI_Barrier(ctx->node_comm);
+    shared_panel_bcast(ctx, &panels[0], 0, 0, panel_width(0, K, nb, ctx->panel));
+    for (i = 0, j = 0, k = 0; k < K; k += kb, i ^= 1, j = (j + 1) % 3) {
+        kb = panels[i].kb;
+        next = k + kb;
+        if (next < K) {
+            shared_panel_bcast(ctx, &panels[i ^ 1], (j + 1) % 3, next,
+                               panel_width(next, K, nb, ctx->panel));
+        }
+        MPI_Waitall(2, panels[i].requests, MPI_STATUSES_IGNORE);
+        MPI_Win_sync(ctx->window);
+        MPI_Barrier(ctx->node_comm);
+        MPI_Win_sync(ctx->window);
+
+        // Multiply and accumulate the panel product
+        start = MPI_Wtime();
+        matrix_gemm(type, M_local, N_local, kb, panels[i].a, panels[i].lda,
+                    panels[i].b, N_local, local_C, N_local);
+        stats->compute_time += MPI_Wtime() - start;
+    }
+
+    // Peers may still read the blocks of this rank until all are done
+    MPI_Barrier(ctx->node_comm);
+    matrix_trace_end();
+    stats->loop_time = MPI_Wtime() - stats->loop_time;
+}
+
+/*
+ * Fetch the panel of width kb at global index k in one-sided SUMMA: columns
+ * of A from the window of the process column that owns them, with a strided
+ * type of the owner's row stride, and rows of B from the window of the
+ * owning process row. The owner multiplies from its own local matrix.
+ */
+static void rma_panel_get(const struct matrix_context *ctx, struct panel *p,
+                          int k, int kb, const void *local_A,
+                          const void *local_B)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const struct matrix_dist *dist_A = &ctx->dist_A;
+    const struct matrix_dist *dist_B = &ctx->dist_B;
+    const int block = k / dist_A->nb;
+    const int owner_col = block % dist_A->pcols;
+    const int owner_row = block % dist_B->prows;
+    const int offset_A = (block / dist_A->pcols) * dist_A->nb + k % dist_A->nb;
+    const int offset_B = (block / dist_B->prows) * dist_B->nb + k % dist_B->nb;
+    const int rows = dist_A->local_rows;
+    const int cols = dist_B->local_cols;
+    const int owner_A[2] = { dist_A->myrow, owner_col };
+    const int owner_B[2] = { owner_row, dist_B->mycol };
+    MPI_Datatype columns_t;
+    int lda, target;
+
+    p->kb = kb;
+
+    if (dist_A->mycol == owner_col) {
+        p->a = (const char *)local_A + (size_t)offset_A * type->size;
+        p->lda = dist_A->local_cols;
+        p->requests[0] = MPI_REQUEST_NULL;
+    } else {
+        lda = matrix_numroc(dist_A->cols, dist_A->nb, owner_col, dist_A->pcols);
+        MPI_Type_vector(rows, kb, lda, type->mpi, &columns_t);
+        MPI_Type_commit(&columns_t);
+        MPI_Cart_rank(ctx->cart_comm, owner_A, &target);
+        MPI_Rget(p->recv_A, rows * kb, type->mpi, target, offset_A, 1,
+                 columns_t, ctx->window_A, &p->requests[0]);
+        MPI_Type_free(&columns_t);
+        p->a = p->recv_A;
+        p->lda = kb;
+    }
+
+    if (dist_B->myrow == owner_row) {
+        p->b = (const char *)local_B + (size_t)offset_B * cols * type->size;
+        p->requests[1] = MPI_REQUEST_NULL;
+    } else {
+        MPI_Cart_rank(ctx->cart_comm, owner_B, &target);
+        MPI_Rget(p->recv_B, kb * cols, type->mpi, target,
+                 (MPI_Aint)offset_B * cols, kb * cols, type->mpi,
+                 ctx->window_B, &p->requests[1]);
+        p->b = p->recv_B;
+    }
+}
+
+/*
+ * One-sided SUMMA. After a barrier that publishes the blocks in the windows,
+ * every rank fetches its panels at its own pace: a slow rank delays only
+ * the ranks that wait for its data, not its whole row and column at every
+ * panel. A final barrier, outside the loop time, keeps the blocks in the
+ * windows until every rank has fetched its panels.
+ */
+static void summa_multiply_rma(struct matrix_context *ctx, const void *local_A,
+                               const void *local_B, void *local_C,
+                               struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int M_local = ctx->dist_C.local_rows;
+    const int N_local = ctx->dist_C.local_cols;
+    struct panel *panels = ctx->panels;
+    double start;
+    int i, k, kb, next;
+
+    if (local_A != ctx->exposed_A) {
+        memcpy(ctx->exposed_A, local_A,
+               (size_t)M_local * ctx->dist_A.local_cols * type->size);
+    }
+    if (local_B != ctx->exposed_B) {
+        memcpy(ctx->exposed_B, local_B,
+               (size_t)ctx->dist_B.local_rows * N_local * type->size);
+    }
+    MPI_Win_sync(ctx->window_A);
+    MPI_Win_sync(ctx->window_B);
+    MPI_Barrier(ctx->cart_comm);
+
+    stats->loop_time = MPI_Wtime();
+    matrix_trace_begin("loop");
+    rma_panel_get(ctx, &panels[0], 0, panel_width(0, K, nb, ctx->panel),
+                  local_A, local_B);
+    for (i = 0, k = 0; k < K; k += kb, i ^= 1) {
+        kb = panels[i].kb;
+        next = k + kb;
+        if (next < K) {
+            rma_panel_get(ctx, &panels[i ^ 1], next,
+                          panel_width(next, K, nb, ctx->panel), local_A, local_B);
+        }
+        MPI_Waitall(2, panels[i].requests, MPI_STATUSES_IGNORE);
+
+        // Multiply and accumulate the panel product
+        start = MPI_Wtime();
+        matrix_gemm(type, M_local, N_local, kb, panels[i].a, panels[i].lda,
+                    panels[i].b, N_local, local_C, N_local);
+        stats->compute_time += MPI_Wtime() - start;
+    }
+    matrix_trace_end();
+    stats->loop_time = MPI_Wtime() - stats->loop_time;
+
+    MPI_Barrier(ctx->cart_comm);
+}
+
+/*
+ * The 2.5D algorithm. Layer 0 broadcasts A and B along the stack, every
+ * layer runs its share of Cannon's steps on its copy, and the partial
+ * products of C are summed back into layer 0. Each layer moves only 1/c of
+ * the blocks Cannon's algorithm would, in exchange for c copies of A and B.
+ */
+static void matrix25d_multiply(struct matrix_context *ctx, const void *local_A,
+                               const void *local_B, void *local_C,
+                               struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int count_A = ctx->dist_A.local_rows * ctx->dist_A.local_cols;
+    const int count_B = ctx->dist_B.local_rows * ctx->dist_B.local_cols;
+    const int count_C = ctx->dist_C.local_rows * ctx->dist_C.local_cols;
+    MPI_Request requests[2];
+    double start;
+
+    // Other layers receive into and accumulate in their own buffers
+    if (ctx->layer > 0) {
+        local_A = ctx->copy_A;
+        local_B = ctx->copy_B;
+        local_C = ctx->partial_C;
+        memset(local_C, '\0', (size_t)count_C * type->acc->size);
+    }
+
+    // Layer 0 only sends its blocks, so they stay unchanged
+    start = MPI_Wtime();
+    matrix_trace_begin("replicate");
+    MPI_Ibcast((void *)local_A, count_A, type->mpi, 0, ctx->depth_comm,
+               &requests[0]);
+    MPI_Ibcast((void *)local_B, count_B, type->mpi, 0, ctx->depth_comm,
+               &requests[1]);
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    matrix_trace_end();
+    stats->replicate_time = MPI_Wtime() - start;
+
+    cannon_multiply(ctx, local_A, local_B, local_C, stats);
+
+    start = MPI_Wtime();
+    matrix_trace_begin("reduce");
+    MPI_Reduce(ctx->layer == 0 ? MPI_IN_PLACE : local_C, local_C, count_C,
+               type->acc->mpi, MPI_SUM, 0, ctx->depth_comm);
+    matrix_trace_end();
+    stats->reduce_time = MPI_Wtime() - start;
+}
+
+int matrix_context_multiply(struct matrix_context *ctx, const void *local_A,
+                            const void *local_B, void *local_C,
+                            struct matrix_context_stats *stats)
+{
+    struct matrix_context_stats ignored;
+
+    if (stats == NULL) {
+        stats = &ignored;
+    }
+    memset(stats, '\0', sizeof(*stats));
+    if (ctx->config.algorithm == MATRIX_CANNON) {
+        cannon_multiply(ctx, local_A, local_B, local_C, stats);
+    } else if (ctx->config.algorithm == MATRIX_SUMMA && ctx->config.shared) {
+        summa_multiply_shared(ctx, local_A, local_B, local_C, stats);
+    } else if (ctx->config.algorithm == MATRIX_SUMMA && ctx->config.rma) {
+        summa_multiply_rma(ctx, local_A, local_B, local_C, stats);
+    } else if (ctx->config.algorithm == MATRIX_SUMMA) {
+        summa_multiply(ctx, local_A, local_B, local_C, stats);
+    } else {
+        matrix25d_multiply(ctx, local_A, local_B, local_C, stats);
+    }
+    return MPI_SUCCESS;
+}
+
+/*
+ * Send the sparse block s to dest and receive one from source into *buf,
+ * grown as needed. Blocks vary in size, so the sizes travel first. With
+ * requests the block itself travels nonblocking and requests[0] and
+ * requests[1] complete it; otherwise the exchange is done on return.
+ */
+static void sparse_exchange(const struct matrix_context *ctx,
+                            const struct matrix_sparse *s, int dest, int source,
+                            int tag, void **buf, size_t *capacity,
+                            MPI_Request *requests)
+{
+    uint64_t bytes;
+
+    MPI_Sendrecv(&s->bytes, 1, MPI_UINT64_T, dest, tag, &bytes, 1,
+                 MPI_UINT64_T, source, tag, ctx->cart_comm, MPI_STATUS_IGNORE);
+    assert(s->bytes <= INT_MAX && bytes <= INT_MAX);
+    matrix_sparse_reserve(buf, capacity, bytes);
+    if (requests != NULL) {
+        MPI_Irecv(*buf, (int)bytes, MPI_BYTE, source, tag, ctx->cart_comm,
+                  &requests[0]);
+        MPI_Isend(s, (int)s->bytes, MPI_BYTE, dest, tag, ctx->cart_comm,
+                  &requests[1]);
+    } else {
+        MPI_Sendrecv(s, (int)s->bytes, MPI_BYTE, dest, tag, *buf, (int)bytes,
+                     MPI_BYTE, source, tag, ctx->cart_comm, MPI_STATUS_IGNORE);
+    }
+}
+
+/*
+ * Multiply slice x of the inner dimension out of the sparse blocks a and b,
+ * as cannon_gemm does: whole on a square grid, else a block at a time, cut
+ * out of a and b.
+ */
+static void cannon_gemm_sparse(struct matrix_context *ctx, int x,
+                               const struct matrix_sparse *a,
+                               const struct matrix_sparse *b, void *local_C)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int N_local = ctx->dist_C.local_cols;
+    const struct matrix_sparse *columns, *rows;
+    int block, width;
+
+    if (ctx->prows == ctx->pcols) {
+        matrix_sparse_gemm(type, a, b, local_C, N_local);
+        return;
+    }
+    for (block = x % ctx->slices; block * nb < K; block += ctx->slices) {
+        width = K - block * nb < nb ? K - block * nb : nb;
+        columns = matrix_sparse_columns(type, a, (block / ctx->pcols) * nb,
+                                        width, &ctx->sparse_slice[0],
+                                        &ctx->sparse_slice_size[0]);
+        rows = matrix_sparse_rows(type, b, (block / ctx->prows) * nb, width,
+                                  &ctx->sparse_slice[1],
+                                  &ctx->sparse_slice_size[1]);
+        matrix_sparse_gemm(type, columns, rows, local_C, N_local);
+    }
+}
+
+/*
+ * Cannon's algorithm on sparse blocks: the same skew and shifts as
+ * cannon_multiply, but every block carries its own storage and size.
+ */
+static void cannon_multiply_sparse(struct matrix_context *ctx,
+                                   const struct matrix_sparse *local_A,
+                                   const struct matrix_sparse *local_B,
+                                   void *local_C,
+                                   struct matrix_context_stats *stats)
+{
+    void **A = ctx->sparse_A, **B = ctx->sparse_B;
+    size_t *A_size = ctx->sparse_A_size, *B_size = ctx->sparse_B_size;
+    double start;
+    int i, x, cur;
+
+    start = MPI_Wtime();
+    matrix_trace_begin("skew");
+    x = ctx->coords[0] + ctx->coords[1] + ctx->first_step;
+    sparse_exchange(ctx, local_A, ctx->skew_left, ctx->skew_right, 1,
+                    &A[0], &A_size[0], NULL);
+    sparse_exchange(ctx, local_B, ctx->skew_up, ctx->skew_down, 2,
+                    &B[0], &B_size[0], NULL);
+    matrix_trace_end();
+    stats->skew_time = MPI_Wtime() - start;
+
+    stats->loop_time = MPI_Wtime();
+    matrix_trace_begin("loop");
+    for (i = 0, cur = 0; i < ctx->steps; ++i, ++x, cur ^= 1) {
+        MPI_Request requests[4];
+        const int shift = (i < ctx->steps - 1);
+        const int overlap = shift && ctx->config.overlap;
+
+        if (overlap) {
+            sparse_exchange(ctx, A[cur], ctx->left, ctx->right, 1,
+                            &A[cur ^ 1], &A_size[cur ^ 1], &requests[0]);
+            sparse_exchange(ctx, B[cur], ctx->up, ctx->down, 2,
+                            &B[cur ^ 1], &B_size[cur ^ 1], &requests[2]);
+        }
+
+        start = MPI_Wtime();
+        cannon_gemm_sparse(ctx, x, A[cur], B[cur], local_C);
+        stats->compute_time += MPI_Wtime() - start;
+
+        if (overlap) {
+            MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+        } else if (shift) {
+            sparse_exchange(ctx, A[cur], ctx->left, ctx->right, 1,
+                            &A[cur ^ 1], &A_size[cur ^ 1], NULL);
+            sparse_exchange(ctx, B[cur], ctx->up, ctx->down, 2,
+                            &B[cur ^ 1], &B_size[cur ^ 1], NULL);
+        }
+    }
+    matrix_trace_end();
+    stats->loop_time = MPI_Wtime() - stats->loop_time;
+}
+
+/*
+ * Broadcast a sparse block along comm from root, which sends *block and
+ * everyone else receives into *buf, grown as needed. The size travels
+ * first; request completes the block.
+ */
+static void sparse_bcast(const struct matrix_sparse **block, int root,
+                         MPI_Comm comm, void **buf, size_t *capacity,
+                         MPI_Request *request)
+{
+    uint64_t bytes;
+    int rank;
+
+    MPI_Comm_rank(comm, &rank);
+    if (rank == root) {
+        bytes = (*block)->bytes;
+    }
+    MPI_Bcast(&bytes, 1, MPI_UINT64_T, root, comm);
+    assert(bytes <= INT_MAX);
+    if (rank != root) {
+        *block = matrix_sparse_reserve(buf, capacity, bytes);
+    }
+    MPI_Ibcast((void *)*block, (int)bytes, MPI_BYTE, root, comm, request);
+}
+
+/*
+ * Post the broadcasts of the sparse panel of width kb at global index k. The
+ * owners cut the panel out of their blocks into the buffers of panel i and
+ * broadcast it from there.
+ */
+static void sparse_panel_bcast(struct matrix_context *ctx, int i, int k, int kb,
+                               const struct matrix_sparse *local_A,
+                               const struct matrix_sparse *local_B,
+                               const struct matrix_sparse **a,
+                               const struct matrix_sparse **b)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const struct matrix_dist *dist_A = &ctx->dist_A;
+    const struct matrix_dist *dist_B = &ctx->dist_B;
+    const int block = k / dist_A->nb;
+    const int owner_col = block % dist_A->pcols;
+    const int owner_row = block % dist_B->prows;
+    const int offset_A = (block / dist_A->pcols) * dist_A->nb + k % dist_A->nb;
+    const int offset_B = (block / dist_B->prows) * dist_B->nb + k % dist_B->nb;
+    struct panel *p = &ctx->panels[i];
+
+    p->kb = kb;
+    if (dist_A->mycol == owner_col) {
+        *a = matrix_sparse_columns(type, local_A, offset_A, kb,
+                                   &ctx->sparse_A[i], &ctx->sparse_A_size[i]);
+    }
+    sparse_bcast(a, owner_col, ctx->cart_col_comm, &ctx->sparse_A[i],
+                 &ctx->sparse_A_size[i], &p->requests[0]);
+    if (dist_B->myrow == owner_row) {
+        *b = matrix_sparse_rows(type, local_B, offset_B, kb,
+                                &ctx->sparse_B[i], &ctx->sparse_B_size[i]);
+    }
+    sparse_bcast(b, owner_row, ctx->cart_row_comm, &ctx->sparse_B[i],
+                 &ctx->sparse_B_size[i], &p->requests[1]);
+}
+
+/*
+ * SUMMA on sparse blocks, with the panels and look-ahead of summa_multiply.
+ */
+static void summa_multiply_sparse(struct matrix_context *ctx,
+                                  const struct matrix_sparse *local_A,
+                                  const struct matrix_sparse *local_B,
+                                  void *local_C,
+                                  struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int K = ctx->config.K;
+    const int nb = ctx->dist_C.nb;
+    const int N_local = ctx->dist_C.local_cols;
+    struct panel *panels = ctx->panels;
+    const struct matrix_sparse *a[2], *b[2];
+    double start;
+    int i, k, kb, next;
+
+    stats->loop_time = MPI_Wtime();
+    matrix_trace_begin("loop");
+    sparse_panel_bcast(ctx, 0, 0, panel_width(0, K, nb, ctx->panel),
+                       local_A, local_B, &a[0], &b[0]);
+    for (i = 0, k = 0; k < K; k += kb, i ^= 1) {
+        kb = panels[i].kb;
+        next = k + kb;
+        if (next < K) {
+            sparse_panel_bcast(ctx, i ^ 1, next,
+                               panel_width(next, K, nb, ctx->panel),
+                               local_A, local_B, &a[i ^ 1], &b[i ^ 1]);
+        }
+        MPI_Waitall(2, panels[i].requests, MPI_STATUSES_IGNORE);
+
+        start = MPI_Wtime();
+        matrix_sparse_gemm(type, a[i], b[i], local_C, N_local);
+        stats->compute_time += MPI_Wtime() - start;
+    }
+    matrix_trace_end();
+    stats->loop_time = MPI_Wtime() - stats->loop_time;
+}
+
+/*
+ * The 2.5D algorithm on sparse blocks: layer 0 broadcasts its blocks along
+ * the stack, sizes first, then the layers proceed as in matrix25d_multiply.
+ */
+static void matrix25d_multiply_sparse(struct matrix_context *ctx,
+                                      const struct matrix_sparse *local_A,
+                                      const struct matrix_sparse *local_B,
+                                      void *local_C,
+                                      struct matrix_context_stats *stats)
+{
+    const struct matrix_type *type = ctx->config.type;
+    const int count_C = ctx->dist_C.local_rows * ctx->dist_C.local_cols;
+    MPI_Request requests[2];
+    double start;
+
+    if (ctx->layer > 0) {
+        local_C = ctx->partial_C;
+        memset(local_C, '\0', (size_t)count_C * type->acc->size);
+    }
+
+    start = MPI_Wtime();
+    matrix_trace_begin("replicate");
+    sparse_bcast(&local_A, 0, ctx->depth_comm, &ctx->sparse_copy[0],
+                 &ctx->sparse_copy_size[0], &requests[0]);
+    sparse_bcast(&local_B, 0, ctx->depth_comm, &ctx->sparse_copy[1],
+                 &ctx->sparse_copy_size[1], &requests[1]);
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    matrix_trace_end();
+    stats->replicate_time = MPI_Wtime() - start;
+
+    cannon_multiply_sparse(ctx, local_A, local_B, local_C, stats);
+
+    start = MPI_Wtime();
+    matrix_trace_begin("reduce");
+    MPI_Reduce(ctx->layer == 0 ? MPI_IN_PLACE : local_C, local_C, count_C,
+               type->acc->mpi, MPI_SUM, 0, ctx->depth_comm);
+    matrix_trace_end();
+    stats->reduce_time = MPI_Wtime() - start;
+}
+
+int matrix_context_multiply_sparse(struct matrix_context *ctx,
+                                   const struct matrix_sparse *local_A,
+                                   const struct matrix_sparse *local_B,
+                                   void *local_C,
+                                   struct matrix_context_stats *stats)
+{
+    struct matrix_context_stats ignored;
+
+    if (stats == NULL) {
+        stats = &ignored;
+    }
+    memset(stats, '\0', sizeof(*stats));
+    if (ctx->config.algorithm == MATRIX_CANNON) {
+        cannon_multiply_sparse(ctx, local_A, local_B, local_C, stats);
+    } else if (ctx->config.algorithm == MATRIX_SUMMA) {
+        summa_multiply_sparse(ctx, local_A, local_B, local_C, stats);
+    } else {
+        matrix25d_multiply_sparse(ctx, local_A, local_B, local_C, stats);
+    }
+    return MPI_SUCCESS;
+}
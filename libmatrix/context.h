@@ -0,0 +1,189 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_CONTEXT_H
+#define LIBMATRIX_CONTEXT_H
+
+#include <mpi.h>
+
+#include "libmatrix/dist.h"
+#include "libmatrix/sparse.h"
+#include "libmatrix/types.h"
+
+/*
+ * Parallel multiply algorithms over a prows x pcols process grid, or, for
+ * the 2.5D algorithm, a stack of square grids.
+ */
+enum matrix_algorithm {
+    MATRIX_CANNON,
+    MATRIX_SUMMA,
+    MATRIX_25D
+};
+
+/*
+ * Shape of a multiply of an M x K by a K x N matrix. block is the block
+ * size of the block-cyclic distribution, or 0 for matrix_dist_block's
+ * default. panel is SUMMA's panel width, or 0 for the block size, and
+ * overlap makes Cannon's shifts nonblocking. replicas is the number of
+ * layers c of the 2.5D algorithm, or 0 for 1: each layer holds a copy of A
+ * and B and runs 1/c of Cannon's steps, so c = 1 is Cannon's algorithm and
+ * c = np^(1/3) the 3D algorithm. shared makes SUMMA node-aware: the ranks
+ * of a node keep A and B in one shared memory window and read each other's
+ * panels in place, and only one rank per node and process row (or column)
+ * receives the panels of other nodes. node_size splits each node into
+ * groups of that many ranks, or 0 for none, to try the mode on one node.
+ * rma makes SUMMA one-sided instead: every rank exposes its blocks of A and
+ * B in RMA windows, and each fetches the panels it needs with MPI_Rget, one
+ * panel ahead, without waiting for the rest of its row or column.
+ * prows and pcols shape the grid of Cannon's algorithm and SUMMA; either
+ * may be 0 for matrix_dist_grid's choice. The 2.5D algorithm ignores them.
+ * persistent sets up the transfers of the multiply loop once, as persistent
+ * requests the multiplies restart: Cannon's overlapped shifts, and SUMMA's
+ * broadcasts if MPI has persistent collectives, one per panel buffer, root
+ * and width. Otherwise the transfers are posted anew.
+ */
+struct matrix_config {
+    enum matrix_algorithm algorithm;
+    const struct matrix_type *type;
+    int M, K, N;
+    int prows, pcols;
+    int block;
+    int panel;
+    int overlap;
+    int replicas;
+    int shared;
+    int node_size;
+    int rma;
+    int persistent;
+};
+
+/*
+ * Timings of one multiply on one process: the 2.5D algorithm's copy of A
+ * and B to every layer, Cannon's initial skew, the multiply loop, the local
+ * multiplies within the loop and the 2.5D algorithm's sum of the partial
+ * products of C.
+ */
+struct matrix_context_stats {
+    double replicate_time;
+    double skew_time;
+    double loop_time;
+    double compute_time;
+    double reduce_time;
+};
+
+/*
+ * A distributed multiply set up once and run any number of times. The
+ * context keeps its process grid and the row and column communicators, the
+ * distributions of A, B and C, the shift or panel buffers and the datatypes
+ * of the algorithm, so each multiply only moves and multiplies blocks.
+ */
+struct matrix_context;
+
+/*
+ * Create a context for config over comm, of any size for Cannon's algorithm
+ * and SUMMA, or for the 2.5D algorithm c * q * q processes with c dividing
+ * q. Collective over comm. Returns an MPI error code: MPI_ERR_DIMS if the
+ * size of comm does not fit the grid or the algorithm and MPI_ERR_ARG if
+ * config asks for both shared and rma.
+ */
+int matrix_context_create(MPI_Comm comm, const struct matrix_config *config,
+                          struct matrix_context **ctx);
+
+/*
+ * Free a context and everything it holds. Collective.
+ */
+void matrix_context_free(struct matrix_context *ctx);
+
+/*
+ * Return the cartesian communicator of the process grid, whose shape the
+ * distributions of matrix_context_dist give, for the 2.5D algorithm the
+ * q x q grid of this process's layer. The rank of a process in
+ * it may differ from its rank in the communicator the context was created
+ * over.
+ */
+MPI_Comm matrix_context_comm(const struct matrix_context *ctx);
+
+/*
+ * Return the layer of this process and the number of layers: always 0 and
+ * 1 except for the 2.5D algorithm. Only layer 0 holds A, B and C.
+ */
+int matrix_context_layer(const struct matrix_context *ctx);
+int matrix_context_layers(const struct matrix_context *ctx);
+
+/*
+ * Return the distribution of A, B or C (which is 0, 1 or 2) on this
+ * process. Local arrays passed to matrix_context_multiply hold
+ * local_rows x local_cols elements of it.
+ */
+const struct matrix_dist *matrix_context_dist(const struct matrix_context *ctx,
+                                              int which);
+
+/*
+ * Return SUMMA's panel width, or 0 for Cannon.
+ */
+int matrix_context_panel(const struct matrix_context *ctx);
+
+/*
+ * Return nonzero if the multiply loop runs on persistent requests.
+ */
+int matrix_context_persistent(const struct matrix_context *ctx);
+
+/*
+ * Return the number of ranks that share memory with this one, including
+ * itself, or 0 if the context does not share blocks.
+ */
+int matrix_context_node_ranks(const struct matrix_context *ctx);
+
+/*
+ * Return the local array of A or B (which is 0 or 1) in the memory window
+ * of a shared or rma context, or NULL. A multiply of the arrays returned
+ * reads them in place; other local arrays are first copied there.
+ */
+void *matrix_context_window(const struct matrix_context *ctx, int which);
+
+/*
+ * Multiply the distributed matrices A and B and accumulate the product in
+ * the distributed matrix C, given the local arrays of this process. A and B
+ * are left unchanged, so the same blocks may be multiplied again. Processes
+ * of the 2.5D algorithm's other layers ignore their local arrays, which may
+ * be NULL. Collective over the grid; stats may be NULL. Returns an MPI error
+ * code.
+ */
+int matrix_context_multiply(struct matrix_context *ctx, const void *local_A,
+                            const void *local_B, void *local_C,
+                            struct matrix_context_stats *stats);
+
+/*
+ * Like matrix_context_multiply, with the local blocks of A and B stored as
+ * sparse blocks, from matrix_sparse_scatter or matrix_sparse_generate, and
+ * C dense. Blocks move with their storage, so a sparse multiply moves only
+ * the nonzeros, plus their indices.
+ */
+int matrix_context_multiply_sparse(struct matrix_context *ctx,
+                                   const struct matrix_sparse *local_A,
+                                   const struct matrix_sparse *local_B,
+                                   void *local_C,
+                                   struct matrix_context_stats *stats);
+
+#endif /* LIBMATRIX_CONTEXT_H */
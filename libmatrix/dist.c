@@ -0,0 +1,349 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "libmatrix/dist.h"
+
+/*
+ * Count the elements of n that process iproc owns: every process owns
+ * (n / nb) / nprocs full blocks, the first (n / nb) % nprocs own one more,
+ * and the next one owns the ragged remainder.
+ */
+int matrix_numroc(int n, int nb, int iproc, int nprocs)
+{
+    const int blocks = n / nb;
+    const int extra = blocks % nprocs;
+    int count = (blocks / nprocs) * nb;
+
+    if (iproc < extra) {
+        count += nb;
+    } else if (iproc == extra) {
+        count += n % nb;
+    }
+    return count;
+}
+
+/*
+ * Map a local index to its global index: local block l / nb is the process's
+ * (l / nb)-th block, global block (l / nb) * nprocs + iproc.
+ */
+int matrix_indxl2g(int l, int nb, int iproc, int nprocs)
+{
+    return ((l / nb) * nprocs + iproc) * nb + l % nb;
+}
+
+/*
+ * Return the default block size for an M x K by K x N multiply.
+ */
+int matrix_dist_block(int M, int K, int N, int prows, int pcols)
+{
+    const int pmax = prows > pcols ? prows : pcols;
+    int nb = (M + prows - 1) / prows;
+
+    if ((K + pmax - 1) / pmax < nb) {
+        nb = (K + pmax - 1) / pmax;
+    }
+    if ((N + pcols - 1) / pcols < nb) {
+        nb = (N + pcols - 1) / pcols;
+    }
+    return nb > 0 ? nb : 1;
+}
+
+/*
+ * Fill in the process grid. MPI_Dims_create fails on dimensions that do not
+ * divide procs, so they are checked first.
+ */
+int matrix_dist_grid(int procs, int *prows, int *pcols)
+{
+    int dims[2] = { *prows, *pcols };
+
+    if (dims[0] < 0 || dims[1] < 0) {
+        return 1;
+    }
+    if (procs % ((dims[0] > 0 ? dims[0] : 1) * (dims[1] > 0 ? dims[1] : 1)) != 0) {
+        return 1;
+    }
+    if (dims[0] > 0 && dims[1] > 0 && dims[0] * dims[1] != procs) {
+        return 1;
+    }
+    MPI_Dims_create(procs, 2, dims);
+    *prows = dims[0];
+    *pcols = dims[1];
+    return 0;
+}
+
+/*
+ * Describe the local part of a rows x cols matrix on process (myrow, mycol).
+ */
+void matrix_dist_init(struct matrix_dist *d, int rows, int cols, int nb,
+                      int prows, int pcols, int myrow, int mycol)
+{
+    d->rows = rows;
+    d->cols = cols;
+    d->nb = nb;
+    d->prows = prows;
+    d->pcols = pcols;
+    d->myrow = myrow;
+    d->mycol = mycol;
+    d->local_rows = matrix_numroc(rows, nb, myrow, prows);
+    d->local_cols = matrix_numroc(cols, nb, mycol, pcols);
+}
+
+/*
+ * Create the type that selects, from the global matrix, the elements owned by
+ * process p in the order they are stored locally.
+ */
+static void dist_type(const struct matrix_dist *d, int p, MPI_Datatype elem,
+                      MPI_Datatype *type)
+{
+    const int gsizes[2] = { d->rows, d->cols };
+    const int distribs[2] = { MPI_DISTRIBUTE_CYCLIC, MPI_DISTRIBUTE_CYCLIC };
+    const int dargs[2] = { d->nb, d->nb };
+    const int psizes[2] = { d->prows, d->pcols };
+
+    MPI_Type_create_darray(d->prows * d->pcols, p, 2, gsizes, distribs, dargs,
+                           psizes, MPI_ORDER_C, elem, type);
+    MPI_Type_commit(type);
+}
+
+/*
+ * Move a distributed matrix between root and all processes in one
+ * MPI_Alltoallw: root exchanges one darray element per process, every
+ * process exchanges its contiguous local array with root.
+ */
+static void dist_exchange(const struct matrix_dist *d, MPI_Datatype elem,
+                          void *global, void *local, int root, MPI_Comm comm,
+                          int scatter)
+{
+    int procs, rank, p;
+    int *global_counts, *local_counts, *displs;
+    MPI_Datatype *global_types, *local_types;
+
+    MPI_Comm_size(comm, &procs);
+    MPI_Comm_rank(comm, &rank);
+
+    global_counts = calloc(procs, sizeof(*global_counts));
+    local_counts = calloc(procs, sizeof(*local_counts));
+    displs = calloc(procs, sizeof(*displs));
+    global_types = calloc(procs, sizeof(*global_types));
+    local_types = calloc(procs, sizeof(*local_types));
+    assert(global_counts && local_counts && displs && global_types && local_types);
+
+    for (p = 0; p < procs; ++p) {
+        global_types[p] = elem;
+        local_types[p] = elem;
+        if (rank == root) {
+            dist_type(d, p, elem, &global_types[p]);
+            global_counts[p] = 1;
+        }
+    }
+    local_counts[root] = d->local_rows * d->local_cols;
+
+    if (scatter) {
+        MPI_Alltoallw(global, global_counts, displs, global_types,
+                      local, local_counts, displs, local_types, comm);
+    } else {
+        MPI_Alltoallw(local, local_counts, displs, local_types,
+                      global, global_counts, displs, global_types, comm);
+    }
+
+    if (rank == root) {
+        for (p = 0; p < procs; ++p) {
+            MPI_Type_free(&global_types[p]);
+        }
+    }
+    free(global_counts);
+    free(local_counts);
+    free(displs);
+    free(global_types);
+    free(local_types);
+}
+
+/*
+ * Distribute the global matrix on root to all processes.
+ */
+void matrix_dist_scatter(const struct matrix_dist *d, MPI_Datatype type,
+                         const void *global, void *local, int root,
+                         MPI_Comm comm)
+{
+    dist_exchange(d, type, (void *)global, local, root, comm, 1);
+}
+
+/*
+ * Collect the distributed matrix into the global matrix on root.
+ */
+void matrix_dist_gather(const struct matrix_dist *d, MPI_Datatype type,
+                        const void *local, void *global, int root,
+                        MPI_Comm comm)
+{
+    dist_exchange(d, type, global, (void *)local, root, comm, 0);
+}
+
+/*
+ * The file view of this process is its darray type.
+ */
+void matrix_dist_view(const struct matrix_dist *d, MPI_Datatype type,
+                      MPI_Datatype *view)
+{
+    dist_type(d, d->myrow * d->pcols + d->mycol, type, view);
+}
+
+/*
+ * Read the local array of every process of the file's communicator straight
+ * from the row-major global matrix at byte offset in fh, collectively. The
+ * darray type of this process is its file view, so each process reads only
+ * the blocks it owns.
+ */
+int matrix_dist_read(const struct matrix_dist *d, MPI_Datatype type,
+                     MPI_File fh, MPI_Offset offset, void *local)
+{
+    MPI_Datatype view;
+    int rc;
+
+    matrix_dist_view(d, type, &view);
+    rc = MPI_File_set_view(fh, offset, type, view, "native", MPI_INFO_NULL);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_read_all(fh, local, d->local_rows * d->local_cols, type,
+                               MPI_STATUS_IGNORE);
+    }
+    MPI_Type_free(&view);
+    return rc;
+}
+
+/*
+ * Write the local array collectively through the darray file view.
+ */
+int matrix_dist_write(const struct matrix_dist *d, MPI_Datatype type,
+                      MPI_File fh, MPI_Offset offset, const void *local)
+{
+    MPI_Datatype view;
+    int rc;
+
+    matrix_dist_view(d, type, &view);
+    rc = MPI_File_set_view(fh, offset, type, view, "native", MPI_INFO_NULL);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_write_all(fh, local, d->local_rows * d->local_cols,
+                                type, MPI_STATUS_IGNORE);
+    }
+    MPI_Type_free(&view);
+    return rc;
+}
+
+/*
+ * Finalize a 64-bit hash (splitmix64).
+ */
+static uint64_t mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * Hash each local element with its global index and sum the hashes, which
+ * wrap modulo 2^64 and add up in any order.
+ */
+void matrix_dist_checksum(const struct matrix_dist *d,
+                          const struct matrix_type *type, const void *local,
+                          int root, MPI_Comm comm, uint64_t *digest,
+                          double *norm)
+{
+    const unsigned char *x = local;
+    uint64_t sum = 0, h;
+    double norm2 = 0.0, total = 0.0;
+    int i, j;
+    size_t b;
+
+    for (i = 0; i < d->local_rows; ++i) {
+        const uint64_t row = matrix_indxl2g(i, d->nb, d->myrow, d->prows);
+        for (j = 0; j < d->local_cols; ++j) {
+            const uint64_t col = matrix_indxl2g(j, d->nb, d->mycol, d->pcols);
+            h = mix64(row * d->cols + col + 1);
+            for (b = 0; b < type->size; ++b) {
+                h = (h ^ x[b]) * 0x100000001b3ULL;
+            }
+            sum += mix64(h);
+            norm2 += type->norm2(x);
+            x += type->size;
+        }
+    }
+
+    MPI_Reduce(&sum, digest, 1, MPI_UINT64_T, MPI_SUM, root, comm);
+    MPI_Reduce(&norm2, &total, 1, MPI_DOUBLE, MPI_SUM, root, comm);
+    *norm = sqrt(total);
+}
+
+double matrix_dist_max_abs(const struct matrix_dist *d,
+                           const struct matrix_type *type, const void *local,
+                           MPI_Comm comm)
+{
+    const unsigned char *x = local;
+    const size_t count = (size_t)d->local_rows * d->local_cols;
+    double max2 = 0.0, n2, max;
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        n2 = type->norm2(x);
+        if (n2 > max2) {
+            max2 = n2;
+        }
+        x += type->size;
+    }
+    max = sqrt(max2);
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return max;
+}
+
+/*
+ * Hash the seed with the element's global index, as in the checksum.
+ */
+uint64_t matrix_dist_hash(uint64_t seed, uint64_t index)
+{
+    return mix64(mix64(seed + 0x9e3779b97f4a7c15ULL) ^ index);
+}
+
+void matrix_dist_generate(const struct matrix_dist *d,
+                          const struct matrix_type *type, uint64_t seed,
+                          void *local)
+{
+    unsigned char *x = local;
+    int i, j;
+
+    for (i = 0; i < d->local_rows; ++i) {
+        const uint64_t row = matrix_indxl2g(i, d->nb, d->myrow, d->prows);
+        for (j = 0; j < d->local_cols; ++j) {
+            const uint64_t col = matrix_indxl2g(j, d->nb, d->mycol, d->pcols);
+            type->random(matrix_dist_hash(seed, row * d->cols + col), x);
+            x += type->size;
+        }
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_DIST_H
+#define LIBMATRIX_DIST_H
+
+#include <stdint.h>
+#include <mpi.h>
+
+#include "libmatrix/types.h"
+
+/*
+ * A 2D block-cyclic (ScaLAPACK-style) distribution of a rows x cols matrix
+ * over a prows x pcols process grid. Global block (I, J) of nb x nb elements
+ * belongs to process (I % prows, J % pcols), which stores all of its blocks
+ * packed into one row-major local_rows x local_cols array. Ragged edge
+ * blocks are stored at their real size, without padding.
+ */
+struct matrix_dist {
+    int rows, cols;
+    int nb;
+    int prows, pcols;
+    int myrow, mycol;
+    int local_rows, local_cols;
+};
+
+/*
+ * Return the number of rows (or columns) out of n that process iproc of
+ * nprocs owns with blocks of nb.
+ */
+int matrix_numroc(int n, int nb, int iproc, int nprocs);
+
+/*
+ * Return the global index of local row (or column) l of process iproc of
+ * nprocs with blocks of nb.
+ */
+int matrix_indxl2g(int l, int nb, int iproc, int nprocs);
+
+/*
+ * Return a default block size for multiplying an M x K by a K x N matrix on
+ * a prows x pcols process grid: the largest that still gives every process a
+ * block of each matrix. When the grid divides the matrices evenly this is one
+ * block per process.
+ */
+int matrix_dist_block(int M, int K, int N, int prows, int pcols);
+
+/*
+ * Choose a prows x pcols process grid for procs processes. A dimension
+ * given as nonzero is kept and the others are made as close to each other
+ * as possible, as MPI_Dims_create does, so any procs gets a grid. Returns
+ * nonzero if the dimensions given do not fit procs.
+ */
+int matrix_dist_grid(int procs, int *prows, int *pcols);
+
+/*
+ * Describe the local part of a rows x cols matrix on process (myrow, mycol).
+ */
+void matrix_dist_init(struct matrix_dist *d, int rows, int cols, int nb,
+                      int prows, int pcols, int myrow, int mycol);
+
+/*
+ * Distribute the row-major global matrix on root to the local arrays of all
+ * processes of comm, a row-major prows x pcols cartesian communicator.
+ * type is the MPI datatype of one element. Only root reads global.
+ */
+void matrix_dist_scatter(const struct matrix_dist *d, MPI_Datatype type,
+                         const void *global, void *local, int root,
+                         MPI_Comm comm);
+
+/*
+ * Collect the local arrays of all processes of comm into the row-major global
+ * matrix on root. Only root writes global.
+ */
+void matrix_dist_gather(const struct matrix_dist *d, MPI_Datatype type,
+                        const void *local, void *global, int root,
+                        MPI_Comm comm);
+
+/*
+ * Create the committed MPI-IO file view type of this process: the blocks it
+ * owns of the row-major global matrix, in the order they are stored
+ * locally. Free it with MPI_Type_free.
+ */
+void matrix_dist_view(const struct matrix_dist *d, MPI_Datatype type,
+                      MPI_Datatype *view);
+
+/*
+ * Read the local array of this process from the row-major global matrix
+ * stored at byte offset in fh, a file opened on a row-major prows x pcols
+ * cartesian communicator. Collective over that communicator. Returns an MPI
+ * error code.
+ */
+int matrix_dist_read(const struct matrix_dist *d, MPI_Datatype type,
+                     MPI_File fh, MPI_Offset offset, void *local);
+
+/*
+ * Write the local array of this process to its place in the row-major global
+ * matrix stored at byte offset in fh. The counterpart of matrix_dist_read.
+ */
+int matrix_dist_write(const struct matrix_dist *d, MPI_Datatype type,
+                      MPI_File fh, MPI_Offset offset, const void *local);
+
+/*
+ * Reduce a digest and the Frobenius norm of a distributed matrix to root.
+ * The digest sums a hash of every element's value and global position, so
+ * it does not depend on the process grid or the block size; it is exact for
+ * integer types, while floating point results may differ in the last bits
+ * between grids. Collective over comm; only root receives the results.
+ */
+void matrix_dist_checksum(const struct matrix_dist *d,
+                          const struct matrix_type *type, const void *local,
+                          int root, MPI_Comm comm, uint64_t *digest,
+                          double *norm);
+
+/*
+ * Return the largest magnitude of the elements of a distributed matrix on
+ * every process of comm, for the overflow bound of a quantized multiply.
+ * Collective over comm.
+ */
+double matrix_dist_max_abs(const struct matrix_dist *d,
+                           const struct matrix_type *type, const void *local,
+                           MPI_Comm comm);
+
+/*
+ * Return the 64-bit hash that the random element at global row-major index
+ * index of a matrix generated from seed is drawn from.
+ */
+uint64_t matrix_dist_hash(uint64_t seed, uint64_t index);
+
+/*
+ * Fill the local array of this process with random elements, each a
+ * function of seed and its global position only, so the matrix does not
+ * depend on the process grid or the block size. No communication is
+ * needed; use different seeds for different matrices.
+ */
+void matrix_dist_generate(const struct matrix_dist *d,
+                          const struct matrix_type *type, uint64_t seed,
+                          void *local);
+
+#endif /* LIBMATRIX_DIST_H */
@@ -0,0 +1,314 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/file.h"
+
+/*
+ * Fill in a binary header.
+ */
+void matrix_file_header_init(struct matrix_file_header *h, const char *magic,
+                             const struct matrix_type *type, int M, int K,
+                             int N)
+{
+    memset(h, '\0', sizeof(*h));
+    memcpy(h->magic, magic, sizeof(h->magic));
+    strncpy(h->dtype, type->name, sizeof(h->dtype)-1);
+    h->M = M;
+    h->K = K;
+    h->N = N;
+}
+
+/*
+ * Read and validate a binary header.
+ */
+int matrix_file_read_header(FILE *fp, struct matrix_file_header *h)
+{
+    const struct matrix_type *type;
+    long size;
+
+    if (fread(h, sizeof(*h), 1, fp) != 1 ||
+        memcmp(h->magic, MATRIX_FILE_MAGIC, sizeof(h->magic)) != 0) {
+        rewind(fp);
+        return 1;
+    }
+
+    h->dtype[sizeof(h->dtype)-1] = '\0';
+    type = matrix_type_find(h->dtype);
+    if (type == NULL ||
+        h->M < 1 || h->M > INT_MAX ||
+        h->K < 1 || h->K > INT_MAX ||
+        h->N < 1 || h->N > INT_MAX) {
+        return -1;
+    }
+
+    // Both matrices must be present in full
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+        (MPI_Offset)size < matrix_file_offset(h, type->size, 2)) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Return the byte offset of A, B or, for which 2, the end of B.
+ */
+MPI_Offset matrix_file_offset(const struct matrix_file_header *h, size_t size,
+                              int which)
+{
+    MPI_Offset offset = sizeof(*h);
+
+    if (which > 0) {
+        offset += (MPI_Offset)h->M * h->K * size;
+    }
+    if (which > 1) {
+        offset += (MPI_Offset)h->K * h->N * size;
+    }
+    return offset;
+}
+
+/*
+ * Write the header, A and B.
+ */
+int matrix_file_write(FILE *fp, const struct matrix_type *type, int M, int K,
+                      int N, const void *A, const void *B)
+{
+    struct matrix_file_header h;
+    const size_t A_size = (size_t)M * K;
+    const size_t B_size = (size_t)K * N;
+
+    matrix_file_header_init(&h, MATRIX_FILE_MAGIC, type, M, K, N);
+
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+        fwrite(A, type->size, A_size, fp) != A_size ||
+        fwrite(B, type->size, B_size, fp) != B_size) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Format the local array as fixed width text: each element takes the width
+ * of its type plus a separator, a newline after the last global column.
+ */
+static char *format_local(const struct matrix_type *type,
+                          const struct matrix_dist *d, const void *local)
+{
+    const int width = type->width + 1;
+    const char *x = local;
+    char text[64], *buf, *out;
+    int i, j;
+
+    buf = malloc((size_t)d->local_rows * d->local_cols * width + 1);
+    assert(buf != NULL);
+
+    out = buf;
+    for (i = 0; i < d->local_rows; ++i) {
+        for (j = 0; j < d->local_cols; ++j) {
+            const int col = matrix_indxl2g(j, d->nb, d->mycol, d->pcols);
+            type->format(text, sizeof(text), x);
+            out += sprintf(out, "%*s%c", type->width, text,
+                           col == d->cols - 1 ? '\n' : ' ');
+            x += type->size;
+        }
+    }
+    return buf;
+}
+
+/*
+ * Rank 0 writes the header, then every process writes its own blocks
+ * through its darray file view, in text as blocks of fixed width strings.
+ */
+int matrix_file_write_dist(const char *name, int text,
+                           const struct matrix_type *type,
+                           const struct matrix_dist *d, int K,
+                           const void *local, MPI_Comm comm)
+{
+    struct matrix_file_header h;
+    char line[64];
+    const void *header;
+    int header_size, rank, rc, rc_write;
+    char *buf;
+    MPI_Datatype element;
+    MPI_File fh;
+
+    if (text) {
+        header_size = snprintf(line, sizeof(line), "%d %d\n", d->rows, d->cols);
+        header = line;
+    } else {
+        matrix_file_header_init(&h, MATRIX_FILE_MAGIC_C, type, d->rows, K,
+                                d->cols);
+        header_size = sizeof(h);
+        header = &h;
+    }
+
+    rc = MPI_File_open(comm, name, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                       MPI_INFO_NULL, &fh);
+    if (rc != MPI_SUCCESS) {
+        return rc;
+    }
+
+    // Drop the old contents of an existing file
+    rc = MPI_File_set_size(fh, 0);
+    MPI_Comm_rank(comm, &rank);
+    if (rc == MPI_SUCCESS && rank == 0) {
+        rc = MPI_File_write_at(fh, 0, header, header_size, MPI_BYTE,
+                               MPI_STATUS_IGNORE);
+    }
+
+    // Every process takes part in the collective write, even after an error
+    if (text) {
+        buf = format_local(type, d, local);
+        MPI_Type_contiguous(type->width + 1, MPI_CHAR, &element);
+        MPI_Type_commit(&element);
+        rc_write = matrix_dist_write(d, element, fh, header_size, buf);
+        MPI_Type_free(&element);
+        free(buf);
+    } else {
+        rc_write = matrix_dist_write(d, type->mpi, fh, header_size, local);
+    }
+    if (rc == MPI_SUCCESS) {
+        rc = rc_write;
+    }
+
+    MPI_File_close(&fh);
+    return rc;
+}
+
+/*
+ * Read the legacy text format.
+ */
+int matrix_file_read_text(FILE *fp, const struct matrix_type *type, int *M,
+                          int *K, int *N, void **A, void **B)
+{
+    char line[256];
+    size_t i;
+    size_t A_size, B_size;
+
+    *M = *K = *N = 0;
+    if (fgets(line, sizeof(line), fp) != NULL &&
+        sscanf(line, "%d %d %d", M, K, N) == 1) {
+        *K = *N = *M;
+    }
+    if (*M < 1 || *K < 1 || *N < 1) {
+        return -1;
+    }
+    A_size = (size_t)*M * *K;
+    B_size = (size_t)*K * *N;
+
+    *A = calloc(A_size, type->size);
+    if (*A == NULL) {
+        return -1;
+    }
+
+    *B = calloc(B_size, type->size);
+    if (*B == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < A_size; ++i) {
+        if (!type->read(fp, (char *)*A + i * type->size)) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < B_size; ++i) {
+        if (!type->read(fp, (char *)*B + i * type->size)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Read the nonzeros of a rows x cols matrix into coo, with 0-based indices.
+ */
+static int read_coo(FILE *fp, const struct matrix_type *type, int rows,
+                    int cols, struct matrix_coo *coo)
+{
+    int e;
+
+    memset(coo, '\0', sizeof(*coo));
+    coo->rows = rows;
+    coo->cols = cols;
+    if (fscanf(fp, "%d", &coo->nnz) != 1 || coo->nnz < 0 ||
+        (double)coo->nnz > (double)rows * cols) {
+        return -1;
+    }
+    coo->row = malloc(((size_t)coo->nnz + 1) * sizeof(int));
+    coo->col = malloc(((size_t)coo->nnz + 1) * sizeof(int));
+    coo->values = malloc(((size_t)coo->nnz + 1) * type->size);
+    if (coo->row == NULL || coo->col == NULL || coo->values == NULL) {
+        return -1;
+    }
+    for (e = 0; e < coo->nnz; ++e) {
+        if (fscanf(fp, "%d %d", &coo->row[e], &coo->col[e]) != 2 ||
+            !type->read(fp, (char *)coo->values + (size_t)e * type->size)) {
+            return -1;
+        }
+        if (--coo->row[e] < 0 || coo->row[e] >= rows ||
+            --coo->col[e] < 0 || coo->col[e] >= cols) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Read the sparse text format.
+ */
+int matrix_file_read_sparse(FILE *fp, const struct matrix_type *type, int *M,
+                            int *K, int *N, struct matrix_coo *A,
+                            struct matrix_coo *B)
+{
+    char line[256];
+
+    rewind(fp);
+    if (fgets(line, sizeof(line), fp) == NULL ||
+        strncmp(line, "sparse", 6) != 0) {
+        rewind(fp);
+        return 1;
+    }
+    if (sscanf(line + 6, "%d %d %d", M, K, N) != 3 ||
+        *M < 1 || *K < 1 || *N < 1) {
+        return -1;
+    }
+    if (A == NULL || B == NULL) {
+        return 0;
+    }
+    if (read_coo(fp, type, *M, *K, A) != 0 ||
+        read_coo(fp, type, *K, *N, B) != 0) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_FILE_H
+#define LIBMATRIX_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "libmatrix/dist.h"
+#include "libmatrix/sparse.h"
+#include "libmatrix/types.h"
+
+/*
+ * Binary matrix files start with this header, in native byte order, followed
+ * by the row-major M x K matrix A and the row-major K x N matrix B. dtype is
+ * the NUL padded name of the element type.
+ */
+#define MATRIX_FILE_MAGIC "MATRIXB1"
+
+/*
+ * A binary result file has the same header with this magic, followed by the
+ * row-major M x N matrix C. K is the inner dimension of the multiply.
+ */
+#define MATRIX_FILE_MAGIC_C "MATRIXC1"
+
+struct matrix_file_header {
+    char magic[8];
+    char dtype[8];
+    int64_t M;
+    int64_t K;
+    int64_t N;
+};
+
+/*
+ * Fill in a binary header with magic MATRIX_FILE_MAGIC or
+ * MATRIX_FILE_MAGIC_C.
+ */
+void matrix_file_header_init(struct matrix_file_header *h, const char *magic,
+                             const struct matrix_type *type, int M, int K,
+                             int N);
+
+/*
+ * Read the header of a binary matrix file and check it against the size of
+ * the file. Returns 0 for a valid binary file, 1 if fp does not start with a
+ * binary header, in which case fp is rewound, and -1 for a damaged file.
+ */
+int matrix_file_read_header(FILE *fp, struct matrix_file_header *h);
+
+/*
+ * Return the byte offset of A (which 0) or B (which 1) in a binary file.
+ */
+MPI_Offset matrix_file_offset(const struct matrix_file_header *h, size_t size,
+                              int which);
+
+/*
+ * Write A and B to fp as a binary matrix file.
+ */
+int matrix_file_write(FILE *fp, const struct matrix_type *type, int M, int K,
+                      int N, const void *A, const void *B);
+
+/*
+ * Write the distributed M x N matrix C, the product of an inner dimension
+ * of K, to the file name, collectively over comm, the communicator of the
+ * distribution. A binary file has a MATRIX_FILE_MAGIC_C header. A text
+ * file starts with a line of M and N followed by the rows of C, every
+ * element right-aligned in the width of its type, so that each process can
+ * format and write its own blocks. Returns an MPI error code.
+ */
+int matrix_file_write_dist(const char *name, int text,
+                           const struct matrix_type *type,
+                           const struct matrix_dist *d, int K,
+                           const void *local, MPI_Comm comm);
+
+/*
+ * Read a text matrix file: either N followed by two N x N matrices, or
+ * M K N on the first line followed by an M x K and a K x N matrix. A and B
+ * are allocated. Returns 0 on success and -1 on a malformed file.
+ */
+int matrix_file_read_text(FILE *fp, const struct matrix_type *type, int *M,
+                          int *K, int *N, void **A, void **B);
+
+/*
+ * Read a sparse text matrix file: "sparse M K N" on the first line, then
+ * the number of nonzeros of A followed by one "i j value" line for each,
+ * and likewise for B. Indices start at 1, as in Matrix Market files. The
+ * COO lists of A and B are allocated, unless A and B are NULL, in which
+ * case only the first line is read. Returns 0 on success, 1 if fp is not a
+ * sparse file, in which case fp is rewound, and -1 on a malformed file.
+ */
+int matrix_file_read_sparse(FILE *fp, const struct matrix_type *type, int *M,
+                            int *K, int *N, struct matrix_coo *A,
+                            struct matrix_coo *B);
+
+#endif /* LIBMATRIX_FILE_H */
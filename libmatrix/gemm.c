@@ -0,0 +1,317 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <complex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/arena.h"
+#include "libmatrix/gemm.h"
+#include "libmatrix/kernels.h"
+#include "libmatrix/threads.h"
+#include "libmatrix/trace.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define ROUND_UP(a, b) ((((a) + (b) - 1) / (b)) * (b))
+
+#ifdef _OPENMP
+#define OMP(directive) _Pragma(#directive)
+#else
+#define OMP(directive)
+#endif
+
+enum isa {
+    ISA_NONE,
+    ISA_SSE41,
+    ISA_AVX2,
+    ISA_AVX512
+};
+
+/*
+ * Instruction sets with micro-kernels, widest first.
+ */
+static const struct {
+    enum isa isa;
+    const char *name;
+} isas[] = {
+#ifdef HAVE_KERNEL_AVX512
+    { ISA_AVX512, "avx512" },
+#endif
+#ifdef HAVE_KERNEL_AVX2
+    { ISA_AVX2, "avx2" },
+#endif
+#ifdef HAVE_KERNEL_SSE41
+    { ISA_SSE41, "sse4.1" },
+#endif
+    { ISA_NONE, "scalar" }
+};
+
+static int selected_isa = -1;
+static int strassen_cutoff = 0;
+
+/*
+ * Workspace of every multiply: packing buffers and the temporaries of the
+ * Strassen-Winograd recursion.
+ */
+static struct matrix_arena workspace;
+
+/*
+ * Query CPUID for an instruction set. __builtin_cpu_supports also checks
+ * that the operating system saves the wider register state.
+ */
+static int isa_supported(enum isa isa)
+{
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+    __builtin_cpu_init();
+    switch (isa) {
+        case ISA_SSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case ISA_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case ISA_AVX512:
+            return __builtin_cpu_supports("avx512f");
+        default:
+            return 1;
+    }
+#else
+    return isa == ISA_NONE;
+#endif
+}
+
+/*
+ * Select the micro-kernels by instruction set name, or the widest supported
+ * one for "auto".
+ */
+int matrix_gemm_set_kernel(const char *name)
+{
+    size_t i;
+    const int automatic = (name == NULL || strcmp(name, "auto") == 0);
+
+    for (i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+        if (!automatic && strcmp(name, isas[i].name) != 0) {
+            continue;
+        }
+        if (!isa_supported(isas[i].isa)) {
+            if (automatic) {
+                continue;
+            }
+            return -1;
+        }
+        selected_isa = (int)i;
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Return the selected instruction set, selecting automatically on first use.
+ */
+const char *matrix_gemm_kernel(void)
+{
+    if (selected_isa < 0) {
+        matrix_gemm_set_kernel("auto");
+    }
+    return isas[selected_isa].name;
+}
+
+void matrix_gemm_set_strassen(int cutoff)
+{
+    strassen_cutoff = cutoff > 0 ? cutoff : 0;
+}
+
+int matrix_gemm_strassen(void)
+{
+    return strassen_cutoff;
+}
+
+#define GEMM_TYPE int
+#define GEMM_ID int
+#include "libmatrix/gemm_template.h"
+
+#define GEMM_TYPE int64_t
+#define GEMM_ID int64
+#include "libmatrix/gemm_template.h"
+
+#define GEMM_TYPE float
+#define GEMM_ID float
+#include "libmatrix/gemm_template.h"
+
+#define GEMM_TYPE double
+#define GEMM_ID double
+#include "libmatrix/gemm_template.h"
+
+#define GEMM_TYPE double complex
+#define GEMM_ID cdouble
+#include "libmatrix/gemm_template.h"
+
+typedef void (*qmicro_fn)(int kc2, const int16_t *a, const int16_t *b,
+                          int *c, int ldc);
+
+/*
+ * Quantized micro-kernels, widest instruction set first, shared by the
+ * quantized types since both pack to int16. The 16-bit multiplies of
+ * AVX-512 need AVX-512BW on top of the AVX-512F of the other kernels, so
+ * that kernel comes with the portable one as a fallback.
+ */
+static const struct {
+    enum isa isa;
+    int bw;
+    int mr;
+    int nr;
+    qmicro_fn micro;
+} qkernels[] = {
+#ifdef HAVE_KERNEL_AVX512BW
+    { ISA_AVX512, 1, GEMM_AVX512_MR, GEMM_AVX512_NR(int), gemm_qmicro_avx512bw },
+#endif
+#ifdef HAVE_KERNEL_AVX512
+    { ISA_AVX512, 0, GEMM_AVX512_MR, GEMM_AVX512_NR(int), gemm_qmicro_avx512 },
+#endif
+#ifdef HAVE_KERNEL_AVX2
+    { ISA_AVX2, 0, GEMM_AVX2_MR, GEMM_AVX2_NR(int), gemm_qmicro_avx2 },
+#endif
+#ifdef HAVE_KERNEL_SSE41
+    { ISA_SSE41, 0, GEMM_SSE41_MR, GEMM_SSE41_NR(int), gemm_qmicro_sse41 },
+#endif
+    { ISA_NONE, 0, GEMM_SCALAR_MR, GEMM_SCALAR_NR(int), gemm_qmicro_scalar }
+};
+
+/*
+ * Query CPUID for AVX-512BW.
+ */
+static int avx512bw_supported(void)
+{
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512bw");
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Return the index of the quantized micro-kernel of an instruction set.
+ */
+static size_t qkernel_index(enum isa isa)
+{
+    size_t n = 0;
+
+    while ((qkernels[n].isa != isa || (qkernels[n].bw && !avx512bw_supported()))
+           && qkernels[n].isa != ISA_NONE) {
+        ++n;
+    }
+    return n;
+}
+
+/*
+ * Multiply a packed mc x kc block of A with one packed kc x nr sliver of B
+ * into the int matrix C, both packed in kc2 steps of pairs, one register
+ * tile at a time. Ragged edge tiles go through a scratch tile.
+ */
+static void qmacro_kernel(int k_mr, int k_nr, qmicro_fn micro, int mc, int nr,
+                          int kc2, const int16_t *a, const int16_t *b, int *C,
+                          int ldc)
+{
+    int tile[GEMM_MR_MAX * GEMM_NR_MAX];
+    int ir, i, j;
+
+    for (ir = 0; ir < mc; ir += k_mr) {
+        const int mr = MIN(k_mr, mc - ir);
+        const int16_t *a_sliver = &a[(size_t)ir * 2 * kc2];
+        int *c = &C[(size_t)ir * ldc];
+        if (mr == k_mr && nr == k_nr) {
+            micro(kc2, a_sliver, b, c, ldc);
+            continue;
+        }
+        memset(tile, 0, sizeof(tile));
+        micro(kc2, a_sliver, b, tile, k_nr);
+        for (i = 0; i < mr; ++i) {
+            for (j = 0; j < nr; ++j) {
+                c[(size_t)i * ldc + j] += tile[i * k_nr + j];
+            }
+        }
+    }
+}
+
+#define GEMM_TYPE int8_t
+#define GEMM_ID int8
+#include "libmatrix/qgemm_template.h"
+
+#define GEMM_TYPE int16_t
+#define GEMM_ID int16
+#include "libmatrix/qgemm_template.h"
+
+/*
+ * Multiply A (M x K) by B (K x N) and accumulate in C (M x N), dispatching
+ * to the packed or the Strassen-Winograd multiply specialized for the
+ * element type, or for a quantized type to the quantized multiply, once the
+ * workspace is large enough.
+ */
+void matrix_gemm(const struct matrix_type *type, int M, int N, int K,
+                 const void *A, int lda, const void *B, int ldb,
+                 void *C, int ldc)
+{
+    enum isa isa;
+    int rc;
+
+    if (M <= 0 || N <= 0 || K <= 0) {
+        return;
+    }
+    matrix_gemm_kernel();
+    isa = isas[selected_isa].isa;
+    matrix_trace_begin("matrix_gemm");
+
+#define GEMM_DISPATCH(id, ctype, mpi)                                   \
+    case MATRIX_##id:                                                   \
+        rc = matrix_arena_reserve(&workspace, workspace_##id(           \
+            isa, strassen_cutoff, M, N, K));                            \
+        assert(rc == 0);                                                \
+        strassen_##id(isa, strassen_cutoff, &workspace, M, N, K,        \
+                      A, lda, B, ldb, C, ldc);                          \
+        break;
+
+#define QGEMM_DISPATCH(id, ctype, mpi)                                  \
+    case MATRIX_##id:                                                   \
+        rc = matrix_arena_reserve(&workspace, qpack_bytes_##id(         \
+            isa, M, N, K));                                             \
+        assert(rc == 0);                                                \
+        qgemm_##id(isa, &workspace, M, N, K, A, lda, B, ldb, C, ldc);   \
+        break;
+
+    switch (type->id) {
+        MATRIX_TYPES(GEMM_DISPATCH)
+        MATRIX_QTYPES(QGEMM_DISPATCH)
+        default:
+            assert(0);
+    }
+#undef GEMM_DISPATCH
+#undef QGEMM_DISPATCH
+    matrix_trace_end();
+}
@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_GEMM_H
+#define LIBMATRIX_GEMM_H
+
+#include "libmatrix/types.h"
+
+/*
+ * Cache blocking parameters for the local multiply. A packed MC x KC block
+ * of A is sized for L2, a packed KC x NC panel of B for L3 and a KC x NR
+ * sliver of that panel for L1. The micro-kernel keeps an MR x NR tile of C
+ * in registers while it streams through KC; MR and NR depend on the selected
+ * micro-kernel and never exceed GEMM_MR_MAX and GEMM_NR_MAX.
+ */
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4096
+#define GEMM_MR_MAX 8
+#define GEMM_NR_MAX 32
+
+/*
+ * Select the micro-kernels used by matrix_gemm by instruction set name:
+ * avx512, avx2, sse4.1 or scalar. "auto" picks the widest instruction set the
+ * running CPU supports. Returns 0 on success and -1 if the name is unknown or
+ * the CPU lacks the instruction set.
+ */
+int matrix_gemm_set_kernel(const char *name);
+
+/*
+ * Return the name of the selected instruction set, choosing one
+ * automatically if none was selected yet.
+ */
+const char *matrix_gemm_kernel(void);
+
+/*
+ * Default cutoff of the Strassen-Winograd multiply: multiplies whose
+ * dimensions all exceed it are split, smaller ones run the blocked multiply.
+ */
+#define GEMM_STRASSEN_CUTOFF 512
+
+/*
+ * Select the local multiply: Strassen-Winograd down to cutoff, or the
+ * blocked multiply alone for a cutoff of 0 (the default).
+ */
+void matrix_gemm_set_strassen(int cutoff);
+
+/*
+ * Return the Strassen-Winograd cutoff, or 0 for the blocked multiply.
+ */
+int matrix_gemm_strassen(void);
+
+/*
+ * Multiply the row-major M x K matrix A by the row-major K x N matrix B and
+ * accumulate the result in the row-major M x N matrix C, all with elements
+ * of the given type, except that C holds type->acc elements for the
+ * quantized types: their products accumulate in int, and the
+ * Strassen-Winograd cutoff does not apply. lda, ldb and ldc are the row
+ * strides of A, B and C in elements. Scratch space comes from a workspace
+ * arena that grows to the largest multiply so far and is kept for the next
+ * one, so matrix_gemm is not reentrant.
+ */
+void matrix_gemm(const struct matrix_type *type, int M, int N, int K,
+                 const void *A, int lda, const void *B, int ldb,
+                 void *C, int ldc);
+
+#endif /* LIBMATRIX_GEMM_H */
@@ -0,0 +1,387 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Type-specialized packing and blocking for matrix_gemm. gemm.c includes this
+ * file once per element type, with GEMM_TYPE set to the C type and GEMM_ID to
+ * its name in MATRIX_TYPES; every function defined here is suffixed with the
+ * name.
+ */
+#define GEMM_CAT_(a, b) a##_##b
+#define GEMM_CAT(a, b) GEMM_CAT_(a, b)
+#define GEMM_FN(name) GEMM_CAT(name, GEMM_ID)
+
+typedef void (*GEMM_FN(micro_fn))(int kc, const GEMM_TYPE *a,
+                                  const GEMM_TYPE *b, GEMM_TYPE *c, int ldc);
+
+/*
+ * Micro-kernels for this element type, widest instruction set first.
+ */
+static const struct {
+    enum isa isa;
+    int mr;
+    int nr;
+    GEMM_FN(micro_fn) micro;
+} GEMM_FN(kernels)[] = {
+#ifdef HAVE_KERNEL_AVX512
+    { ISA_AVX512, GEMM_AVX512_MR, GEMM_AVX512_NR(GEMM_TYPE),
+      GEMM_FN(gemm_micro_avx512) },
+#endif
+#ifdef HAVE_KERNEL_AVX2
+    { ISA_AVX2, GEMM_AVX2_MR, GEMM_AVX2_NR(GEMM_TYPE),
+      GEMM_FN(gemm_micro_avx2) },
+#endif
+#ifdef HAVE_KERNEL_SSE41
+    { ISA_SSE41, GEMM_SSE41_MR, GEMM_SSE41_NR(GEMM_TYPE),
+      GEMM_FN(gemm_micro_sse41) },
+#endif
+    { ISA_NONE, GEMM_SCALAR_MR, GEMM_SCALAR_NR(GEMM_TYPE),
+      GEMM_FN(gemm_micro_scalar) }
+};
+
+/*
+ * Pack an mr x kc sliver of A, storing its kc columns contiguously with
+ * mr_max values per column, zero padded at the bottom edge.
+ */
+static void GEMM_FN(pack_a)(int mr, int kc, const GEMM_TYPE *A, int lda,
+                            int mr_max, GEMM_TYPE *a)
+{
+    int p, r;
+    for (p = 0; p < kc; ++p) {
+        for (r = 0; r < mr; ++r) {
+            *a++ = A[(size_t)r * lda + p];
+        }
+        for (; r < mr_max; ++r) {
+            *a++ = 0;
+        }
+    }
+}
+
+/*
+ * Pack a kc x nr sliver of B, storing its kc rows contiguously with nr_max
+ * values per row, zero padded at the right edge.
+ */
+static void GEMM_FN(pack_b)(int kc, int nr, const GEMM_TYPE *B, int ldb,
+                            int nr_max, GEMM_TYPE *b)
+{
+    int p, c;
+    for (p = 0; p < kc; ++p) {
+        const GEMM_TYPE *row = &B[(size_t)p * ldb];
+        for (c = 0; c < nr; ++c) {
+            *b++ = row[c];
+        }
+        for (; c < nr_max; ++c) {
+            *b++ = 0;
+        }
+    }
+}
+
+/*
+ * Multiply a packed mc x kc block of A with one packed kc x nr sliver of B
+ * into C, one register tile at a time. Ragged edge tiles go through a scratch
+ * tile so the micro-kernel only ever sees full tiles.
+ */
+static void GEMM_FN(macro_kernel)(int k_mr, int k_nr, GEMM_FN(micro_fn) micro,
+                                  int mc, int nr, int kc, const GEMM_TYPE *a,
+                                  const GEMM_TYPE *b, GEMM_TYPE *C, int ldc)
+{
+    GEMM_TYPE tile[GEMM_MR_MAX * GEMM_NR_MAX];
+    int ir, i, j;
+
+    for (ir = 0; ir < mc; ir += k_mr) {
+        const int mr = MIN(k_mr, mc - ir);
+        const GEMM_TYPE *a_sliver = &a[(size_t)ir * kc];
+        GEMM_TYPE *c = &C[(size_t)ir * ldc];
+        if (mr == k_mr && nr == k_nr) {
+            micro(kc, a_sliver, b, c, ldc);
+            continue;
+        }
+        memset(tile, 0, sizeof(tile));
+        micro(kc, a_sliver, b, tile, k_nr);
+        for (i = 0; i < mr; ++i) {
+            for (j = 0; j < nr; ++j) {
+                c[(size_t)i * ldc + j] += tile[i * k_nr + j];
+            }
+        }
+    }
+}
+
+/*
+ * Return the index of the micro-kernel of an instruction set.
+ */
+static size_t GEMM_FN(kernel_index)(enum isa isa)
+{
+    size_t n = 0;
+
+    while (GEMM_FN(kernels)[n].isa != isa && GEMM_FN(kernels)[n].isa != ISA_NONE) {
+        ++n;
+    }
+    return n;
+}
+
+/*
+ * Return the arena bytes of the packed block of A and panel of B of an
+ * M x K by K x N multiply, which bound those of any smaller multiply.
+ */
+static size_t GEMM_FN(pack_bytes)(enum isa isa, int M, int N, int K)
+{
+    const size_t n = GEMM_FN(kernel_index)(isa);
+    const int mr = GEMM_FN(kernels)[n].mr;
+    const int nr = GEMM_FN(kernels)[n].nr;
+
+    return matrix_arena_bytes(sizeof(GEMM_TYPE) * ROUND_UP(MIN(M, GEMM_MC), mr)
+                              * MIN(K, GEMM_KC))
+         + matrix_arena_bytes(sizeof(GEMM_TYPE) * ROUND_UP(MIN(N, GEMM_NC), nr)
+                              * MIN(K, GEMM_KC));
+}
+
+/*
+ * Multiply A (M x K) by B (K x N) and accumulate in C (M x N) using packed,
+ * cache-blocked panels: B is packed once per KC x NC panel and reused by
+ * every MC x KC block of A. With more than one thread, the threads share the
+ * packing and split each block of C by NR-column slivers. The packing
+ * buffers come from the workspace arena.
+ */
+static void GEMM_FN(gemm)(enum isa isa, struct matrix_arena *arena,
+                          int M, int N, int K,
+                          const GEMM_TYPE *A, int lda,
+                          const GEMM_TYPE *B, int ldb, GEMM_TYPE *C, int ldc)
+{
+    const int threads = matrix_threads();
+    const size_t n = GEMM_FN(kernel_index)(isa);
+    const size_t mark = matrix_arena_mark(arena);
+    const int mr = GEMM_FN(kernels)[n].mr;
+    const int nr = GEMM_FN(kernels)[n].nr;
+    GEMM_FN(micro_fn) micro = GEMM_FN(kernels)[n].micro;
+    GEMM_TYPE *a_pack, *b_pack;
+
+    a_pack = matrix_arena_alloc(arena, sizeof(*a_pack)
+                                * ROUND_UP(MIN(M, GEMM_MC), mr) * MIN(K, GEMM_KC));
+    assert(a_pack != NULL);
+    b_pack = matrix_arena_alloc(arena, sizeof(*b_pack)
+                                * ROUND_UP(MIN(N, GEMM_NC), nr) * MIN(K, GEMM_KC));
+    assert(b_pack != NULL);
+
+    OMP(omp parallel num_threads(threads) if(threads > 1))
+    {
+        int jc, pc, ic, s;
+        for (jc = 0; jc < N; jc += GEMM_NC) {
+            const int nc = MIN(GEMM_NC, N - jc);
+            const int nb = (nc + nr - 1) / nr;
+            for (pc = 0; pc < K; pc += GEMM_KC) {
+                const int kc = MIN(GEMM_KC, K - pc);
+
+                OMP(omp for schedule(static))
+                for (s = 0; s < nb; ++s) {
+                    const int j = s * nr;
+                    GEMM_FN(pack_b)(kc, MIN(nr, nc - j),
+                                    &B[(size_t)pc * ldb + jc + j], ldb, nr,
+                                    &b_pack[(size_t)j * kc]);
+                }
+
+                for (ic = 0; ic < M; ic += GEMM_MC) {
+                    const int mc = MIN(GEMM_MC, M - ic);
+                    const int na = (mc + mr - 1) / mr;
+
+                    OMP(omp for schedule(static))
+                    for (s = 0; s < na; ++s) {
+                        const int i = s * mr;
+                        GEMM_FN(pack_a)(MIN(mr, mc - i), kc,
+                                        &A[(size_t)(ic + i) * lda + pc], lda,
+                                        mr, &a_pack[(size_t)i * kc]);
+                    }
+
+                    OMP(omp for schedule(static))
+                    for (s = 0; s < nb; ++s) {
+                        const int j = s * nr;
+                        GEMM_FN(macro_kernel)(mr, nr, micro, mc,
+                                              MIN(nr, nc - j), kc, a_pack,
+                                              &b_pack[(size_t)j * kc],
+                                              &C[(size_t)ic * ldc + jc + j],
+                                              ldc);
+                    }
+                }
+            }
+        }
+    }
+
+    matrix_arena_release(arena, mark);
+}
+
+/*
+ * Z = X + Y, or Z = X - Y with sign < 0, for m x n matrices with row strides
+ * ldx, ldy and ldz. Z may be X or Y.
+ */
+static void GEMM_FN(add)(int m, int n, int sign, const GEMM_TYPE *X, int ldx,
+                         const GEMM_TYPE *Y, int ldy, GEMM_TYPE *Z, int ldz)
+{
+    const int threads = matrix_threads();
+    int i, j;
+
+    OMP(omp parallel for private(j) num_threads(threads) if(threads > 1))
+    for (i = 0; i < m; ++i) {
+        const GEMM_TYPE *x = &X[(size_t)i * ldx];
+        const GEMM_TYPE *y = &Y[(size_t)i * ldy];
+        GEMM_TYPE *z = &Z[(size_t)i * ldz];
+        if (sign < 0) {
+            for (j = 0; j < n; ++j) {
+                z[j] = x[j] - y[j];
+            }
+        } else {
+            for (j = 0; j < n; ++j) {
+                z[j] = x[j] + y[j];
+            }
+        }
+    }
+}
+
+/*
+ * Return the arena bytes of a Strassen-Winograd multiply of A (M x K) by
+ * B (K x N): the four half size temporaries of every level of the recursion
+ * and the packing buffers of the blocked multiply.
+ */
+static size_t GEMM_FN(workspace)(enum isa isa, int cutoff, int M, int N, int K)
+{
+    size_t bytes = GEMM_FN(pack_bytes)(isa, M, N, K);
+    size_t m, n, k;
+
+    while (cutoff > 0 && M > cutoff && N > cutoff && K > cutoff) {
+        M /= 2;
+        N /= 2;
+        K /= 2;
+        m = M;
+        n = N;
+        k = K;
+        bytes += matrix_arena_bytes(sizeof(GEMM_TYPE) * m * k)
+               + matrix_arena_bytes(sizeof(GEMM_TYPE) * k * n)
+               + 2 * matrix_arena_bytes(sizeof(GEMM_TYPE) * m * n);
+    }
+    return bytes;
+}
+
+/*
+ * Multiply A (M x K) by B (K x N) and accumulate in C (M x N) with the
+ * Strassen-Winograd algorithm: 7 half size products and 15 additions per
+ * level instead of 8 products. The recursion splits while every dimension
+ * exceeds cutoff and then falls back to the blocked multiply; an odd last
+ * row or column is peeled off and multiplied by the blocked multiply too.
+ * Its four temporaries per level come from the workspace arena. Integer
+ * products are exact, with the same wrap-around as the blocked multiply.
+ */
+static void GEMM_FN(strassen)(enum isa isa, int cutoff,
+                              struct matrix_arena *arena, int M, int N, int K,
+                              const GEMM_TYPE *A, int lda,
+                              const GEMM_TYPE *B, int ldb,
+                              GEMM_TYPE *C, int ldc)
+{
+    const int m = M / 2, n = N / 2, k = K / 2;
+    const size_t mark = matrix_arena_mark(arena);
+    GEMM_TYPE *X, *Y, *W1, *W2;
+
+    if (cutoff <= 0 || M <= cutoff || N <= cutoff || K <= cutoff) {
+        GEMM_FN(gemm)(isa, arena, M, N, K, A, lda, B, ldb, C, ldc);
+        return;
+    }
+
+    const GEMM_TYPE *A11 = A, *A12 = A + k;
+    const GEMM_TYPE *A21 = A + (size_t)m * lda, *A22 = A21 + k;
+    const GEMM_TYPE *B11 = B, *B12 = B + n;
+    const GEMM_TYPE *B21 = B + (size_t)k * ldb, *B22 = B21 + n;
+    GEMM_TYPE *C11 = C, *C12 = C + n;
+    GEMM_TYPE *C21 = C + (size_t)m * ldc, *C22 = C21 + n;
+
+    X = matrix_arena_alloc(arena, sizeof(*X) * (size_t)m * k);
+    Y = matrix_arena_alloc(arena, sizeof(*Y) * (size_t)k * n);
+    W1 = matrix_arena_alloc(arena, sizeof(*W1) * (size_t)m * n);
+    W2 = matrix_arena_alloc(arena, sizeof(*W2) * (size_t)m * n);
+    assert(X != NULL && Y != NULL && W1 != NULL && W2 != NULL);
+
+    // C11 += P1 + P2, with W1 = P1 = A11 B11
+    memset(W1, 0, sizeof(*W1) * (size_t)m * n);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, A11, lda, B11, ldb, W1, n);
+    GEMM_FN(add)(m, n, 1, C11, ldc, W1, n, C11, ldc);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, A12, lda, B21, ldb, C11, ldc);
+
+    // W1 = U2 = P1 + P6 with S2 = A21 + A22 - A11 and T2 = B22 - B12 + B11
+    GEMM_FN(add)(m, k, 1, A21, lda, A22, lda, X, k);
+    GEMM_FN(add)(m, k, -1, X, k, A11, lda, X, k);
+    GEMM_FN(add)(k, n, -1, B22, ldb, B12, ldb, Y, n);
+    GEMM_FN(add)(k, n, 1, Y, n, B11, ldb, Y, n);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, X, k, Y, n, W1, n);
+
+    // C21 and C22 += U3 = U2 + P7, with S3 = A11 - A21 and T3 = B22 - B12
+    GEMM_FN(add)(m, k, -1, A11, lda, A21, lda, X, k);
+    GEMM_FN(add)(k, n, -1, B22, ldb, B12, ldb, Y, n);
+    memcpy(W2, W1, sizeof(*W2) * (size_t)m * n);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, X, k, Y, n, W2, n);
+    GEMM_FN(add)(m, n, 1, C21, ldc, W2, n, C21, ldc);
+    GEMM_FN(add)(m, n, 1, C22, ldc, W2, n, C22, ldc);
+
+    // C22 += P5 and C12 += U4 = U2 + P5, with S1 = A21 + A22 and
+    // T1 = B12 - B11
+    GEMM_FN(add)(m, k, 1, A21, lda, A22, lda, X, k);
+    GEMM_FN(add)(k, n, -1, B12, ldb, B11, ldb, Y, n);
+    memset(W2, 0, sizeof(*W2) * (size_t)m * n);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, X, k, Y, n, W2, n);
+    GEMM_FN(add)(m, n, 1, C22, ldc, W2, n, C22, ldc);
+    GEMM_FN(add)(m, n, 1, W1, n, W2, n, W1, n);
+    GEMM_FN(add)(m, n, 1, C12, ldc, W1, n, C12, ldc);
+
+    // C12 += P3 = S4 B22, with S4 = A12 - S2 = A12 + A11 - A21 - A22
+    GEMM_FN(add)(m, k, 1, A12, lda, A11, lda, X, k);
+    GEMM_FN(add)(m, k, -1, X, k, A21, lda, X, k);
+    GEMM_FN(add)(m, k, -1, X, k, A22, lda, X, k);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, X, k, B22, ldb, C12, ldc);
+
+    // C21 -= P4 = A22 T4, adding A22 (-T4) with -T4 = B21 - T2
+    //                                             = B21 - B22 + B12 - B11
+    GEMM_FN(add)(k, n, -1, B21, ldb, B22, ldb, Y, n);
+    GEMM_FN(add)(k, n, 1, Y, n, B12, ldb, Y, n);
+    GEMM_FN(add)(k, n, -1, Y, n, B11, ldb, Y, n);
+    GEMM_FN(strassen)(isa, cutoff, arena, m, n, k, A22, lda, Y, n, C21, ldc);
+
+    matrix_arena_release(arena, mark);
+
+    // Peel off the odd last column of A and row of B, the odd last column of
+    // C and the odd last row of C
+    if (K > 2 * k) {
+        GEMM_FN(gemm)(isa, arena, 2 * m, 2 * n, 1, A + 2 * k, lda,
+                      B + (size_t)2 * k * ldb, ldb, C, ldc);
+    }
+    if (N > 2 * n) {
+        GEMM_FN(gemm)(isa, arena, 2 * m, 1, K, A, lda, B + 2 * n, ldb,
+                      C + 2 * n, ldc);
+    }
+    if (M > 2 * m) {
+        GEMM_FN(gemm)(isa, arena, 1, N, K, A + (size_t)2 * m * lda, lda, B, ldb,
+                      C + (size_t)2 * m * ldc, ldc);
+    }
+}
+
+#undef GEMM_FN
+#undef GEMM_CAT
+#undef GEMM_CAT_
+#undef GEMM_TYPE
+#undef GEMM_ID
@@ -0,0 +1,114 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+#include "libmatrix/kernels.h"
+
+/*
+ * AVX2 micro-kernel: a 6 x 16 tile of C is kept in twelve ymm accumulators,
+ * two per row, leaving registers for the B row and the broadcast A value.
+ */
+void gemm_micro_avx2_int(int kc, const int *a, const int *b, int *c, int ldc)
+{
+    __m256i acc[GEMM_AVX2_MR][2];
+    __m256i b0, b1, ai;
+    int i, p;
+
+    for (i = 0; i < GEMM_AVX2_MR; ++i) {
+        acc[i][0] = _mm256_setzero_si256();
+        acc[i][1] = _mm256_setzero_si256();
+    }
+
+    for (p = 0; p < kc; ++p) {
+        b0 = _mm256_loadu_si256((const __m256i *)&b[0]);
+        b1 = _mm256_loadu_si256((const __m256i *)&b[8]);
+        for (i = 0; i < GEMM_AVX2_MR; ++i) {
+            ai = _mm256_set1_epi32(a[i]);
+            acc[i][0] = _mm256_add_epi32(acc[i][0], _mm256_mullo_epi32(ai, b0));
+            acc[i][1] = _mm256_add_epi32(acc[i][1], _mm256_mullo_epi32(ai, b1));
+        }
+        a += GEMM_AVX2_MR;
+        b += GEMM_AVX2_NR(int);
+    }
+
+    for (i = 0; i < GEMM_AVX2_MR; ++i) {
+        __m256i *r = (__m256i *)&c[(size_t)i * ldc];
+        _mm256_storeu_si256(r, _mm256_add_epi32(_mm256_loadu_si256(r), acc[i][0]));
+        _mm256_storeu_si256(r + 1, _mm256_add_epi32(_mm256_loadu_si256(r + 1), acc[i][1]));
+    }
+}
+
+/*
+ * The other element types use the portable kernel with a tile two AVX2
+ * registers wide, vectorized by the compiler.
+ */
+GEMM_MICRO_DEFINE(avx2, GEMM_AVX2_MR, GEMM_AVX2_NR, int64, int64_t)
+GEMM_MICRO_DEFINE(avx2, GEMM_AVX2_MR, GEMM_AVX2_NR, float, float)
+GEMM_MICRO_DEFINE(avx2, GEMM_AVX2_MR, GEMM_AVX2_NR, double, double)
+GEMM_MICRO_DEFINE(avx2, GEMM_AVX2_MR, GEMM_AVX2_NR, cdouble, double complex)
+
+/*
+ * AVX2 quantized micro-kernel: the same 6 x 16 tile of int C in twelve ymm
+ * accumulators. Each step loads the k pairs of 16 columns of B, broadcasts
+ * one pair of A per row as a 32-bit lane, and vpmaddwd multiplies the int16
+ * values and adds each pair into an int lane.
+ */
+void gemm_qmicro_avx2(int kc2, const int16_t *a, const int16_t *b, int *c,
+                      int ldc)
+{
+    __m256i acc[GEMM_AVX2_MR][2];
+    __m256i b0, b1, ai;
+    int32_t pair;
+    int i, p;
+
+    for (i = 0; i < GEMM_AVX2_MR; ++i) {
+        acc[i][0] = _mm256_setzero_si256();
+        acc[i][1] = _mm256_setzero_si256();
+    }
+
+    for (p = 0; p < kc2; ++p) {
+        b0 = _mm256_loadu_si256((const __m256i *)&b[0]);
+        b1 = _mm256_loadu_si256((const __m256i *)&b[16]);
+        for (i = 0; i < GEMM_AVX2_MR; ++i) {
+            memcpy(&pair, &a[2 * i], sizeof(pair));
+            ai = _mm256_set1_epi32(pair);
+            acc[i][0] = _mm256_add_epi32(acc[i][0], _mm256_madd_epi16(ai, b0));
+            acc[i][1] = _mm256_add_epi32(acc[i][1], _mm256_madd_epi16(ai, b1));
+        }
+        a += 2 * GEMM_AVX2_MR;
+        b += 2 * GEMM_AVX2_NR(int);
+    }
+
+    for (i = 0; i < GEMM_AVX2_MR; ++i) {
+        __m256i *r = (__m256i *)&c[(size_t)i * ldc];
+        _mm256_storeu_si256(r, _mm256_add_epi32(_mm256_loadu_si256(r), acc[i][0]));
+        _mm256_storeu_si256(r + 1, _mm256_add_epi32(_mm256_loadu_si256(r + 1), acc[i][1]));
+    }
+}
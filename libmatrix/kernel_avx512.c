@@ -0,0 +1,82 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+#include "libmatrix/kernels.h"
+
+/*
+ * AVX-512 micro-kernel: an 8 x 32 tile of C is kept in sixteen zmm
+ * accumulators, two per row, half of the 32 zmm registers available.
+ */
+void gemm_micro_avx512_int(int kc, const int *a, const int *b, int *c, int ldc)
+{
+    __m512i acc[GEMM_AVX512_MR][2];
+    __m512i b0, b1, ai;
+    int i, p;
+
+    for (i = 0; i < GEMM_AVX512_MR; ++i) {
+        acc[i][0] = _mm512_setzero_si512();
+        acc[i][1] = _mm512_setzero_si512();
+    }
+
+    for (p = 0; p < kc; ++p) {
+        b0 = _mm512_loadu_si512((const void *)&b[0]);
+        b1 = _mm512_loadu_si512((const void *)&b[16]);
+        for (i = 0; i < GEMM_AVX512_MR; ++i) {
+            ai = _mm512_set1_epi32(a[i]);
+            acc[i][0] = _mm512_add_epi32(acc[i][0], _mm512_mullo_epi32(ai, b0));
+            acc[i][1] = _mm512_add_epi32(acc[i][1], _mm512_mullo_epi32(ai, b1));
+        }
+        a += GEMM_AVX512_MR;
+        b += GEMM_AVX512_NR(int);
+    }
+
+    for (i = 0; i < GEMM_AVX512_MR; ++i) {
+        int *r = &c[(size_t)i * ldc];
+        _mm512_storeu_si512((void *)r,
+            _mm512_add_epi32(_mm512_loadu_si512((const void *)r), acc[i][0]));
+        _mm512_storeu_si512((void *)(r + 16),
+            _mm512_add_epi32(_mm512_loadu_si512((const void *)(r + 16)), acc[i][1]));
+    }
+}
+
+/*
+ * The other element types use the portable kernel with a tile two AVX-512
+ * registers wide, vectorized by the compiler.
+ */
+GEMM_MICRO_DEFINE(avx512, GEMM_AVX512_MR, GEMM_AVX512_NR, int64, int64_t)
+GEMM_MICRO_DEFINE(avx512, GEMM_AVX512_MR, GEMM_AVX512_NR, float, float)
+GEMM_MICRO_DEFINE(avx512, GEMM_AVX512_MR, GEMM_AVX512_NR, double, double)
+GEMM_MICRO_DEFINE(avx512, GEMM_AVX512_MR, GEMM_AVX512_NR, cdouble, double complex)
+
+/*
+ * Portable quantized micro-kernel with an int tile two AVX-512 registers wide.
+ */
+GEMM_QMICRO_DEFINE(avx512, GEMM_AVX512_MR, GEMM_AVX512_NR)
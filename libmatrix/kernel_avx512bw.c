@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+#include "libmatrix/kernels.h"
+
+/*
+ * AVX-512BW quantized micro-kernel: the 8 x 32 int tile of the AVX-512
+ * kernels in sixteen zmm accumulators. Each step loads the k pairs of 32
+ * columns of B, broadcasts one pair of A per row as a 32-bit lane, and
+ * vpmaddwd multiplies the int16 values and adds each pair into an int lane.
+ */
+void gemm_qmicro_avx512bw(int kc2, const int16_t *a, const int16_t *b, int *c,
+                          int ldc)
+{
+    __m512i acc[GEMM_AVX512_MR][2];
+    __m512i b0, b1, ai;
+    int32_t pair;
+    int i, p;
+
+    for (i = 0; i < GEMM_AVX512_MR; ++i) {
+        acc[i][0] = _mm512_setzero_si512();
+        acc[i][1] = _mm512_setzero_si512();
+    }
+
+    for (p = 0; p < kc2; ++p) {
+        b0 = _mm512_loadu_si512((const void *)&b[0]);
+        b1 = _mm512_loadu_si512((const void *)&b[32]);
+        for (i = 0; i < GEMM_AVX512_MR; ++i) {
+            memcpy(&pair, &a[2 * i], sizeof(pair));
+            ai = _mm512_set1_epi32(pair);
+            acc[i][0] = _mm512_add_epi32(acc[i][0], _mm512_madd_epi16(ai, b0));
+            acc[i][1] = _mm512_add_epi32(acc[i][1], _mm512_madd_epi16(ai, b1));
+        }
+        a += 2 * GEMM_AVX512_MR;
+        b += 2 * GEMM_AVX512_NR(int);
+    }
+
+    for (i = 0; i < GEMM_AVX512_MR; ++i) {
+        int *r = &c[(size_t)i * ldc];
+        _mm512_storeu_si512((void *)r,
+            _mm512_add_epi32(_mm512_loadu_si512((const void *)r), acc[i][0]));
+        _mm512_storeu_si512((void *)(r + 16),
+            _mm512_add_epi32(_mm512_loadu_si512((const void *)(r + 16)), acc[i][1]));
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+#include "libmatrix/kernels.h"
+
+/*
+ * SSE4.1 micro-kernel: a 4 x 8 tile of C is kept in eight xmm accumulators,
+ * two per row, using the 32-bit pmulld multiply introduced with SSE4.1.
+ */
+void gemm_micro_sse41_int(int kc, const int *a, const int *b, int *c, int ldc)
+{
+    __m128i acc[GEMM_SSE41_MR][2];
+    __m128i b0, b1, ai;
+    int i, p;
+
+    for (i = 0; i < GEMM_SSE41_MR; ++i) {
+        acc[i][0] = _mm_setzero_si128();
+        acc[i][1] = _mm_setzero_si128();
+    }
+
+    for (p = 0; p < kc; ++p) {
+        b0 = _mm_loadu_si128((const __m128i *)&b[0]);
+        b1 = _mm_loadu_si128((const __m128i *)&b[4]);
+        for (i = 0; i < GEMM_SSE41_MR; ++i) {
+            ai = _mm_set1_epi32(a[i]);
+            acc[i][0] = _mm_add_epi32(acc[i][0], _mm_mullo_epi32(ai, b0));
+            acc[i][1] = _mm_add_epi32(acc[i][1], _mm_mullo_epi32(ai, b1));
+        }
+        a += GEMM_SSE41_MR;
+        b += GEMM_SSE41_NR(int);
+    }
+
+    for (i = 0; i < GEMM_SSE41_MR; ++i) {
+        __m128i *r = (__m128i *)&c[(size_t)i * ldc];
+        _mm_storeu_si128(r, _mm_add_epi32(_mm_loadu_si128(r), acc[i][0]));
+        _mm_storeu_si128(r + 1, _mm_add_epi32(_mm_loadu_si128(r + 1), acc[i][1]));
+    }
+}
+
+/*
+ * The other element types use the portable kernel with a tile two SSE4.1
+ * registers wide, vectorized by the compiler.
+ */
+GEMM_MICRO_DEFINE(sse41, GEMM_SSE41_MR, GEMM_SSE41_NR, int64, int64_t)
+GEMM_MICRO_DEFINE(sse41, GEMM_SSE41_MR, GEMM_SSE41_NR, float, float)
+GEMM_MICRO_DEFINE(sse41, GEMM_SSE41_MR, GEMM_SSE41_NR, double, double)
+GEMM_MICRO_DEFINE(sse41, GEMM_SSE41_MR, GEMM_SSE41_NR, cdouble, double complex)
+
+/*
+ * Portable quantized micro-kernel with an int tile two SSE4.1 registers wide.
+ */
+GEMM_QMICRO_DEFINE(sse41, GEMM_SSE41_MR, GEMM_SSE41_NR)
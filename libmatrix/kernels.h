@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_KERNELS_H
+#define LIBMATRIX_KERNELS_H
+
+#include <complex.h>
+#include <string.h>
+
+#include "libmatrix/types.h"
+
+/*
+ * Micro-kernels. Each accumulates the product of a packed MR x kc sliver of
+ * A and a packed kc x NR sliver of B into a full MR x NR tile of C, and is
+ * built in its own translation unit with the instruction set flags it needs.
+ * There is one kernel per instruction set and element type, named
+ * gemm_micro_<isa>_<type>. NR spans two vector registers of the element type.
+ */
+#define GEMM_SCALAR_MR 4
+#define GEMM_SCALAR_NR(type) 8
+#define GEMM_SSE41_MR 4
+#define GEMM_SSE41_NR(type) (32 / (int)sizeof(type))
+#define GEMM_AVX2_MR 6
+#define GEMM_AVX2_NR(type) (64 / (int)sizeof(type))
+#define GEMM_AVX512_MR 8
+#define GEMM_AVX512_NR(type) (128 / (int)sizeof(type))
+
+#define GEMM_MICRO_DECL(isa, id, type) \
+    void gemm_micro_##isa##_##id(int kc, const type *a, const type *b, \
+                                 type *c, int ldc);
+
+#define GEMM_MICRO_DECL_SCALAR(id, type, mpi) GEMM_MICRO_DECL(scalar, id, type)
+MATRIX_TYPES(GEMM_MICRO_DECL_SCALAR)
+#ifdef HAVE_KERNEL_SSE41
+#define GEMM_MICRO_DECL_SSE41(id, type, mpi) GEMM_MICRO_DECL(sse41, id, type)
+MATRIX_TYPES(GEMM_MICRO_DECL_SSE41)
+#endif
+#ifdef HAVE_KERNEL_AVX2
+#define GEMM_MICRO_DECL_AVX2(id, type, mpi) GEMM_MICRO_DECL(avx2, id, type)
+MATRIX_TYPES(GEMM_MICRO_DECL_AVX2)
+#endif
+#ifdef HAVE_KERNEL_AVX512
+#define GEMM_MICRO_DECL_AVX512(id, type, mpi) GEMM_MICRO_DECL(avx512, id, type)
+MATRIX_TYPES(GEMM_MICRO_DECL_AVX512)
+#endif
+
+/*
+ * Quantized micro-kernels, one per instruction set, for the int8 and int16
+ * types. Both operands are packed widened to int16 with pairs of consecutive
+ * k side by side, so a sliver of A holds kc2 = ceil(kc / 2) steps of MR pairs
+ * and one of B kc2 steps of NR pairs, and the micro-kernel accumulates their
+ * product into an MR x NR(int) tile of int C.
+ */
+#define GEMM_QMICRO_DECL(isa) \
+    void gemm_qmicro_##isa(int kc2, const int16_t *a, const int16_t *b, \
+                           int *c, int ldc);
+
+GEMM_QMICRO_DECL(scalar)
+#ifdef HAVE_KERNEL_SSE41
+GEMM_QMICRO_DECL(sse41)
+#endif
+#ifdef HAVE_KERNEL_AVX2
+GEMM_QMICRO_DECL(avx2)
+#endif
+#ifdef HAVE_KERNEL_AVX512
+GEMM_QMICRO_DECL(avx512)
+#endif
+#ifdef HAVE_KERNEL_AVX512BW
+GEMM_QMICRO_DECL(avx512bw)
+#endif
+
+/*
+ * Multiply without the checks for infinite and NaN parts that the C
+ * complex multiply performs, which keep it out of vector registers.
+ */
+static inline double complex gemm_cmul(double complex x, double complex y)
+{
+    return CMPLX(creal(x) * creal(y) - cimag(x) * cimag(y),
+                 creal(x) * cimag(y) + cimag(x) * creal(y));
+}
+
+#define GEMM_MUL(x, y) \
+    _Generic((x), double complex: gemm_cmul((x), (y)), default: (x) * (y))
+
+/*
+ * Define the portable micro-kernel gemm_micro_<isa>_<id> for an MR x NR(type)
+ * tile. The tile is held in local accumulators for the whole kc loop so that
+ * C is touched once per tile; with fixed trip counts the compiler vectorizes
+ * the inner loop for whatever instruction set the file is built with.
+ */
+#define GEMM_MICRO_DEFINE(isa, MR, NR, id, type)                            \
+    void gemm_micro_##isa##_##id(int kc, const type *a, const type *b,      \
+                                 type *c, int ldc)                          \
+    {                                                                       \
+        type ab[MR][NR(type)];                                              \
+        int i, j, p;                                                        \
+                                                                            \
+        memset(ab, 0, sizeof(ab));                                          \
+        for (p = 0; p < kc; ++p) {                                          \
+            for (i = 0; i < MR; ++i) {                                      \
+                const type a_ip = a[i];                                     \
+                for (j = 0; j < NR(type); ++j) {                            \
+                    ab[i][j] += GEMM_MUL(a_ip, b[j]);                       \
+                }                                                           \
+            }                                                               \
+            a += MR;                                                        \
+            b += NR(type);                                                  \
+        }                                                                   \
+                                                                            \
+        for (i = 0; i < MR; ++i) {                                          \
+            for (j = 0; j < NR(type); ++j) {                                \
+                c[(size_t)i * ldc + j] += ab[i][j];                         \
+            }                                                               \
+        }                                                                   \
+    }
+
+/*
+ * Define the portable quantized micro-kernel gemm_qmicro_<isa> for an
+ * MR x NR(int) tile: each step adds the products of a pair of A values with
+ * the pairs of every column of B, as pmaddwd does in one instruction.
+ */
+#define GEMM_QMICRO_DEFINE(isa, MR, NR)                                     \
+    void gemm_qmicro_##isa(int kc2, const int16_t *a, const int16_t *b,     \
+                           int *c, int ldc)                                 \
+    {                                                                       \
+        int ab[MR][NR(int)];                                                \
+        int i, j, p;                                                        \
+                                                                            \
+        memset(ab, 0, sizeof(ab));                                          \
+        for (p = 0; p < kc2; ++p) {                                         \
+            for (i = 0; i < MR; ++i) {                                      \
+                const int a0 = a[2 * i], a1 = a[2 * i + 1];                 \
+                for (j = 0; j < NR(int); ++j) {                             \
+                    ab[i][j] += a0 * b[2 * j] + a1 * b[2 * j + 1];          \
+                }                                                           \
+            }                                                               \
+            a += 2 * MR;                                                    \
+            b += 2 * NR(int);                                               \
+        }                                                                   \
+                                                                            \
+        for (i = 0; i < MR; ++i) {                                          \
+            for (j = 0; j < NR(int); ++j) {                                 \
+                c[(size_t)i * ldc + j] += ab[i][j];                         \
+            }                                                               \
+        }                                                                   \
+    }
+
+#endif /* LIBMATRIX_KERNELS_H */
@@ -0,0 +1,388 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/file.h"
+#include "libmatrix/gemm.h"
+#include "libmatrix/ooc.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/*
+ * Widest panel of the inner dimension: one packed KC block of the local
+ * multiply.
+ */
+#define OOC_PANEL GEMM_KC
+
+/*
+ * A tile of a file matrix with ld columns: the rows listed in rows and, of
+ * each, the columns listed in cols, global indices in ascending order.
+ */
+struct tile {
+    const int *rows;
+    int nrows;
+    const int *cols;
+    int ncols;
+};
+
+/*
+ * State of the streamed multiply on one process.
+ */
+struct ooc {
+    const struct matrix_type *type;
+    const struct matrix_dist *d;
+    int K;
+    int mt, nt, kb;
+    int col_tiles, panels, steps;
+    int *grows, *gcols;
+    MPI_Offset offset_A, offset_B, offset_C;
+    MPI_File fh_A, fh_B, fh_C;
+    void *A[2], *B[2], *C[2];
+    MPI_Request read[2][2], write;
+};
+
+/*
+ * Set the file view of fh to a tile of a matrix with ld columns stored at
+ * offset: a type for the columns of one row, with runs of consecutive
+ * columns merged into single blocks, repeated at the start of every row.
+ */
+static int tile_view(MPI_File fh, MPI_Offset offset, int ld,
+                     const struct tile *t, MPI_Datatype etype)
+{
+    MPI_Aint lb, extent, *displs;
+    MPI_Datatype row, view;
+    int *lengths;
+    int i, n = 0, rc;
+
+    MPI_Type_get_extent(etype, &lb, &extent);
+    lengths = malloc(sizeof(*lengths) * t->ncols);
+    displs = malloc(sizeof(*displs) * MAX(t->ncols, t->nrows));
+    assert(lengths != NULL && displs != NULL);
+
+    for (i = 0; i < t->ncols; ++i) {
+        if (i > 0 && t->cols[i] == t->cols[i-1] + 1) {
+            ++lengths[n-1];
+            continue;
+        }
+        displs[n] = (MPI_Aint)t->cols[i] * extent;
+        lengths[n++] = 1;
+    }
+    MPI_Type_create_hindexed(n, lengths, displs, etype, &row);
+
+    for (i = 0; i < t->nrows; ++i) {
+        displs[i] = (MPI_Aint)t->rows[i] * ld * extent;
+    }
+    MPI_Type_create_hindexed_block(t->nrows, 1, displs, row, &view);
+    MPI_Type_commit(&view);
+
+    rc = MPI_File_set_view(fh, offset, etype, view, "native", MPI_INFO_NULL);
+    MPI_Type_free(&row);
+    MPI_Type_free(&view);
+    free(lengths);
+    free(displs);
+    return rc;
+}
+
+/*
+ * Size the tiles: two C tiles, one being written while the next is
+ * computed, and two panels each of A and B, one being read while the other
+ * is multiplied, so 2 mt nt + 2 mt kb + 2 kb nt elements. Tiles are square
+ * unless the local matrix is narrower. Elements count at the size of C,
+ * which is wider than A and B for a quantized type.
+ */
+static int ooc_tiles(struct ooc *o, size_t budget)
+{
+    const double elements = budget / o->type->acc->size;
+    const double kb = o->kb = MIN(o->K, OOC_PANEL);
+    const int t = (sqrt(16 * kb * kb + 8 * elements) - 4 * kb) / 4;
+
+    if (t < 1) {
+        return -1;
+    }
+    o->mt = MIN(o->d->local_rows, t);
+    o->nt = (elements - 2 * o->mt * kb) / (2 * o->mt + 2 * kb);
+    o->nt = MIN(o->d->local_cols, o->nt);
+    return 0;
+}
+
+/*
+ * Return the tile, the first local row and column and the panel of step s.
+ */
+static void ooc_step(const struct ooc *o, int s, int *ti, int *tj, int *mt,
+                     int *nt, int *k, int *kb)
+{
+    const int tile = s / o->panels;
+
+    *ti = (tile / o->col_tiles) * o->mt;
+    *tj = (tile % o->col_tiles) * o->nt;
+    *mt = MIN(o->mt, o->d->local_rows - *ti);
+    *nt = MIN(o->nt, o->d->local_cols - *tj);
+    *k = (s % o->panels) * o->kb;
+    *kb = MIN(o->kb, o->K - *k);
+}
+
+/*
+ * Post the nonblocking reads of the A and B panels of step s into the
+ * buffers of step s.
+ */
+static int ooc_read(struct ooc *o, int s)
+{
+    int cols[OOC_PANEL];
+    int ti, tj, mt, nt, k, kb, i, rc;
+    struct tile t;
+
+    ooc_step(o, s, &ti, &tj, &mt, &nt, &k, &kb);
+    for (i = 0; i < kb; ++i) {
+        cols[i] = k + i;
+    }
+
+    // mt local rows of A by the kb columns of the panel
+    t.rows = &o->grows[ti];
+    t.nrows = mt;
+    t.cols = cols;
+    t.ncols = kb;
+    rc = tile_view(o->fh_A, o->offset_A, o->K, &t, o->type->mpi);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_iread(o->fh_A, o->A[s & 1], mt * kb, o->type->mpi,
+                            &o->read[s & 1][0]);
+    }
+    if (rc != MPI_SUCCESS) {
+        return rc;
+    }
+
+    // The kb rows of the panel of B by nt local columns
+    t.rows = cols;
+    t.nrows = kb;
+    t.cols = &o->gcols[tj];
+    t.ncols = nt;
+    rc = tile_view(o->fh_B, o->offset_B, o->d->cols, &t, o->type->mpi);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_iread(o->fh_B, o->B[s & 1], kb * nt, o->type->mpi,
+                            &o->read[s & 1][1]);
+    }
+    return rc;
+}
+
+/*
+ * Post the nonblocking write of the finished C tile of step s, after the
+ * write of the previous tile, which used the same file view, is done.
+ */
+static int ooc_write(struct ooc *o, int s, int tile)
+{
+    int ti, tj, mt, nt, k, kb, rc;
+    struct tile t;
+
+    MPI_Wait(&o->write, MPI_STATUS_IGNORE);
+    ooc_step(o, s, &ti, &tj, &mt, &nt, &k, &kb);
+    t.rows = &o->grows[ti];
+    t.nrows = mt;
+    t.cols = &o->gcols[tj];
+    t.ncols = nt;
+    rc = tile_view(o->fh_C, o->offset_C, o->d->cols, &t, o->type->acc->mpi);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_iwrite(o->fh_C, o->C[tile & 1], mt * nt, o->type->acc->mpi,
+                             &o->write);
+    }
+    return rc;
+}
+
+/*
+ * Open the input twice, one handle per operand so that each has at most one
+ * read in flight when its view changes, and the output, all on
+ * MPI_COMM_SELF since every process reads and writes at its own pace. Rank
+ * 0 first creates the output and writes its header.
+ */
+static int ooc_open(struct ooc *o, const char *input, const char *output,
+                    MPI_Comm comm)
+{
+    struct matrix_file_header h;
+    MPI_File fh;
+    int rank, rc;
+
+    matrix_file_header_init(&h, MATRIX_FILE_MAGIC, o->type, o->d->rows, o->K,
+                            o->d->cols);
+    o->offset_A = matrix_file_offset(&h, o->type->size, 0);
+    o->offset_B = matrix_file_offset(&h, o->type->size, 1);
+    o->offset_C = sizeof(h);
+
+    MPI_Comm_rank(comm, &rank);
+    rc = MPI_File_open(comm, output, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                       MPI_INFO_NULL, &fh);
+    if (rc != MPI_SUCCESS) {
+        return rc;
+    }
+    rc = MPI_File_set_size(fh, 0);
+    if (rc == MPI_SUCCESS && rank == 0) {
+        matrix_file_header_init(&h, MATRIX_FILE_MAGIC_C, o->type->acc, o->d->rows,
+                                o->K, o->d->cols);
+        rc = MPI_File_write_at(fh, 0, &h, sizeof(h), MPI_BYTE,
+                               MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&fh);
+    if (rc != MPI_SUCCESS) {
+        return rc;
+    }
+
+    rc = MPI_File_open(MPI_COMM_SELF, input, MPI_MODE_RDONLY, MPI_INFO_NULL,
+                       &o->fh_A);
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_open(MPI_COMM_SELF, input, MPI_MODE_RDONLY,
+                           MPI_INFO_NULL, &o->fh_B);
+    }
+    if (rc == MPI_SUCCESS) {
+        rc = MPI_File_open(MPI_COMM_SELF, output, MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &o->fh_C);
+    }
+    return rc;
+}
+
+/*
+ * Stream the steps of every tile: step s multiplies panel s % panels of
+ * tile s / panels while the panels of step s + 1 are read.
+ */
+static int ooc_run(struct ooc *o, struct matrix_ooc_stats *stats)
+{
+    int ti, tj, mt, nt, k, kb, s, tile, rc;
+    double start;
+
+    rc = o->steps > 0 ? ooc_read(o, 0) : MPI_SUCCESS;
+    for (s = 0; s < o->steps && rc == MPI_SUCCESS; ++s) {
+        tile = s / o->panels;
+        ooc_step(o, s, &ti, &tj, &mt, &nt, &k, &kb);
+
+        start = MPI_Wtime();
+        MPI_Waitall(2, o->read[s & 1], MPI_STATUSES_IGNORE);
+        stats->wait_time += MPI_Wtime() - start;
+        if (s + 1 < o->steps) {
+            rc = ooc_read(o, s + 1);
+        }
+
+        // The tile buffer was last written out two tiles ago
+        if (k == 0) {
+            memset(o->C[tile & 1], 0, (size_t)mt * nt * o->type->acc->size);
+        }
+
+        start = MPI_Wtime();
+        matrix_gemm(o->type, mt, nt, kb, o->A[s & 1], kb, o->B[s & 1], nt,
+                    o->C[tile & 1], nt);
+        stats->compute_time += MPI_Wtime() - start;
+
+        if (k + kb == o->K && rc == MPI_SUCCESS) {
+            start = MPI_Wtime();
+            rc = ooc_write(o, s, tile);
+            stats->wait_time += MPI_Wtime() - start;
+        }
+    }
+
+    // Reads are only left in flight after an error
+    start = MPI_Wtime();
+    MPI_Waitall(2, o->read[0], MPI_STATUSES_IGNORE);
+    MPI_Waitall(2, o->read[1], MPI_STATUSES_IGNORE);
+    MPI_Wait(&o->write, MPI_STATUS_IGNORE);
+    stats->wait_time += MPI_Wtime() - start;
+    return rc;
+}
+
+/*
+ * Stream the multiply through buffers that fit the budget.
+ */
+int matrix_ooc_gemm(const char *input, const char *output,
+                    const struct matrix_type *type,
+                    const struct matrix_dist *d, int K, size_t budget,
+                    MPI_Comm comm, struct matrix_ooc_stats *stats)
+{
+    struct ooc o;
+    int i, rc;
+
+    memset(&o, 0, sizeof(o));
+    memset(stats, 0, sizeof(*stats));
+    o.type = type;
+    o.d = d;
+    o.K = K;
+    o.fh_A = o.fh_B = o.fh_C = MPI_FILE_NULL;
+    o.write = MPI_REQUEST_NULL;
+    if (ooc_tiles(&o, budget) != 0) {
+        return MPI_ERR_NO_MEM;
+    }
+    stats->tile_rows = o.mt;
+    stats->tile_cols = o.nt;
+    stats->panel = o.kb;
+
+    o.panels = (K + o.kb - 1) / o.kb;
+    o.col_tiles = o.nt > 0 ? (d->local_cols + o.nt - 1) / o.nt : 0;
+    o.steps = o.mt > 0 ? ((d->local_rows + o.mt - 1) / o.mt) * o.col_tiles
+                         * o.panels : 0;
+
+    // Global indices of the local rows and columns
+    o.grows = malloc(sizeof(*o.grows) * (d->local_rows + 1));
+    o.gcols = malloc(sizeof(*o.gcols) * (d->local_cols + 1));
+    assert(o.grows != NULL && o.gcols != NULL);
+    for (i = 0; i < d->local_rows; ++i) {
+        o.grows[i] = matrix_indxl2g(i, d->nb, d->myrow, d->prows);
+    }
+    for (i = 0; i < d->local_cols; ++i) {
+        o.gcols[i] = matrix_indxl2g(i, d->nb, d->mycol, d->pcols);
+    }
+
+    for (i = 0; i < 2; ++i) {
+        o.A[i] = malloc((size_t)o.mt * o.kb * type->size + 1);
+        o.B[i] = malloc((size_t)o.kb * o.nt * type->size + 1);
+        o.C[i] = malloc((size_t)o.mt * o.nt * type->acc->size + 1);
+        assert(o.A[i] != NULL && o.B[i] != NULL && o.C[i] != NULL);
+        o.read[i][0] = o.read[i][1] = MPI_REQUEST_NULL;
+    }
+
+    rc = ooc_open(&o, input, output, comm);
+    if (rc == MPI_SUCCESS) {
+        rc = ooc_run(&o, stats);
+    }
+    if (o.fh_A != MPI_FILE_NULL) {
+        MPI_File_close(&o.fh_A);
+    }
+    if (o.fh_B != MPI_FILE_NULL) {
+        MPI_File_close(&o.fh_B);
+    }
+    if (o.fh_C != MPI_FILE_NULL) {
+        MPI_File_close(&o.fh_C);
+    }
+
+    for (i = 0; i < 2; ++i) {
+        free(o.A[i]);
+        free(o.B[i]);
+        free(o.C[i]);
+    }
+    free(o.grows);
+    free(o.gcols);
+    return rc;
+}
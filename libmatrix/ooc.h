@@ -0,0 +1,60 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_OOC_H
+#define LIBMATRIX_OOC_H
+
+#include <stddef.h>
+#include <mpi.h>
+
+#include "libmatrix/dist.h"
+#include "libmatrix/types.h"
+
+/*
+ * Tile shape and timings of an out-of-core multiply on one process.
+ */
+struct matrix_ooc_stats {
+    int tile_rows, tile_cols;
+    int panel;
+    double compute_time;
+    double wait_time;
+};
+
+/*
+ * Multiply the matrices of the binary file input out of core and write C to
+ * the binary file output, collectively over comm, the communicator of the
+ * block-cyclic distribution d of C. Every process computes its own blocks of
+ * C one tile at a time. It streams the panels of A and B that a tile needs
+ * straight from the file, prefetching the next panel with nonblocking reads
+ * while the current one is multiplied, and flushes each finished tile with a
+ * nonblocking write. All buffers fit in budget bytes per process, whatever
+ * the matrix size. Returns an MPI error code: MPI_ERR_NO_MEM if budget
+ * cannot hold even a single row tile.
+ */
+int matrix_ooc_gemm(const char *input, const char *output,
+                    const struct matrix_type *type,
+                    const struct matrix_dist *d, int K, size_t budget,
+                    MPI_Comm comm, struct matrix_ooc_stats *stats);
+
+#endif /* LIBMATRIX_OOC_H */
@@ -0,0 +1,1385 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libmatrix/arena.h"
+#include "libmatrix/file.h"
+#include "libmatrix/gemm.h"
+#include "libmatrix/program.h"
+#include "libmatrix/threads.h"
+#include "libmatrix/trace.h"
+#include "libmatrix/tune.h"
+#include "libmatrix/verify.h"
+
+/*
+ * A shared option: a program takes it if it has all of features.
+ */
+struct shared_option {
+    struct matrix_program_option option;
+    unsigned features;
+};
+
+/*
+ * Shared options listed before a program's own options.
+ */
+static const struct shared_option leading_options[] = {
+    { { "help", no_argument, 'h',
+        "    --help|-h:        print this help\n" }, 0 },
+    { { "matrix", required_argument, 'm', NULL }, 0 },
+    { { "generate", required_argument, 'g',
+        "    --generate|-g:    generate random N or MxKxN matrices on every\n"
+        "                      process instead of reading a file\n" }, 0 },
+    { { "seed", required_argument, 'r',
+        "    --seed|-r:        random seed of --generate (default 1)\n" }, 0 },
+    { { "density", required_argument, 'D',
+        "    --density|-D:     fraction of nonzeros of sparse matrices from\n"
+        "                      --generate\n" }, MATRIX_PROGRAM_SPARSE },
+    { { "batch", required_argument, 'B',
+        "    --batch|-B:       multiply the binary matrix files listed in this\n"
+        "                      manifest, each with an optional output file\n" },
+      MATRIX_PROGRAM_BATCH },
+    { { "output", required_argument, 'o',
+        "    --output|-o:      write C to this file instead of printing it\n" }, 0 },
+    { { "format", required_argument, 'f',
+        "    --format|-f:      output file format: binary (default) or text\n" }, 0 },
+    { { "quiet", no_argument, 'q',
+        "    --quiet|-q:       print a checksum of C instead of the matrices\n" }, 0 },
+    { { "verify", required_argument, 'V',
+        "    --verify|-V:      check C = AB with this many Freivalds trials of\n"
+        "                      O(N^2) work each; a mismatch exits with status 1\n" }, 0 },
+    { { "block", required_argument, 'b',
+        "    --block|-b:       block size of the block-cyclic distribution\n" }, 0 },
+    { { "grid", required_argument, 'G',
+        "    --grid|-G:        process grid RxC, with 0 for a dimension to fit\n"
+        "                      the number of processes (default 0x0)\n" },
+      MATRIX_PROGRAM_GRID },
+    { { "dtype", required_argument, 'd',
+        "    --dtype|-d:       element type of a text file or --generate: int\n"
+        "                      (default), int64, float, double, complex, or\n"
+        "                      int8 or int16 accumulating in an int C\n" }, 0 },
+    { { "kernel", required_argument, 'k',
+        "    --kernel|-k:      local multiply micro-kernel: auto (default),\n"
+        "                      scalar, sse4.1, avx2 or avx512\n" }, 0 },
+    { { "local", required_argument, 'l',
+        "    --local|-l:       local multiply: blocked (default) or strassen\n"
+        "                      (Strassen-Winograd)\n" }, 0 },
+    { { "cutoff", required_argument, 'C',
+        "    --cutoff|-C:      size down to which strassen recurses (default 512)\n" }, 0 },
+    { { "threads", required_argument, 't',
+        "    --threads|-t:     threads per process for the local multiply\n" }, 0 },
+    { { "pin", no_argument, 'p',
+        "    --pin|-p:         pin each thread to its own core\n" }, 0 },
+    { { NULL, 0, 0, NULL }, 0 }
+};
+
+/*
+ * Shared options listed after a program's own options.
+ */
+static const struct shared_option trailing_options[] = {
+    { { "requests", required_argument, 'R',
+        "    --requests|-R:    loop transfers: persistent sets them up once as\n"
+        "                      persistent requests, plain posts them anew every\n"
+        "                      step (default persistent, plain for summa)\n" }, 0 },
+    { { "pages", required_argument, 'P',
+        "    --pages|-P:       pages of the local blocks: small, thp (default,\n"
+        "                      transparent huge pages) or huge (MAP_HUGETLB)\n" }, 0 },
+    { { "profile", required_argument, 'T',
+        "    --profile|-T:     profile of tuned grids, block sizes, panel widths\n"
+        "                      and threads: take those not given from its line\n"
+        "                      for this multiply, tuning it first if there is\n"
+        "                      none\n" }, MATRIX_PROGRAM_PROFILE },
+    { { NULL, 0, 0, NULL }, 0 }
+};
+
+/*
+ * Return nonzero if program takes the shared option s.
+ */
+static int takes(const struct matrix_program *program,
+                 const struct shared_option *s)
+{
+    return (program->features & s->features) == s->features;
+}
+
+/*
+ * Print the usage of program: the shared options it takes around its own.
+ */
+static void usage(const struct matrix_program *program)
+{
+    const struct shared_option *s;
+    const struct matrix_program_option *o;
+
+    fprintf(stderr, "usage: %s <options>\n"
+                    "  Options are:\n", program->name);
+    for (s = leading_options; s->option.name != NULL; ++s) {
+        if (s->option.val == 'm') {
+            fprintf(stderr, "    --matrix|-m:      matrix input file, binary%s\n",
+                    (program->features & MATRIX_PROGRAM_SPARSE)
+                    ? ", text or sparse text" : " or text");
+        } else if (takes(program, s)) {
+            fputs(s->option.usage, stderr);
+        }
+    }
+    for (o = program->options; o != NULL && o->name != NULL; ++o) {
+        fputs(o->usage, stderr);
+    }
+    for (s = trailing_options; s->option.name != NULL; ++s) {
+        if (takes(program, s)) {
+            fputs(s->option.usage, stderr);
+        }
+    }
+}
+
+/*
+ * Append option o to the getopt_long table and short option string of a
+ * command line.
+ */
+static void add_option(const struct matrix_program_option *o,
+                       struct option *long_options, int *count,
+                       char *short_options)
+{
+    struct option *l = &long_options[(*count)++];
+    char *end = short_options + strlen(short_options);
+
+    l->name = o->name;
+    l->has_arg = o->has_arg;
+    l->flag = NULL;
+    l->val = o->val;
+    *end++ = (char)o->val;
+    if (o->has_arg == required_argument) {
+        *end++ = ':';
+    }
+    *end = '\0';
+}
+
+/*
+ * Parse the command line of program into opts and the dimensions of
+ * --generate. Returns 0, 1 for --help, or 2 for an invalid option.
+ */
+static int parse(const struct matrix_program *program, int argc, char *argv[],
+                 struct matrix_options *opts, int *M, int *K, int *N)
+{
+    const struct shared_option *s;
+    const struct matrix_program_option *o;
+    struct option *long_options;
+    char *short_options;
+    int c, n, count = 0, help = 0;
+
+    n = sizeof(leading_options) / sizeof(leading_options[0])
+      + sizeof(trailing_options) / sizeof(trailing_options[0]);
+    for (o = program->options; o != NULL && o->name != NULL; ++o) {
+        ++n;
+    }
+    long_options = calloc(n, sizeof(*long_options));
+    short_options = calloc(2 * n + 1, 1);
+    assert(long_options != NULL && short_options != NULL);
+    for (s = leading_options; s->option.name != NULL; ++s) {
+        if (takes(program, s)) {
+            add_option(&s->option, long_options, &count, short_options);
+        }
+    }
+    for (o = program->options; o != NULL && o->name != NULL; ++o) {
+        add_option(o, long_options, &count, short_options);
+    }
+    for (s = trailing_options; s->option.name != NULL; ++s) {
+        if (takes(program, s)) {
+            add_option(&s->option, long_options, &count, short_options);
+        }
+    }
+
+    while (1) {
+        int option_index = 0;
+        c = getopt_long(argc, argv, short_options, long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                help = 1;
+                break;
+            case 'm':
+                strncpy(opts->matrix, optarg, sizeof(opts->matrix)-1);
+                break;
+            case 'g':
+                // Either N for square matrices or MxKxN
+                n = sscanf(optarg, "%dx%dx%d", M, K, N);
+                if (n == 1) {
+                    *K = *N = *M;
+                } else if (n != 3) {
+                    help = 2;
+                }
+                if (*M <= 0 || *K <= 0 || *N <= 0) {
+                    help = 2;
+                }
+                opts->generate = 1;
+                break;
+            case 'B':
+                strncpy(opts->batch, optarg, sizeof(opts->batch)-1);
+                break;
+            case 'r':
+                opts->seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'D':
+                opts->density = atof(optarg);
+                if (opts->density <= 0.0 || opts->density > 1.0) {
+                    help = 2;
+                }
+                opts->sparse = 1;
+                break;
+            case 'o':
+                strncpy(opts->output, optarg, sizeof(opts->output)-1);
+                break;
+            case 'f':
+                if (strcmp(optarg, "binary") == 0) {
+                    opts->text = 0;
+                } else if (strcmp(optarg, "text") == 0) {
+                    opts->text = 1;
+                } else {
+                    help = 2;
+                }
+                break;
+            case 'q':
+                opts->quiet = 1;
+                break;
+            case 'V':
+                opts->verify = atoi(optarg);
+                if (opts->verify <= 0) {
+                    help = 2;
+                }
+                break;
+            case 'b':
+                opts->block = atoi(optarg);
+                break;
+            case 'G':
+                if (sscanf(optarg, "%dx%d", &opts->prows, &opts->pcols) != 2
+                    || opts->prows < 0 || opts->pcols < 0) {
+                    help = 2;
+                }
+                break;
+            case 'd':
+                strncpy(opts->dtype, optarg, sizeof(opts->dtype)-1);
+                break;
+            case 'k':
+                strncpy(opts->kernel, optarg, sizeof(opts->kernel)-1);
+                break;
+            case 'l':
+                if (strcmp(optarg, "blocked") == 0) {
+                    opts->strassen = 0;
+                } else if (strcmp(optarg, "strassen") == 0) {
+                    opts->strassen = 1;
+                } else {
+                    help = 2;
+                }
+                break;
+            case 'C':
+                opts->cutoff = atoi(optarg);
+                if (opts->cutoff <= 0) {
+                    help = 2;
+                }
+                break;
+            case 't':
+                opts->threads = atoi(optarg);
+                break;
+            case 'p':
+                opts->pin = 1;
+                break;
+            case 'R':
+                if (strcmp(optarg, "persistent") == 0) {
+                    opts->persistent = 1;
+                } else if (strcmp(optarg, "plain") == 0) {
+                    opts->persistent = 0;
+                } else {
+                    help = 2;
+                }
+                break;
+            case 'P':
+                if (matrix_arena_set_pages(optarg) == 0) {
+                    strncpy(opts->pages, optarg, sizeof(opts->pages)-1);
+                } else {
+                    help = 2;
+                }
+                break;
+            case 'T':
+                strncpy(opts->profile, optarg, sizeof(opts->profile)-1);
+                break;
+            default:
+                // The program's own options
+                if (program->parse != NULL && program->parse(opts, c, optarg) != 0) {
+                    help = 2;
+                }
+                break;
+        }
+    }
+
+    free(long_options);
+    free(short_options);
+    if (opts->dtype[0] != '\0' && matrix_type_find(opts->dtype) == NULL) {
+        help = 2;
+    }
+    return help;
+}
+
+/*
+ * Exit with status 2 if program rejects the options it was given.
+ */
+static void check(const struct matrix_program *program,
+                  const struct matrix_options *opts)
+{
+    if (program->check != NULL && program->check(opts) != 0) {
+        exit(2);
+    }
+}
+
+/*
+ * Parse the command line and set up the input on rank 0.
+ */
+void matrix_program_initialize(const struct matrix_program *program,
+                               int argc, char *argv[],
+                               struct matrix_options *opts, int *M, int *K,
+                               int *N, void **A, void **B, void **C,
+                               struct matrix_coo *coo_A,
+                               struct matrix_coo *coo_B,
+                               struct matrix_batch_item **items, int *count)
+{
+    const struct matrix_type *type;
+    struct matrix_file_header header;
+    FILE *fp = NULL;
+    int rc, help;
+
+    memset(opts, '\0', sizeof(*opts));
+    strncpy(opts->kernel, "auto", sizeof(opts->kernel)-1);
+    opts->cutoff = GEMM_STRASSEN_CUTOFF;
+    opts->seed = 1;
+    opts->overlap = 1;
+    opts->slow = -1;
+    opts->persistent = -1;
+    strncpy(opts->pages, "thp", sizeof(opts->pages)-1);
+
+    help = parse(program, argc, argv, opts, M, K, N);
+    if (help) {
+        usage(program);
+        exit(help == 1 ? 0 : 2);
+    }
+    if ((opts->matrix[0] != '\0') + opts->generate + (opts->batch[0] != '\0') != 1) {
+        usage(program);
+        exit(2);
+    }
+    if (opts->sparse && !opts->generate) {
+        fprintf(stderr, "--density applies to --generate only\n");
+        exit(2);
+    }
+    if (opts->sparse && opts->profile[0] != '\0') {
+        fprintf(stderr, "--profile applies to dense matrices\n");
+        exit(2);
+    }
+
+    // A batch lists binary files of one element type and shape, read by
+    // every process later on
+    if (opts->batch[0] != '\0') {
+        if (opts->verify > 0) {
+            fprintf(stderr, "--verify does not apply to --batch\n");
+            exit(2);
+        }
+        if (opts->output[0] != '\0') {
+            fprintf(stderr, "--batch takes its output files from the manifest\n");
+            exit(2);
+        }
+        rc = matrix_batch_read(opts->batch, &type, M, K, N, items, count);
+        if (rc < 0) {
+            fprintf(stderr, "Cannot read a batch from %s\n", opts->batch);
+            exit(1);
+        } else if (rc > 0) {
+            fprintf(stderr, "Item %d of %s is not a binary matrix file like "
+                            "item 1\n", rc, opts->batch);
+            exit(1);
+        }
+        if (opts->dtype[0] != '\0' && matrix_type_find(opts->dtype) != type) {
+            fprintf(stderr, "%s holds %s elements\n", opts->batch, type->name);
+            exit(2);
+        }
+        strncpy(opts->dtype, type->name, sizeof(opts->dtype)-1);
+        opts->binary = 1;
+        check(program, opts);
+        return;
+    }
+
+    // Every process generates its own blocks later on
+    if (opts->generate) {
+        if (opts->dtype[0] == '\0') {
+            strncpy(opts->dtype, "int", sizeof(opts->dtype)-1);
+        }
+        type = matrix_type_find(opts->dtype);
+        if (opts->sparse && type->acc != type) {
+            fprintf(stderr, "Sparse matrices take no quantized element type\n");
+            exit(2);
+        }
+        check(program, opts);
+        if (!opts->quiet && opts->output[0] == '\0') {
+            *C = calloc((size_t)*M * *N, type->acc->size);
+            assert(*C != NULL);
+        }
+        return;
+    }
+
+    fp = fopen(opts->matrix, "rb");
+    if (fp == NULL) {
+        fprintf(stderr,"%s (%s)\n", strerror(errno), opts->matrix);
+        exit(1);
+    }
+
+    // A binary file names its element type and is read by every process
+    // later on; a text file is read here, and a sparse one scattered later
+    switch (matrix_file_read_header(fp, &header)) {
+        case 0:
+            type = matrix_type_find(header.dtype);
+            if (opts->dtype[0] != '\0' && matrix_type_find(opts->dtype) != type) {
+                fprintf(stderr, "%s holds %s elements\n", opts->matrix, header.dtype);
+                exit(2);
+            }
+            strncpy(opts->dtype, header.dtype, sizeof(opts->dtype)-1);
+            opts->binary = 1;
+            *M = header.M;
+            *K = header.K;
+            *N = header.N;
+            break;
+        case 1:
+            if (opts->dtype[0] == '\0') {
+                strncpy(opts->dtype, "int", sizeof(opts->dtype)-1);
+            }
+            type = matrix_type_find(opts->dtype);
+            rc = 1;
+            if (program->features & MATRIX_PROGRAM_SPARSE) {
+                rc = matrix_file_read_sparse(fp, type, M, K, N, coo_A, coo_B);
+            }
+            if (rc == 0) {
+                opts->sparse = 1;
+                break;
+            }
+            if (rc > 0 && matrix_file_read_text(fp, type, M, K, N, A, B) == 0) {
+                break;
+            }
+            // fall through
+        default:
+            fprintf(stderr, "Malformed matrix file (%s)\n", opts->matrix);
+            exit(1);
+    }
+    fclose(fp);
+    if (opts->sparse && type->acc != type) {
+        fprintf(stderr, "Sparse matrices take no quantized element type\n");
+        exit(2);
+    }
+    if (opts->sparse && opts->profile[0] != '\0') {
+        fprintf(stderr, "--profile applies to dense matrices\n");
+        exit(2);
+    }
+    check(program, opts);
+
+    // Only a printed C is gathered on rank 0
+    if (!opts->quiet && opts->output[0] == '\0') {
+        *C = calloc((size_t)*M * *N, type->acc->size);
+        assert(*C != NULL);
+    }
+}
+
+/*
+ * Select the local multiply and its micro-kernel on every process.
+ */
+int matrix_program_kernel(int rank, const struct matrix_options *opts)
+{
+    char name[sizeof(opts->kernel)];
+    int error = 0, any_error = 0;
+
+    // A deliberately slow rank falls back to the scalar micro-kernel
+    const char *kernel = rank == opts->slow ? "scalar" : opts->kernel;
+    if (matrix_gemm_set_kernel(kernel) != 0) {
+        fprintf(stderr, "Rank %d cannot use the %s micro-kernel\n",
+                rank, kernel);
+        error = 1;
+    }
+    MPI_Allreduce(&error, &any_error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (any_error) {
+        return 1;
+    }
+    matrix_gemm_set_strassen(opts->strassen ? opts->cutoff : 0);
+
+    // Report rank 0's choice and any process whose CPU chose differently
+    memset(name, '\0', sizeof(name));
+    if (rank == 0) {
+        strncpy(name, matrix_gemm_kernel(), sizeof(name)-1);
+        printf("Using the %s micro-kernel.\n", name);
+        if (opts->strassen) {
+            printf("Using the Strassen-Winograd multiply down to %d.\n",
+                   opts->cutoff);
+        }
+    }
+    MPI_Bcast(name, sizeof(name), MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (strcmp(name, matrix_gemm_kernel()) != 0) {
+        printf("Rank %d is using the %s micro-kernel.\n",
+               rank, matrix_gemm_kernel());
+    }
+    return 0;
+}
+
+/*
+ * Fill in the configuration of a multiply from the options.
+ */
+void matrix_program_config(const struct matrix_options *opts,
+                           enum matrix_algorithm algorithm,
+                           const struct matrix_type *type, int M, int K, int N,
+                           struct matrix_config *config)
+{
+    config->algorithm = algorithm;
+    config->type = type;
+    config->M = M;
+    config->K = K;
+    config->N = N;
+    config->prows = opts->prows;
+    config->pcols = opts->pcols;
+    config->block = opts->block;
+    config->panel = opts->panel;
+    config->overlap = opts->overlap;
+    config->replicas = opts->replicas;
+    config->shared = opts->shared;
+    config->node_size = opts->node_size;
+    config->rma = opts->rma;
+
+    // Sparse blocks change size every step, so their transfers are posted
+    // anew. SUMMA's persistent broadcasts make the owners copy every panel
+    // into the buffers the requests are bound to, so it posts them anew
+    // unless asked.
+    if (opts->persistent < 0) {
+        config->persistent = algorithm != MATRIX_SUMMA;
+    } else {
+        config->persistent = opts->persistent;
+    }
+    config->persistent = config->persistent && !opts->sparse;
+}
+
+/*
+ * Fill the local arrays of A and B on every process of comm.
+ */
+int matrix_program_load(const struct matrix_options *opts,
+                        const struct matrix_type *type,
+                        const struct matrix_dist *dist_A, void *local_A,
+                        const struct matrix_dist *dist_B, void *local_B,
+                        const void *A, const void *B, MPI_Comm comm)
+{
+    struct matrix_file_header header;
+    char error[MPI_MAX_ERROR_STRING];
+    MPI_File fh;
+    int rc, len;
+
+    if (opts->generate) {
+        matrix_dist_generate(dist_A, type, 2 * opts->seed, local_A);
+        matrix_dist_generate(dist_B, type, 2 * opts->seed + 1, local_B);
+        return 0;
+    }
+    if (!opts->binary) {
+        matrix_dist_scatter(dist_A, type->mpi, A, local_A, 0, comm);
+        matrix_dist_scatter(dist_B, type->mpi, B, local_B, 0, comm);
+        return 0;
+    }
+
+    header.M = dist_A->rows;
+    header.K = dist_A->cols;
+    header.N = dist_B->cols;
+    rc = MPI_File_open(comm, opts->matrix, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+    if (rc == MPI_SUCCESS) {
+        rc = matrix_dist_read(dist_A, type->mpi, fh,
+                              matrix_file_offset(&header, type->size, 0), local_A);
+        if (rc == MPI_SUCCESS) {
+            rc = matrix_dist_read(dist_B, type->mpi, fh,
+                                  matrix_file_offset(&header, type->size, 1), local_B);
+        }
+        MPI_File_close(&fh);
+    }
+    if (rc != MPI_SUCCESS) {
+        MPI_Error_string(rc, error, &len);
+        fprintf(stderr, "%s (%s)\n", error, opts->matrix);
+        MPI_Abort(comm, 1);
+    }
+    return rc;
+}
+
+/*
+ * Write C to the output file and, in quiet mode, print its checksum.
+ */
+void matrix_program_save(const struct matrix_options *opts,
+                         const struct matrix_type *type,
+                         const struct matrix_dist *dist_C, int K,
+                         const void *local_C, MPI_Comm comm)
+{
+    char error[MPI_MAX_ERROR_STRING];
+    uint64_t digest;
+    double norm, start;
+    int rank, rc, len;
+
+    MPI_Comm_rank(comm, &rank);
+
+    if (opts->output[0] != '\0') {
+        start = MPI_Wtime();
+        rc = matrix_file_write_dist(opts->output, opts->text, type, dist_C, K,
+                                    local_C, comm);
+        if (rc != MPI_SUCCESS) {
+            MPI_Error_string(rc, error, &len);
+            fprintf(stderr, "%s (%s)\n", error, opts->output);
+            MPI_Abort(comm, 1);
+        }
+        if (rank == 0) {
+            printf("Wrote the %dx%d matrix C to %s in %.6f seconds.\n",
+                   dist_C->rows, dist_C->cols, opts->output,
+                   MPI_Wtime() - start);
+        }
+    }
+
+    if (opts->quiet) {
+        matrix_dist_checksum(dist_C, type, local_C, 0, comm, &digest, &norm);
+        if (rank == 0) {
+            printf("Checksum of C: %016" PRIx64 " (norm %.9g).\n",
+                   digest, norm);
+        }
+    }
+}
+
+/*
+ * Fill the sparse local blocks of A and B on every process of comm.
+ */
+void matrix_program_load_sparse(const struct matrix_options *opts,
+                                const struct matrix_type *type,
+                                const struct matrix_dist *dist_A,
+                                void **local_A,
+                                const struct matrix_dist *dist_B,
+                                void **local_B, const struct matrix_coo *coo_A,
+                                const struct matrix_coo *coo_B, MPI_Comm comm)
+{
+    if (opts->generate) {
+        *local_A = matrix_sparse_generate(dist_A, type, 2 * opts->seed,
+                                          opts->density);
+        *local_B = matrix_sparse_generate(dist_B, type, 2 * opts->seed + 1,
+                                          opts->density);
+    } else {
+        *local_A = matrix_sparse_scatter(dist_A, type, coo_A, 0, comm);
+        *local_B = matrix_sparse_scatter(dist_B, type, coo_B, 0, comm);
+    }
+}
+
+/*
+ * Print how much of the sparse matrices A and B is stored.
+ */
+void matrix_program_sparse_report(const struct matrix_sparse *A,
+                                  const struct matrix_sparse *B, int M, int K,
+                                  int N, MPI_Comm comm)
+{
+    int64_t nnz[2];
+    int dense[2], procs, rank;
+
+    MPI_Comm_size(comm, &procs);
+    MPI_Comm_rank(comm, &rank);
+    matrix_sparse_count(A, comm, &nnz[0], &dense[0]);
+    matrix_sparse_count(B, comm, &nnz[1], &dense[1]);
+    if (rank == 0) {
+        printf("Stored %.2f%% of A and %.2f%% of B; %d and %d of %d local "
+               "blocks dense.\n", 100.0 * nnz[0] / ((double)M * K),
+               100.0 * nnz[1] / ((double)K * N), dense[0], dense[1], procs);
+    }
+}
+
+/*
+ * Multiply a batch with one context.
+ */
+int matrix_program_batch(const struct matrix_options *opts,
+                         enum matrix_algorithm algorithm,
+                         const struct matrix_type *type, int M, int K, int N,
+                         struct matrix_batch_item *items, int count)
+{
+    char error[MPI_MAX_ERROR_STRING];
+    double *latency, *max_latency;
+    struct matrix_config config;
+    struct matrix_context *ctx;
+    struct matrix_batch_stats stats;
+    double max_total_time = 0.0, max_compute_time = 0.0, max_wait_time = 0.0;
+    double min, sum, max;
+    int world_rank, rank, procs, rc, len, i;
+    MPI_Comm comm;
+
+    // Every process needs the list of files
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
+    MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) {
+        items = calloc(count, sizeof(*items));
+        assert(items != NULL);
+    }
+    MPI_Bcast(items, count * (int)sizeof(*items), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    matrix_program_config(opts, algorithm, type, M, K, N, &config);
+    if (matrix_context_create(MPI_COMM_WORLD, &config, &ctx) != MPI_SUCCESS) {
+        if (world_rank == 0) {
+            fprintf(stderr, "Number of processes (%d) does not fit a %dx%d grid\n",
+                    procs, opts->prows, opts->pcols);
+        } else {
+            free(items);
+        }
+        return 2;
+    }
+    comm = matrix_context_comm(ctx);
+    MPI_Comm_rank(comm, &rank);
+
+    rc = matrix_batch_run(ctx, type, items, count, &stats);
+    if (rc != MPI_SUCCESS) {
+        MPI_Error_string(rc, error, &len);
+        fprintf(stderr, "%s (%s)\n", error, opts->batch);
+        MPI_Abort(comm, 1);
+    }
+
+    // The slowest process bounds every product and the whole batch
+    latency = calloc(count, sizeof(double));
+    max_latency = calloc(count, sizeof(double));
+    assert(latency != NULL && max_latency != NULL);
+    for (i = 0; i < count; ++i) {
+        latency[i] = items[i].latency;
+    }
+    MPI_Reduce(latency, max_latency, count, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&stats.total_time, &max_total_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+               comm);
+    MPI_Reduce(&stats.compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX,
+               0, comm);
+    MPI_Reduce(&stats.wait_time, &max_wait_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+               comm);
+
+    if (rank == 0) {
+        const struct matrix_dist *dist_C = matrix_context_dist(ctx, 2);
+        const double *t = max_latency;
+        printf("Multiplied %d pairs of %dx%d and %dx%d matrices on a %dx%d "
+               "grid of %d processes in %dx%d blocks.\n", count, M, K, K, N,
+               dist_C->prows, dist_C->pcols, procs, dist_C->nb, dist_C->nb);
+        min = max = t[0];
+        sum = 0.0;
+        for (i = 0; i < count; ++i) {
+            if (opts->quiet) {
+                // Only the totals
+            } else if (items[i].output[0] != '\0') {
+                printf("Item %d: wrote C of %s to %s in %.6f seconds.\n", i + 1,
+                       items[i].input, items[i].output, t[i]);
+            } else {
+                printf("Item %d: checksum of C of %s: %016" PRIx64 " (norm %.9g) "
+                       "in %.6f seconds.\n", i + 1, items[i].input,
+                       items[i].digest, items[i].norm, t[i]);
+            }
+            min = t[i] < min ? t[i] : min;
+            max = t[i] > max ? t[i] : max;
+            sum += t[i];
+        }
+        printf("Latency per product: min %.6f, avg %.6f, max %.6f seconds.\n",
+               min, sum / count, max);
+        printf("Local multiply time: %.6f seconds with %d threads per process.\n",
+               max_compute_time, matrix_threads());
+        printf("I/O wait time: %.6f seconds.\n", max_wait_time);
+        printf("Batch time: %.6f seconds, %.3f products/s, %.3f GFLOP/s.\n",
+               max_total_time, count / max_total_time,
+               type->flops * (double)M * K * N * count / max_total_time * 1e-9);
+    }
+
+    free(latency);
+    free(max_latency);
+    matrix_context_free(ctx);
+    if (world_rank != 0) {
+        free(items);
+    }
+    return 0;
+}
+
+/*
+ * Print how large K may be for an exact quantized multiply.
+ */
+void matrix_program_quantized_report(const struct matrix_type *type,
+                                     const struct matrix_dist *dist_A,
+                                     const void *local_A,
+                                     const struct matrix_dist *dist_B,
+                                     const void *local_B, int K, MPI_Comm comm)
+{
+    double max_a, max_b;
+    long long exact;
+    int rank;
+
+    if (type->acc == type) {
+        return;
+    }
+    MPI_Comm_rank(comm, &rank);
+    max_a = matrix_dist_max_abs(dist_A, type, local_A, comm);
+    max_b = matrix_dist_max_abs(dist_B, type, local_B, comm);
+    exact = matrix_type_exact_k(type, max_a, max_b);
+    if (rank != 0) {
+        return;
+    }
+    if (exact < 0) {
+        printf("Accumulating in %s: exact for any K.\n", type->acc->name);
+        return;
+    }
+    printf("Accumulating in %s: exact for K up to %lld with |A| <= %g and "
+           "|B| <= %g.\n", type->acc->name, exact, max_a, max_b);
+    if (K > exact) {
+        fprintf(stderr, "K = %d exceeds %lld; C may wrap around\n", K, exact);
+    }
+}
+
+/*
+ * Check C = A B with Freivalds' algorithm.
+ */
+int matrix_program_verify(const struct matrix_options *opts,
+                          const struct matrix_type *type,
+                          const struct matrix_dist *dist_A, const void *local_A,
+                          const struct matrix_sparse *sparse_A,
+                          const struct matrix_dist *dist_B, const void *local_B,
+                          const struct matrix_sparse *sparse_B,
+                          const struct matrix_dist *dist_C, const void *local_C,
+                          MPI_Comm comm)
+{
+    const uint64_t seed = (uint64_t)time(NULL);
+    const int exact = type->acc->id == MATRIX_int || type->acc->id == MATRIX_int64;
+    double start = MPI_Wtime(), error;
+    int failed, rank;
+
+    MPI_Comm_rank(comm, &rank);
+    if (sparse_A != NULL) {
+        failed = matrix_verify_sparse(type, dist_A, sparse_A, dist_B, sparse_B,
+                                      dist_C, local_C, opts->verify, seed,
+                                      comm, &error);
+    } else {
+        failed = matrix_verify(type, dist_A, local_A, dist_B, local_B, dist_C,
+                               local_C, opts->verify, seed, comm, &error);
+    }
+    if (rank != 0) {
+        return failed > 0;
+    }
+    if (failed > 0) {
+        fprintf(stderr, "C differs from AB in %d of %d Freivalds trials "
+                        "(%s %g)\n", failed, opts->verify,
+                exact ? "elements differing" : "relative difference", error);
+    } else if (exact) {
+        printf("Verified C = AB with %d Freivalds trials in %.6f seconds.\n",
+               opts->verify, MPI_Wtime() - start);
+    } else {
+        printf("Verified C = AB with %d Freivalds trials in %.6f seconds "
+               "(relative difference %.3g).\n", opts->verify,
+               MPI_Wtime() - start, error);
+    }
+    return failed > 0;
+}
+
+/*
+ * Describe the tuned grid, block size, panel width and threads of t.
+ */
+static void describe(const struct matrix_tuning *t, char *text, size_t size)
+{
+    if (t->algorithm == MATRIX_SUMMA) {
+        snprintf(text, size, "a %dx%d grid, %dx%d blocks, panels of %d and %d "
+                 "threads", t->prows, t->pcols, t->block, t->block, t->panel,
+                 t->threads);
+    } else {
+        snprintf(text, size, "a %dx%d grid, %dx%d blocks and %d threads",
+                 t->prows, t->pcols, t->block, t->block, t->threads);
+    }
+}
+
+/*
+ * Fill in the options left to default from a tuning profile.
+ */
+void matrix_program_tune(struct matrix_options *opts,
+                         enum matrix_algorithm algorithm,
+                         const struct matrix_type *type, int M, int K, int N)
+{
+    struct matrix_machine machine;
+    struct matrix_tuning tuned[2];
+    const struct matrix_tuning *mine = &tuned[algorithm];
+    const struct matrix_tuning *other = &tuned[algorithm == MATRIX_CANNON
+                                               ? MATRIX_SUMMA : MATRIX_CANNON];
+    char text[128];
+    double start;
+    int rank, procs, i, missing = 0;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
+    for (i = 0; i < 2; ++i) {
+        memset(&tuned[i], '\0', sizeof(tuned[i]));
+        tuned[i].algorithm = i == 0 ? MATRIX_CANNON : MATRIX_SUMMA;
+        tuned[i].type = type;
+        tuned[i].procs = procs;
+        tuned[i].M = M;
+        tuned[i].K = K;
+        tuned[i].N = N;
+        missing |= matrix_tune_load(opts->profile, &tuned[i], MPI_COMM_WORLD);
+    }
+
+    if (missing) {
+        start = MPI_Wtime();
+        matrix_tune_measure(MPI_COMM_WORLD, type, opts->threads, &machine);
+        matrix_tune(MPI_COMM_WORLD, &machine, type, M, K, N,
+                    MATRIX_TUNE_TRIALS, tuned);
+        if (rank == 0) {
+            printf("Measured %.3f GFLOP/s per process with %d threads, "
+                   "messages of %.3f us and %.3f GB/s, broadcasts of %.3f us "
+                   "and %.3f GB/s.\n",
+                   machine.gflops[machine.nthreads-1][MATRIX_TUNE_DEPTHS-1],
+                   machine.threads[machine.nthreads-1], machine.latency * 1e6,
+                   machine.bandwidth * 1e-9, machine.bcast_latency * 1e6,
+                   machine.bcast_bandwidth * 1e-9);
+            printf("Tuned the multiply in %.6f seconds.\n", MPI_Wtime() - start);
+            if (matrix_tune_save(opts->profile, tuned, 2) != 0) {
+                fprintf(stderr, "%s (%s)\n", strerror(errno), opts->profile);
+            }
+        }
+    }
+
+    if (opts->prows == 0 && opts->pcols == 0) {
+        opts->prows = mine->prows;
+        opts->pcols = mine->pcols;
+    }
+    if (opts->block == 0) {
+        opts->block = mine->block;
+    }
+    if (opts->panel == 0 && algorithm == MATRIX_SUMMA) {
+        opts->panel = mine->panel;
+    }
+    if (opts->threads == 0) {
+        opts->threads = mine->threads;
+    }
+    if (rank == 0) {
+        describe(mine, text, sizeof(text));
+        printf("Tuned for %s: %.6f seconds.\n", text, mine->seconds);
+        if (procs > 1 && other->seconds < mine->seconds) {
+            describe(other, text, sizeof(text));
+            printf("Tuned %s is faster: %.6f seconds with %s.\n",
+                   other->algorithm == MATRIX_CANNON ? "cannon" : "summa",
+                   other->seconds, text);
+        }
+    }
+}
+
+/*
+ * Start a run of a program.
+ */
+int matrix_program_start(const struct matrix_program *program, int *argc,
+                         char ***argv, struct matrix_program_run *run)
+{
+    const unsigned features = program->features;
+    struct matrix_options *opts = &run->opts;
+    int dims[3] = { 0, 0, 0 };
+    int provided;
+
+    memset(run, '\0', sizeof(*run));
+    run->program = program;
+
+    // Only the main thread makes MPI calls; other threads just compute
+    MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &run->rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &run->procs);
+    if (run->rank == 0) {
+        matrix_program_initialize(program, *argc, *argv, opts, &dims[0],
+            &dims[1], &dims[2], &run->A, &run->B, &run->C,
+            features & MATRIX_PROGRAM_SPARSE ? &run->coo_A : NULL,
+            features & MATRIX_PROGRAM_SPARSE ? &run->coo_B : NULL,
+            features & MATRIX_PROGRAM_BATCH ? &run->items : NULL,
+            features & MATRIX_PROGRAM_BATCH ? &run->count : NULL);
+    }
+
+    // Each process picks the micro-kernel its own CPU supports
+    MPI_Bcast(opts, sizeof(*opts), MPI_BYTE, 0, MPI_COMM_WORLD);
+    run->type = matrix_type_find(opts->dtype);
+    if (matrix_program_kernel(run->rank, opts) != 0) {
+        run->status = 2;
+        return 1;
+    }
+    matrix_arena_set_pages(opts->pages);
+
+    // Broadcast M, K and N, the matrix dimensions, to all processes
+    MPI_Bcast(dims, 3, MPI_INT, 0, MPI_COMM_WORLD);
+    run->M = dims[0];
+    run->K = dims[1];
+    run->N = dims[2];
+
+    // Threads share each local multiply if MPI tolerates them
+    if (provided < MPI_THREAD_FUNNELED && opts->threads != 1) {
+        if (run->rank == 0 && opts->threads > 1) {
+            fprintf(stderr, "MPI does not support threads; using 1 thread per process\n");
+        }
+        opts->threads = 1;
+    }
+
+    // A profile fills in the grid, block size, panel width and threads left
+    // to default
+    if (opts->profile[0] != '\0') {
+        matrix_program_tune(opts, program->algorithm, run->type, run->M,
+                            run->K, run->N);
+    }
+    run->threads = matrix_threads_init(opts->threads, opts->pin);
+    if (run->rank == 0 && opts->threads > 1) {
+        printf("Using %d threads per process%s.\n", run->threads,
+               opts->pin ? " pinned to cores" : "");
+    }
+    if (run->rank == 0 && run->type->id != MATRIX_int) {
+        printf("Using %s elements.\n", opts->dtype);
+    }
+
+    // Rank 0 only gathers and prints the matrices if C goes nowhere else
+    run->print = !opts->quiet && opts->output[0] == '\0';
+
+    // A batch reuses one context for all of its products
+    if (opts->batch[0] != '\0') {
+        run->status = matrix_program_batch(opts, program->algorithm,
+                                           run->type, run->M, run->K, run->N,
+                                           run->items, run->count);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Print the phase times of a multiply and its rate.
+ */
+static void phase_report(const struct matrix_program_run *run,
+                         const struct matrix_program_times *t)
+{
+    const enum matrix_algorithm algorithm = run->program->algorithm;
+    double seconds = t->loop;
+
+    if (algorithm == MATRIX_CANNON) {
+        printf("Phase times: load %.6f, skew %.6f, loop %.6f, store %.6f seconds.\n",
+               t->load, t->skew, t->loop, t->store);
+    } else if (algorithm == MATRIX_SUMMA) {
+        printf("Phase times: load %.6f, loop %.6f, store %.6f seconds.\n",
+               t->load, t->loop, t->store);
+    } else {
+        printf("Phase times: load %.6f, replicate %.6f, skew %.6f, loop %.6f, "
+               "reduce %.6f, store %.6f seconds.\n", t->load, t->replicate,
+               t->skew, t->loop, t->reduce, t->store);
+
+        // The copies and the sum of the layers are part of the multiply
+        seconds += t->replicate + t->skew + t->reduce;
+    }
+    printf("Performance: %.3f GFLOP/s.\n",
+           run->type->flops * (double)run->M * run->K * run->N / seconds * 1e-9);
+}
+
+/*
+ * Multiply on 1 process.
+ */
+void matrix_program_sequential(struct matrix_program_run *run)
+{
+    const struct matrix_options *opts = &run->opts;
+    const struct matrix_type *type = run->type;
+    const int M = run->M, K = run->K, N = run->N;
+    struct matrix_program_times times;
+    struct matrix_arena blocks;
+    struct matrix_dist dist_A, dist_B, dist_C;
+    void *local_A, *local_B, *local_C;
+    double start;
+    int rc;
+
+    memset(&times, '\0', sizeof(times));
+    memset(&blocks, '\0', sizeof(blocks));
+    printf("Using sequential multiplication on 1 process.\n");
+
+    // The whole matrices are the local blocks, reserved at once
+    start = MPI_Wtime();
+    times.faults = matrix_arena_faults();
+    rc = matrix_arena_map(&blocks, (opts->binary || opts->generate
+        ? matrix_arena_bytes((size_t)M * K * type->size)
+        + matrix_arena_bytes((size_t)K * N * type->size) : 0)
+        + (run->C == NULL ? matrix_arena_bytes((size_t)M * N * type->acc->size) : 0));
+    assert(rc == 0);
+    matrix_dist_init(&dist_A, M, K, M, 1, 1, 0, 0);
+    matrix_dist_init(&dist_B, K, N, K, 1, 1, 0, 0);
+    if (opts->binary || opts->generate) {
+        local_A = matrix_arena_zeros(&blocks, M, K, type->size);
+        local_B = matrix_arena_zeros(&blocks, K, N, type->size);
+        assert(local_A != NULL && local_B != NULL);
+        matrix_program_load(opts, type, &dist_A, local_A, &dist_B, local_B,
+                            NULL, NULL, MPI_COMM_WORLD);
+    } else {
+        local_A = run->A;
+        local_B = run->B;
+        if (run->print) {
+            matrix_program_print("Matrix A", type, M, K, run->A);
+            matrix_program_print("Matrix B", type, K, N, run->B);
+        }
+    }
+    local_C = run->C != NULL ? run->C
+            : matrix_arena_zeros(&blocks, M, N, type->acc->size);
+    assert(local_C != NULL);
+    matrix_program_quantized_report(type, &dist_A, local_A, &dist_B, local_B,
+                                    K, MPI_COMM_WORLD);
+    times.load = MPI_Wtime() - start;
+
+    start = MPI_Wtime();
+    matrix_gemm(type, M, N, K, local_A, K, local_B, N, local_C, N);
+    times.loop = times.compute = MPI_Wtime() - start;
+    times.faults = matrix_arena_faults() - times.faults;
+
+    // Check C before it is stored
+    matrix_dist_init(&dist_C, M, N, M, 1, 1, 0, 0);
+    if (opts->verify > 0) {
+        run->status = matrix_program_verify(opts, type, &dist_A, local_A, NULL,
+                                            &dist_B, local_B, NULL, &dist_C,
+                                            local_C, MPI_COMM_WORLD);
+    }
+    start = MPI_Wtime();
+    matrix_program_save(opts, type->acc, &dist_C, K, local_C, MPI_COMM_WORLD);
+    times.store = MPI_Wtime() - start;
+
+    if (run->print) {
+        matrix_program_print("Matrix C", type->acc, M, N, local_C);
+    }
+    printf("Local multiply time: %.6f seconds with %d threads.\n",
+           times.compute, run->threads);
+    phase_report(run, &times);
+    printf("Page faults: %ld with blocks on %s pages.\n", times.faults,
+           matrix_arena_pages(&blocks));
+    matrix_arena_free(&blocks);
+}
+
+/*
+ * Multiply with a context on all processes.
+ */
+void matrix_program_parallel(struct matrix_program_run *run,
+                             const struct matrix_config *config)
+{
+    const struct matrix_options *opts = &run->opts;
+    const struct matrix_type *type = run->type;
+    const int M = run->M, K = run->K, N = run->N;
+    struct matrix_program_times times;
+    struct matrix_context_stats stats;
+    struct matrix_context *ctx;
+    struct matrix_arena blocks;
+    struct matrix_dist dist_A, dist_B, dist_C;
+    void *local_A, *local_B, *local_C = NULL;
+    void *sparse_A = NULL, *sparse_B = NULL;
+    double start, phases[7], max_phases[7];
+    long faults;
+    int layer, rc;
+    MPI_Comm comm;
+
+    memset(&times, '\0', sizeof(times));
+    memset(&blocks, '\0', sizeof(blocks));
+
+    // The context sets up the process grid or its layers, the
+    // distributions of A, B and C and the buffers of the transfers
+    faults = matrix_arena_faults();
+    if (matrix_context_create(MPI_COMM_WORLD, config, &ctx) != MPI_SUCCESS) {
+        if (run->rank == 0 && config->algorithm == MATRIX_25D) {
+            fprintf(stderr, "Number of processes (%d) is not c * q * q with "
+                            "c = %d dividing q\n", run->procs, config->replicas);
+        } else if (run->rank == 0) {
+            fprintf(stderr, "Number of processes (%d) does not fit a %dx%d grid\n",
+                    run->procs, opts->prows, opts->pcols);
+        }
+        run->status = 2;
+        return;
+    }
+    comm = matrix_context_comm(ctx);
+    layer = matrix_context_layer(ctx);
+    dist_A = *matrix_context_dist(ctx, 0);
+    dist_B = *matrix_context_dist(ctx, 1);
+    dist_C = *matrix_context_dist(ctx, 2);
+
+    // Only layer 0 holds A, B and C. Sparse blocks size themselves, and the
+    // shared and rma modes load A and B straight into their windows
+    local_A = matrix_context_window(ctx, 0);
+    local_B = matrix_context_window(ctx, 1);
+    if (layer == 0) {
+        rc = matrix_arena_map(&blocks, (opts->sparse || local_A != NULL ? 0
+            : matrix_arena_bytes((size_t)dist_A.local_rows * dist_A.local_cols * type->size)
+            + matrix_arena_bytes((size_t)dist_B.local_rows * dist_B.local_cols * type->size))
+            + matrix_arena_bytes((size_t)dist_C.local_rows * dist_C.local_cols * type->acc->size));
+        assert(rc == 0);
+        if (!opts->sparse && local_A == NULL) {
+            local_A = matrix_arena_zeros(&blocks, dist_A.local_rows,
+                                         dist_A.local_cols, type->size);
+            local_B = matrix_arena_zeros(&blocks, dist_B.local_rows,
+                                         dist_B.local_cols, type->size);
+            assert(local_A != NULL && local_B != NULL);
+        }
+        local_C = matrix_arena_zeros(&blocks, dist_C.local_rows,
+                                     dist_C.local_cols, type->acc->size);
+        assert(local_C != NULL);
+
+        // Each process reads the blocks it owns from a binary file or
+        // generates them, otherwise rank 0 scatters them
+        start = MPI_Wtime();
+        matrix_trace_begin("load");
+        if (opts->sparse) {
+            matrix_program_load_sparse(opts, type, &dist_A, &sparse_A, &dist_B,
+                                       &sparse_B, &run->coo_A, &run->coo_B,
+                                       comm);
+            matrix_coo_free(&run->coo_A);
+            matrix_coo_free(&run->coo_B);
+        } else {
+            matrix_program_load(opts, type, &dist_A, local_A, &dist_B, local_B,
+                                run->A, run->B, comm);
+        }
+        matrix_trace_end();
+        times.load = MPI_Wtime() - start;
+        matrix_program_quantized_report(type, &dist_A, local_A, &dist_B,
+                                        local_B, K, comm);
+    }
+
+    if (run->rank == 0) {
+        run->program->describe(run, ctx);
+        if (!opts->binary && !opts->generate && !opts->sparse && run->print) {
+            matrix_program_print("Matrix A", type, M, K, run->A);
+            matrix_program_print("Matrix B", type, K, N, run->B);
+        }
+    }
+
+    // Move the blocks or panels of A and B and accumulate their products
+    if (opts->sparse) {
+        matrix_program_sparse_report(sparse_A, sparse_B, M, K, N, comm);
+        matrix_context_multiply_sparse(ctx, sparse_A, sparse_B, local_C, &stats);
+    } else {
+        matrix_context_multiply(ctx, local_A, local_B, local_C, &stats);
+    }
+    times.replicate = stats.replicate_time;
+    times.skew = stats.skew_time;
+    times.loop = stats.loop_time;
+    times.reduce = stats.reduce_time;
+    times.compute = stats.compute_time;
+    faults = matrix_arena_faults() - faults;
+
+    // Layer 0 holds the whole of A, B and C to check
+    if (layer == 0 && opts->verify > 0) {
+        run->status = matrix_program_verify(opts, type, &dist_A, local_A,
+                                            sparse_A, &dist_B, local_B,
+                                            sparse_B, &dist_C, local_C, comm);
+    }
+
+    // Every process of layer 0 writes its blocks of C or adds them to the
+    // checksum; otherwise rank 0 gathers the final C matrix from all process
+    // local_C blocks
+    if (layer == 0) {
+        start = MPI_Wtime();
+        matrix_trace_begin("store");
+        matrix_program_save(opts, type->acc, &dist_C, K, local_C, comm);
+        if (run->print) {
+            matrix_dist_gather(&dist_C, type->acc->mpi, local_C, run->C, 0,
+                               comm);
+        }
+        matrix_trace_end();
+        times.store = MPI_Wtime() - start;
+    }
+
+    // The slowest process bounds each phase; the fastest and the mean loop
+    // show how much the others waited for it
+    phases[0] = times.load;
+    phases[1] = times.replicate;
+    phases[2] = times.skew;
+    phases[3] = times.loop;
+    phases[4] = times.reduce;
+    phases[5] = times.store;
+    phases[6] = times.compute;
+    MPI_Reduce(phases, max_phases, 7, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&times.loop, &times.min_loop, 1, MPI_DOUBLE, MPI_MIN, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(&times.loop, &times.mean_loop, 1, MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(&faults, &times.faults, 1, MPI_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+
+    if (run->rank == 0) {
+        times.load = max_phases[0];
+        times.replicate = max_phases[1];
+        times.skew = max_phases[2];
+        times.loop = max_phases[3];
+        times.reduce = max_phases[4];
+        times.store = max_phases[5];
+        times.compute = max_phases[6];
+        times.mean_loop /= run->procs;
+        if (run->print) {
+            matrix_program_print("Matrix C", type->acc, M, N, run->C);
+        }
+        printf("Local multiply time: %.6f seconds with %d threads per process.\n",
+               times.compute, run->threads);
+        run->program->report(run, &times);
+        phase_report(run, &times);
+        printf("Page faults: %ld over all processes with blocks on %s pages.\n",
+               times.faults, matrix_arena_pages(&blocks));
+    }
+
+    matrix_context_free(ctx);
+    matrix_arena_free(&blocks);
+    free(sparse_A);
+    free(sparse_B);
+}
+
+/*
+ * End a run.
+ */
+int matrix_program_finish(struct matrix_program_run *run)
+{
+    MPI_Finalize();
+    matrix_coo_free(&run->coo_A);
+    matrix_coo_free(&run->coo_B);
+    free(run->items);
+    free(run->A);
+    free(run->B);
+    free(run->C);
+    return run->status;
+}
+
+/*
+ * Print a matrix.
+ */
+void matrix_program_print(const char *desc, const struct matrix_type *type,
+                          int rows, int cols, const void *A)
+{
+    char text[64];
+    printf("---- %s ----\n", desc);
+    int i, j;
+    for (i = 0; i < rows; ++i) {
+        for (j = 0; j < cols; ++j) {
+            type->format(text, sizeof(text),
+                         (const char *)A + ((size_t)i*cols+j) * type->size);
+            printf("%s%c", text, (j == cols-1) ? '\n' : ' ');
+        }
+    }
+}
+
+/*
+ * Free a buffer.
+ */
+void matrix_program_free(void **A)
+{
+    free (*A);
+}
@@ -0,0 +1,328 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_PROGRAM_H
+#define LIBMATRIX_PROGRAM_H
+
+#include <stdint.h>
+#include <mpi.h>
+
+#include "libmatrix/batch.h"
+#include "libmatrix/context.h"
+#include "libmatrix/dist.h"
+#include "libmatrix/sparse.h"
+#include "libmatrix/types.h"
+
+/*
+ * Options of the command line shared by the multiply programs, parsed on
+ * rank 0 by matrix_program_initialize and broadcast to all processes as
+ * bytes. The fields of matrix_config that an algorithm does not take are
+ * left at their defaults; binary and sparse describe the input once it is
+ * read.
+ */
+struct matrix_options {
+    char matrix[256];
+    char batch[256];
+    char output[256];
+    char dtype[16];
+    int generate;
+    uint64_t seed;
+    int sparse;
+    double density;
+    int binary;
+    int text;
+    int quiet;
+    int verify;
+    char kernel[16];
+    int strassen;
+    int cutoff;
+    int threads;
+    int pin;
+    int block;
+    int prows, pcols;
+    int panel;
+    int overlap;
+    int replicas;
+    int shared;
+    int node_size;
+    int rma;
+    int slow;
+    int persistent;
+    int memory;
+    char pages[8];
+    char profile[256];
+};
+
+/*
+ * Optional groups of shared options a program takes: a process grid
+ * (--grid), sparse matrices (--density and sparse text files), batches
+ * (--batch) and tuning profiles (--profile).
+ */
+#define MATRIX_PROGRAM_GRID 0x1
+#define MATRIX_PROGRAM_SPARSE 0x2
+#define MATRIX_PROGRAM_BATCH 0x4
+#define MATRIX_PROGRAM_PROFILE 0x8
+
+/*
+ * An option of a program's own, as for getopt_long, with the lines of its
+ * help text.
+ */
+struct matrix_program_option {
+    const char *name;
+    int has_arg;
+    int val;
+    const char *usage;
+};
+
+struct matrix_program_run;
+struct matrix_program_times;
+
+/*
+ * A multiply program: its name, its algorithm, the groups of shared
+ * options it takes and its own options, ended by an entry with a NULL name.
+ * parse stores the argument arg of its option c in opts and returns nonzero
+ * if arg is invalid. check, if not NULL, returns nonzero after printing why
+ * once the input is known, for combinations of options the program rejects.
+ * On rank 0 of a parallel multiply, describe prints how ctx lays out the
+ * matrices once they are distributed, and report prints the program's own
+ * lines on the multiply times.
+ */
+struct matrix_program {
+    const char *name;
+    enum matrix_algorithm algorithm;
+    unsigned features;
+    const struct matrix_program_option *options;
+    int (*parse)(struct matrix_options *opts, int c, const char *arg);
+    int (*check)(const struct matrix_options *opts);
+    void (*describe)(const struct matrix_program_run *run,
+                     const struct matrix_context *ctx);
+    void (*report)(const struct matrix_program_run *run,
+                   const struct matrix_program_times *times);
+};
+
+/*
+ * A run of a program on this process: the options, element type and
+ * dimensions all processes share, the threads of the local multiply,
+ * whether rank 0 prints the matrices, and rank 0's input. status is the
+ * exit status of the run: 1 after a mismatch, 2 if the processes or their
+ * CPUs cannot run the options given.
+ */
+struct matrix_program_run {
+    const struct matrix_program *program;
+    struct matrix_options opts;
+    const struct matrix_type *type;
+    int M, K, N;
+    int rank, procs;
+    int threads;
+    int print;
+    void *A, *B, *C;
+    struct matrix_coo coo_A, coo_B;
+    struct matrix_batch_item *items;
+    int count;
+    int status;
+};
+
+/*
+ * The seconds of each phase of a multiply and of the local multiply on the
+ * slowest process, the fastest and the mean loop, and the page faults of
+ * all processes. The phases an algorithm does not have stay 0.
+ */
+struct matrix_program_times {
+    double load, replicate, skew, loop, reduce, store;
+    double compute;
+    double min_loop, mean_loop;
+    long faults;
+};
+
+/*
+ * Parse the command line of program on rank 0 and set up the input: the
+ * dimensions of a generated multiply or of the matrix file, the whole of A
+ * and B of a text file, the nonzeros of a sparse file, or the items of a
+ * batch. C receives a zeroed M x N matrix if it is to be printed. coo_A
+ * and coo_B may be NULL for a program without sparse matrices, and items
+ * and count for one without batches. Prints the usage and exits on invalid
+ * options or input.
+ */
+void matrix_program_initialize(const struct matrix_program *program,
+                               int argc, char *argv[],
+                               struct matrix_options *opts, int *M, int *K,
+                               int *N, void **A, void **B, void **C,
+                               struct matrix_coo *coo_A,
+                               struct matrix_coo *coo_B,
+                               struct matrix_batch_item **items, int *count);
+
+/*
+ * Select the local multiply and its micro-kernel on every process and
+ * report the choice. Returns nonzero on all processes if any process cannot
+ * use the requested micro-kernel. Collective over MPI_COMM_WORLD.
+ */
+int matrix_program_kernel(int rank, const struct matrix_options *opts);
+
+/*
+ * Fill in config for a multiply of algorithm with opts.
+ */
+void matrix_program_config(const struct matrix_options *opts,
+                           enum matrix_algorithm algorithm,
+                           const struct matrix_type *type, int M, int K, int N,
+                           struct matrix_config *config);
+
+/*
+ * Fill the local arrays of A and B on every process of comm: each process
+ * generates or reads the blocks it owns from a binary file with collective
+ * MPI-IO, and the matrices of a text file are scattered from rank 0. An I/O
+ * error aborts all processes.
+ */
+int matrix_program_load(const struct matrix_options *opts,
+                        const struct matrix_type *type,
+                        const struct matrix_dist *dist_A, void *local_A,
+                        const struct matrix_dist *dist_B, void *local_B,
+                        const void *A, const void *B, MPI_Comm comm);
+
+/*
+ * Write the distributed matrix C to the output file with collective MPI-IO
+ * and, in quiet mode, print its checksum. An I/O error aborts all
+ * processes.
+ */
+void matrix_program_save(const struct matrix_options *opts,
+                         const struct matrix_type *type,
+                         const struct matrix_dist *dist_C, int K,
+                         const void *local_C, MPI_Comm comm);
+
+/*
+ * Fill the sparse local blocks of A and B on every process of comm: each
+ * process generates the nonzeros it owns, or rank 0 scatters the nonzeros
+ * coo_A and coo_B of a sparse file.
+ */
+void matrix_program_load_sparse(const struct matrix_options *opts,
+                                const struct matrix_type *type,
+                                const struct matrix_dist *dist_A,
+                                void **local_A,
+                                const struct matrix_dist *dist_B,
+                                void **local_B, const struct matrix_coo *coo_A,
+                                const struct matrix_coo *coo_B, MPI_Comm comm);
+
+/*
+ * Print the share of stored elements of the sparse M x K matrix A and
+ * K x N matrix B, and how many of their local blocks fell back to dense
+ * storage. Collective over comm.
+ */
+void matrix_program_sparse_report(const struct matrix_sparse *A,
+                                  const struct matrix_sparse *B, int M, int K,
+                                  int N, MPI_Comm comm);
+
+/*
+ * Multiply every product of a batch with one context of algorithm: the
+ * process grid, buffers and file views are set up once, and each product
+ * loads while the one before it is multiplied. Rank 0 prints every product,
+ * unless quiet, and the throughput of the batch. items and count are only
+ * valid on rank 0 of MPI_COMM_WORLD. Collective over MPI_COMM_WORLD.
+ * Returns the exit status 2 if the processes do not fit the grid of opts,
+ * otherwise 0.
+ */
+int matrix_program_batch(const struct matrix_options *opts,
+                         enum matrix_algorithm algorithm,
+                         const struct matrix_type *type, int M, int K, int N,
+                         struct matrix_batch_item *items, int count);
+
+/*
+ * Print the largest K for which the int C of a quantized multiply is exact,
+ * from the largest magnitudes in A and B, and warn if K exceeds it. Does
+ * nothing for other types. Collective over comm.
+ */
+void matrix_program_quantized_report(const struct matrix_type *type,
+                                     const struct matrix_dist *dist_A,
+                                     const void *local_A,
+                                     const struct matrix_dist *dist_B,
+                                     const void *local_B, int K, MPI_Comm comm);
+
+/*
+ * Check C = A B with opts->verify trials of Freivalds' algorithm and print
+ * the outcome, with fresh random vectors every run. sparse_A and sparse_B
+ * hold the local blocks of sparse A and B, or are NULL for dense local_A
+ * and local_B. Collective over comm. Returns nonzero on a mismatch.
+ */
+int matrix_program_verify(const struct matrix_options *opts,
+                          const struct matrix_type *type,
+                          const struct matrix_dist *dist_A, const void *local_A,
+                          const struct matrix_sparse *sparse_A,
+                          const struct matrix_dist *dist_B, const void *local_B,
+                          const struct matrix_sparse *sparse_B,
+                          const struct matrix_dist *dist_C, const void *local_C,
+                          MPI_Comm comm);
+
+/*
+ * Fill in the grid, block size, panel width and threads that opts leaves
+ * to default from the line of algorithm for this multiply in the profile
+ * opts->profile. If the profile has no lines for it, measure the machine,
+ * tune Cannon's algorithm and SUMMA and add their lines. Reports how the
+ * other algorithm compares. Collective over MPI_COMM_WORLD.
+ */
+void matrix_program_tune(struct matrix_options *opts,
+                         enum matrix_algorithm algorithm,
+                         const struct matrix_type *type, int M, int K, int N);
+
+/*
+ * Start a run of program: initialize MPI with threads funneled to the main
+ * one, parse the command line on rank 0 and share the options and
+ * dimensions, select the micro-kernel, apply a profile and start the
+ * threads. A batch is multiplied at once. Returns nonzero if the run is
+ * over, after a batch or if a process cannot use the micro-kernel.
+ * matrix_program_finish ends every run. Collective over MPI_COMM_WORLD.
+ */
+int matrix_program_start(const struct matrix_program *program, int *argc,
+                         char ***argv, struct matrix_program_run *run);
+
+/*
+ * Multiply on 1 process without a context, for reference to the parallel
+ * algorithm: load A and B, multiply them with the local multiply, check,
+ * save or print C and report the times.
+ */
+void matrix_program_sequential(struct matrix_program_run *run);
+
+/*
+ * Multiply with a context of config on all processes: distribute A and B
+ * to the layer 0 grid, multiply, check, save or gather C and report the
+ * times of the slowest process. Sets the exit status 2 if the processes
+ * do not fit config. Collective over MPI_COMM_WORLD.
+ */
+void matrix_program_parallel(struct matrix_program_run *run,
+                             const struct matrix_config *config);
+
+/*
+ * Finalize MPI and free rank 0's input. Returns the exit status of the run.
+ */
+int matrix_program_finish(struct matrix_program_run *run);
+
+/*
+ * Print a rows x cols matrix under a heading.
+ */
+void matrix_program_print(const char *desc, const struct matrix_type *type,
+                          int rows, int cols, const void *A);
+
+/*
+ * Free the buffer *A, as a cleanup function.
+ */
+void matrix_program_free(void **A);
+
+#endif /* LIBMATRIX_PROGRAM_H */
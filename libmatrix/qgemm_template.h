@@ -0,0 +1,180 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+/*
+ * Quantized packing and blocking for matrix_gemm. gemm.c includes this file
+ * once per quantized type, with GEMM_TYPE set to the C type and GEMM_ID to
+ * its name in MATRIX_QTYPES; every function defined here is suffixed with
+ * the name. A and B are widened to int16 as they are packed, with pairs of
+ * consecutive k side by side for the quantized micro-kernels, and C is int.
+ */
+#define GEMM_CAT_(a, b) a##_##b
+#define GEMM_CAT(a, b) GEMM_CAT_(a, b)
+#define GEMM_FN(name) GEMM_CAT(name, GEMM_ID)
+
+/*
+ * Pack an mr x kc sliver of A, storing its kc columns as ceil(kc / 2) steps
+ * of mr_max pairs, zero padded at the bottom edge and after an odd last
+ * column.
+ */
+static void GEMM_FN(qpack_a)(int mr, int kc, const GEMM_TYPE *A, int lda,
+                             int mr_max, int16_t *a)
+{
+    int p, r;
+    for (p = 0; p < kc; p += 2) {
+        for (r = 0; r < mr; ++r) {
+            const GEMM_TYPE *x = &A[(size_t)r * lda + p];
+            *a++ = x[0];
+            *a++ = p + 1 < kc ? x[1] : 0;
+        }
+        for (; r < mr_max; ++r) {
+            *a++ = 0;
+            *a++ = 0;
+        }
+    }
+}
+
+/*
+ * Pack a kc x nr sliver of B, storing its kc rows as ceil(kc / 2) steps of
+ * nr_max pairs, each pair a column's values in two consecutive rows, zero
+ * padded at the right edge and after an odd last row.
+ */
+static void GEMM_FN(qpack_b)(int kc, int nr, const GEMM_TYPE *B, int ldb,
+                             int nr_max, int16_t *b)
+{
+    int p, c;
+    for (p = 0; p < kc; p += 2) {
+        const GEMM_TYPE *row = &B[(size_t)p * ldb];
+        if (p + 1 < kc) {
+            for (c = 0; c < nr; ++c) {
+                *b++ = row[c];
+                *b++ = row[ldb + c];
+            }
+        } else {
+            for (c = 0; c < nr; ++c) {
+                *b++ = row[c];
+                *b++ = 0;
+            }
+        }
+        for (; c < nr_max; ++c) {
+            *b++ = 0;
+            *b++ = 0;
+        }
+    }
+}
+
+/*
+ * Return the arena bytes of the packed block of A and panel of B of an
+ * M x K by K x N multiply, which bound those of any smaller multiply.
+ */
+static size_t GEMM_FN(qpack_bytes)(enum isa isa, int M, int N, int K)
+{
+    const size_t n = qkernel_index(isa);
+    const int mr = qkernels[n].mr;
+    const int nr = qkernels[n].nr;
+
+    return matrix_arena_bytes(sizeof(int16_t) * ROUND_UP(MIN(M, GEMM_MC), mr)
+                              * ROUND_UP(MIN(K, GEMM_KC), 2))
+         + matrix_arena_bytes(sizeof(int16_t) * ROUND_UP(MIN(N, GEMM_NC), nr)
+                              * ROUND_UP(MIN(K, GEMM_KC), 2));
+}
+
+/*
+ * Multiply A (M x K) by B (K x N) and accumulate in the int matrix C (M x N)
+ * with the blocking and threading of the packed multiply, the products of
+ * each pair of k added in int. The packing buffers come from the workspace
+ * arena.
+ */
+static void GEMM_FN(qgemm)(enum isa isa, struct matrix_arena *arena,
+                           int M, int N, int K,
+                           const GEMM_TYPE *A, int lda,
+                           const GEMM_TYPE *B, int ldb, int *C, int ldc)
+{
+    const int threads = matrix_threads();
+    const size_t n = qkernel_index(isa);
+    const size_t mark = matrix_arena_mark(arena);
+    const int mr = qkernels[n].mr;
+    const int nr = qkernels[n].nr;
+    qmicro_fn micro = qkernels[n].micro;
+    int16_t *a_pack, *b_pack;
+
+    a_pack = matrix_arena_alloc(arena, sizeof(*a_pack)
+                                * ROUND_UP(MIN(M, GEMM_MC), mr)
+                                * ROUND_UP(MIN(K, GEMM_KC), 2));
+    assert(a_pack != NULL);
+    b_pack = matrix_arena_alloc(arena, sizeof(*b_pack)
+                                * ROUND_UP(MIN(N, GEMM_NC), nr)
+                                * ROUND_UP(MIN(K, GEMM_KC), 2));
+    assert(b_pack != NULL);
+
+    OMP(omp parallel num_threads(threads) if(threads > 1))
+    {
+        int jc, pc, ic, s;
+        for (jc = 0; jc < N; jc += GEMM_NC) {
+            const int nc = MIN(GEMM_NC, N - jc);
+            const int nb = (nc + nr - 1) / nr;
+            for (pc = 0; pc < K; pc += GEMM_KC) {
+                const int kc = MIN(GEMM_KC, K - pc);
+                const int kc2 = (kc + 1) / 2;
+
+                OMP(omp for schedule(static))
+                for (s = 0; s < nb; ++s) {
+                    const int j = s * nr;
+                    GEMM_FN(qpack_b)(kc, MIN(nr, nc - j),
+                                     &B[(size_t)pc * ldb + jc + j], ldb, nr,
+                                     &b_pack[(size_t)j * 2 * kc2]);
+                }
+
+                for (ic = 0; ic < M; ic += GEMM_MC) {
+                    const int mc = MIN(GEMM_MC, M - ic);
+                    const int na = (mc + mr - 1) / mr;
+
+                    OMP(omp for schedule(static))
+                    for (s = 0; s < na; ++s) {
+                        const int i = s * mr;
+                        GEMM_FN(qpack_a)(MIN(mr, mc - i), kc,
+                                         &A[(size_t)(ic + i) * lda + pc], lda,
+                                         mr, &a_pack[(size_t)i * 2 * kc2]);
+                    }
+
+                    OMP(omp for schedule(static))
+                    for (s = 0; s < nb; ++s) {
+                        const int j = s * nr;
+                        qmacro_kernel(mr, nr, micro, mc, MIN(nr, nc - j), kc2,
+                                      a_pack, &b_pack[(size_t)j * 2 * kc2],
+                                      &C[(size_t)ic * ldc + jc + j], ldc);
+                    }
+                }
+            }
+        }
+    }
+
+    matrix_arena_release(arena, mark);
+}
+
+#undef GEMM_FN
+#undef GEMM_CAT
+#undef GEMM_CAT_
+#undef GEMM_TYPE
+#undef GEMM_ID
@@ -0,0 +1,501 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <complex.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/gemm.h"
+#include "libmatrix/sparse.h"
+#include "libmatrix/threads.h"
+#include "libmatrix/trace.h"
+
+#ifdef _OPENMP
+#define OMP(directive) _Pragma(#directive)
+#else
+#define OMP(directive)
+#endif
+
+size_t matrix_sparse_bytes(const struct matrix_type *type, int rows, int cols,
+                           int nnz, int dense)
+{
+    size_t bytes = sizeof(struct matrix_sparse) + (size_t)nnz * type->size;
+
+    (void)cols;
+    if (!dense) {
+        bytes += ((size_t)rows + 1 + nnz) * sizeof(int);
+    }
+    return bytes;
+}
+
+void *matrix_sparse_values(const struct matrix_sparse *s)
+{
+    return (char *)s + sizeof(*s);
+}
+
+int *matrix_sparse_row_ptr(const struct matrix_sparse *s,
+                           const struct matrix_type *type)
+{
+    return (int *)((char *)matrix_sparse_values(s) + (size_t)s->nnz * type->size);
+}
+
+int *matrix_sparse_col_idx(const struct matrix_sparse *s,
+                           const struct matrix_type *type)
+{
+    return matrix_sparse_row_ptr(s, type) + s->rows + 1;
+}
+
+struct matrix_sparse *matrix_sparse_reserve(void **buf, size_t *capacity,
+                                            size_t bytes)
+{
+    if (bytes > *capacity) {
+        *buf = realloc(*buf, bytes);
+        assert(*buf != NULL);
+        *capacity = bytes;
+    }
+    return *buf;
+}
+
+/*
+ * Allocate a block and fill in its header.
+ */
+static struct matrix_sparse *sparse_alloc(const struct matrix_type *type,
+                                          int rows, int cols, int nnz,
+                                          int dense, void **buf,
+                                          size_t *capacity)
+{
+    const size_t bytes = matrix_sparse_bytes(type, rows, cols, nnz, dense);
+    struct matrix_sparse *s;
+
+    if (buf != NULL) {
+        s = matrix_sparse_reserve(buf, capacity, bytes);
+    } else {
+        s = malloc(bytes);
+        assert(s != NULL);
+    }
+    memset(s, '\0', sizeof(*s));
+    s->rows = rows;
+    s->cols = cols;
+    s->nnz = nnz;
+    s->dense = dense;
+    s->bytes = bytes;
+    return s;
+}
+
+/*
+ * Add element x to y.
+ */
+static void add_element(const struct matrix_type *type, const void *x, void *y)
+{
+#define SPARSE_ADD(id, ctype, mpi)                                      \
+    case MATRIX_##id:                                                   \
+        *(ctype *)y += *(const ctype *)x;                               \
+        break;
+
+    switch (type->id) {
+        MATRIX_TYPES(SPARSE_ADD)
+        default:
+            assert(0);
+    }
+#undef SPARSE_ADD
+}
+
+/*
+ * Sort the elements into rows with a counting sort by column and then a
+ * stable one by row, which leaves the columns of every row sorted.
+ */
+struct matrix_sparse *matrix_sparse_from_coo(const struct matrix_type *type,
+                                             const struct matrix_coo *coo)
+{
+    const size_t elements = (size_t)coo->rows * coo->cols;
+    struct matrix_sparse *s;
+    char *values;
+    int *row_ptr, *col_idx, *count, *order, *by_col;
+    int e, i, n;
+
+    if (coo->nnz > MATRIX_SPARSE_DENSE * elements) {
+        s = sparse_alloc(type, coo->rows, coo->cols, (int)elements, 1, NULL, NULL);
+        values = matrix_sparse_values(s);
+        memset(values, '\0', elements * type->size);
+        for (e = 0; e < coo->nnz; ++e) {
+            add_element(type, (const char *)coo->values + (size_t)e * type->size,
+                        values + ((size_t)coo->row[e] * coo->cols + coo->col[e])
+                                 * type->size);
+        }
+        return s;
+    }
+
+    s = sparse_alloc(type, coo->rows, coo->cols, coo->nnz, 0, NULL, NULL);
+    values = matrix_sparse_values(s);
+    row_ptr = matrix_sparse_row_ptr(s, type);
+    col_idx = matrix_sparse_col_idx(s, type);
+    n = coo->rows > coo->cols ? coo->rows : coo->cols;
+    count = calloc((size_t)n + 1, sizeof(int));
+    order = malloc(((size_t)coo->nnz + 1) * sizeof(int));
+    by_col = malloc(((size_t)coo->nnz + 1) * sizeof(int));
+    assert(count != NULL && order != NULL && by_col != NULL);
+
+    for (e = 0; e < coo->nnz; ++e) {
+        ++count[coo->col[e] + 1];
+    }
+    for (i = 0; i < coo->cols; ++i) {
+        count[i+1] += count[i];
+    }
+    for (e = 0; e < coo->nnz; ++e) {
+        by_col[count[coo->col[e]]++] = e;
+    }
+
+    memset(row_ptr, '\0', ((size_t)coo->rows + 1) * sizeof(int));
+    for (e = 0; e < coo->nnz; ++e) {
+        ++row_ptr[coo->row[e] + 1];
+    }
+    for (i = 0; i < coo->rows; ++i) {
+        row_ptr[i+1] += row_ptr[i];
+    }
+    memcpy(count, row_ptr, (size_t)coo->rows * sizeof(int));
+    for (i = 0; i < coo->nnz; ++i) {
+        e = by_col[i];
+        order[count[coo->row[e]]++] = e;
+    }
+
+    for (i = 0; i < coo->nnz; ++i) {
+        e = order[i];
+        col_idx[i] = coo->col[e];
+        memcpy(values + (size_t)i * type->size,
+               (const char *)coo->values + (size_t)e * type->size, type->size);
+    }
+
+    free(count);
+    free(order);
+    free(by_col);
+    return s;
+}
+
+/*
+ * Return the first position in the sorted columns of a row that is not
+ * below col.
+ */
+static int lower_bound(const int *col_idx, int first, int last, int col)
+{
+    while (first < last) {
+        const int mid = first + (last - first) / 2;
+        if (col_idx[mid] < col) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    return first;
+}
+
+struct matrix_sparse *matrix_sparse_columns(const struct matrix_type *type,
+                                            const struct matrix_sparse *s,
+                                            int first, int count, void **buf,
+                                            size_t *capacity)
+{
+    const char *values = matrix_sparse_values(s);
+    struct matrix_sparse *p;
+    char *p_values;
+    int *row_ptr, *col_idx, *p_row_ptr, *p_col_idx;
+    int i, j, lo, hi, nnz = 0;
+
+    if (s->dense) {
+        p = sparse_alloc(type, s->rows, count, s->rows * count, 1, buf, capacity);
+        p_values = matrix_sparse_values(p);
+        for (i = 0; i < s->rows; ++i) {
+            memcpy(p_values + (size_t)i * count * type->size,
+                   values + ((size_t)i * s->cols + first) * type->size,
+                   (size_t)count * type->size);
+        }
+        return p;
+    }
+
+    row_ptr = matrix_sparse_row_ptr(s, type);
+    col_idx = matrix_sparse_col_idx(s, type);
+    for (i = 0; i < s->rows; ++i) {
+        lo = lower_bound(col_idx, row_ptr[i], row_ptr[i+1], first);
+        hi = lower_bound(col_idx, lo, row_ptr[i+1], first + count);
+        nnz += hi - lo;
+    }
+
+    p = sparse_alloc(type, s->rows, count, nnz, 0, buf, capacity);
+    p_values = matrix_sparse_values(p);
+    p_row_ptr = matrix_sparse_row_ptr(p, type);
+    p_col_idx = matrix_sparse_col_idx(p, type);
+    p_row_ptr[0] = 0;
+    for (i = 0; i < s->rows; ++i) {
+        const int start = p_row_ptr[i];
+        lo = lower_bound(col_idx, row_ptr[i], row_ptr[i+1], first);
+        hi = lower_bound(col_idx, lo, row_ptr[i+1], first + count);
+        memcpy(p_values + (size_t)start * type->size,
+               values + (size_t)lo * type->size, (size_t)(hi - lo) * type->size);
+        for (j = lo; j < hi; ++j) {
+            p_col_idx[start + j - lo] = col_idx[j] - first;
+        }
+        p_row_ptr[i+1] = start + hi - lo;
+    }
+    return p;
+}
+
+struct matrix_sparse *matrix_sparse_rows(const struct matrix_type *type,
+                                         const struct matrix_sparse *s,
+                                         int first, int count, void **buf,
+                                         size_t *capacity)
+{
+    const char *values = matrix_sparse_values(s);
+    struct matrix_sparse *p;
+    int *row_ptr, *p_row_ptr;
+    int i, lo, nnz;
+
+    if (s->dense) {
+        p = sparse_alloc(type, count, s->cols, count * s->cols, 1, buf, capacity);
+        memcpy(matrix_sparse_values(p),
+               values + (size_t)first * s->cols * type->size,
+               (size_t)count * s->cols * type->size);
+        return p;
+    }
+
+    // The rows are contiguous, only their offsets move
+    row_ptr = matrix_sparse_row_ptr(s, type);
+    lo = row_ptr[first];
+    nnz = row_ptr[first + count] - lo;
+    p = sparse_alloc(type, count, s->cols, nnz, 0, buf, capacity);
+    p_row_ptr = matrix_sparse_row_ptr(p, type);
+    memcpy(matrix_sparse_values(p), values + (size_t)lo * type->size,
+           (size_t)nnz * type->size);
+    for (i = 0; i <= count; ++i) {
+        p_row_ptr[i] = row_ptr[first + i] - lo;
+    }
+    memcpy(matrix_sparse_col_idx(p, type), matrix_sparse_col_idx(s, type) + lo,
+           (size_t)nnz * sizeof(int));
+    return p;
+}
+
+#define SPARSE_TYPE int
+#define SPARSE_ID int
+#include "libmatrix/sparse_template.h"
+
+#define SPARSE_TYPE int64_t
+#define SPARSE_ID int64
+#include "libmatrix/sparse_template.h"
+
+#define SPARSE_TYPE float
+#define SPARSE_ID float
+#include "libmatrix/sparse_template.h"
+
+#define SPARSE_TYPE double
+#define SPARSE_ID double
+#include "libmatrix/sparse_template.h"
+
+#define SPARSE_TYPE double complex
+#define SPARSE_ID cdouble
+#include "libmatrix/sparse_template.h"
+
+/*
+ * Dispatch to the multiply specialized for the element type, or to the
+ * blocked multiply if neither block is sparse.
+ */
+void matrix_sparse_gemm(const struct matrix_type *type,
+                        const struct matrix_sparse *A,
+                        const struct matrix_sparse *B, void *C, int ldc)
+{
+    if (A->rows == 0 || A->cols == 0 || B->cols == 0) {
+        return;
+    }
+    if (A->dense && B->dense) {
+        matrix_gemm(type, A->rows, B->cols, A->cols, matrix_sparse_values(A),
+                    A->cols, matrix_sparse_values(B), B->cols, C, ldc);
+        return;
+    }
+    matrix_trace_begin("matrix_sparse_gemm");
+
+#define SPARSE_DISPATCH(id, ctype, mpi)                                 \
+    case MATRIX_##id:                                                   \
+        gemm_##id(A, B, C, ldc);                                        \
+        break;
+
+    switch (type->id) {
+        MATRIX_TYPES(SPARSE_DISPATCH)
+        default:
+            assert(0);
+    }
+#undef SPARSE_DISPATCH
+    matrix_trace_end();
+}
+
+/*
+ * Bucket the elements by owner on root, scatter the counts and then the
+ * coordinates and values. Each process maps the global coordinates it
+ * receives to local ones.
+ */
+struct matrix_sparse *matrix_sparse_scatter(const struct matrix_dist *d,
+                                            const struct matrix_type *type,
+                                            const struct matrix_coo *global,
+                                            int root, MPI_Comm comm)
+{
+    struct matrix_coo local;
+    struct matrix_coo sorted;
+    struct matrix_sparse *s;
+    int *counts = NULL, *displs = NULL, *next = NULL;
+    int rank, procs, e, p, owner;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+    memset(&sorted, '\0', sizeof(sorted));
+
+    if (rank == root) {
+        counts = calloc(procs, sizeof(int));
+        displs = calloc(procs, sizeof(int));
+        next = calloc(procs, sizeof(int));
+        sorted.row = malloc(((size_t)global->nnz + 1) * sizeof(int));
+        sorted.col = malloc(((size_t)global->nnz + 1) * sizeof(int));
+        sorted.values = malloc(((size_t)global->nnz + 1) * type->size);
+        assert(counts != NULL && displs != NULL && next != NULL);
+        assert(sorted.row != NULL && sorted.col != NULL && sorted.values != NULL);
+
+#define OWNER(e) ((global->row[e] / d->nb % d->prows) * d->pcols + \
+                  global->col[e] / d->nb % d->pcols)
+        for (e = 0; e < global->nnz; ++e) {
+            ++counts[OWNER(e)];
+        }
+        for (p = 1; p < procs; ++p) {
+            displs[p] = displs[p-1] + counts[p-1];
+        }
+        memcpy(next, displs, procs * sizeof(int));
+        for (e = 0; e < global->nnz; ++e) {
+            owner = next[OWNER(e)]++;
+            sorted.row[owner] = global->row[e];
+            sorted.col[owner] = global->col[e];
+            memcpy((char *)sorted.values + (size_t)owner * type->size,
+                   (const char *)global->values + (size_t)e * type->size,
+                   type->size);
+        }
+#undef OWNER
+    }
+
+    local.rows = d->local_rows;
+    local.cols = d->local_cols;
+    MPI_Scatter(counts, 1, MPI_INT, &local.nnz, 1, MPI_INT, root, comm);
+    local.row = malloc(((size_t)local.nnz + 1) * sizeof(int));
+    local.col = malloc(((size_t)local.nnz + 1) * sizeof(int));
+    local.values = malloc(((size_t)local.nnz + 1) * type->size);
+    assert(local.row != NULL && local.col != NULL && local.values != NULL);
+    MPI_Scatterv(sorted.row, counts, displs, MPI_INT, local.row, local.nnz,
+                 MPI_INT, root, comm);
+    MPI_Scatterv(sorted.col, counts, displs, MPI_INT, local.col, local.nnz,
+                 MPI_INT, root, comm);
+    MPI_Scatterv(sorted.values, counts, displs, type->mpi, local.values,
+                 local.nnz, type->mpi, root, comm);
+
+    // Global block I holds local block I / prows of its owner
+    for (e = 0; e < local.nnz; ++e) {
+        local.row[e] = local.row[e] / (d->nb * d->prows) * d->nb + local.row[e] % d->nb;
+        local.col[e] = local.col[e] / (d->nb * d->pcols) * d->nb + local.col[e] % d->nb;
+    }
+    s = matrix_sparse_from_coo(type, &local);
+
+    matrix_coo_free(&local);
+    matrix_coo_free(&sorted);
+    free(counts);
+    free(displs);
+    free(next);
+    return s;
+}
+
+void matrix_sparse_count(const struct matrix_sparse *s, MPI_Comm comm,
+                         int64_t *nnz, int *dense)
+{
+    const int64_t local_nnz = s->nnz;
+
+    MPI_Allreduce(&local_nnz, nnz, 1, MPI_INT64_T, MPI_SUM, comm);
+    MPI_Allreduce(&s->dense, dense, 1, MPI_INT, MPI_SUM, comm);
+}
+
+/*
+ * Keep an element if a second hash of its position, scaled to [0, 1), is
+ * below density.
+ */
+struct matrix_sparse *matrix_sparse_generate(const struct matrix_dist *d,
+                                             const struct matrix_type *type,
+                                             uint64_t seed, double density)
+{
+    const double threshold = density * 18446744073709551616.0;
+    struct matrix_coo local;
+    struct matrix_sparse *s;
+    size_t capacity = 1024;
+    uint64_t index;
+    int i, j;
+
+    memset(&local, '\0', sizeof(local));
+    local.rows = d->local_rows;
+    local.cols = d->local_cols;
+    local.row = malloc(capacity * sizeof(int));
+    local.col = malloc(capacity * sizeof(int));
+    local.values = malloc(capacity * type->size);
+    assert(local.row != NULL && local.col != NULL && local.values != NULL);
+
+    for (i = 0; i < d->local_rows; ++i) {
+        const uint64_t row = matrix_indxl2g(i, d->nb, d->myrow, d->prows);
+        for (j = 0; j < d->local_cols; ++j) {
+            const uint64_t col = matrix_indxl2g(j, d->nb, d->mycol, d->pcols);
+            index = row * d->cols + col;
+            if (density < 1.0 &&
+                (double)matrix_dist_hash(~seed, index) >= threshold) {
+                continue;
+            }
+            if ((size_t)local.nnz == capacity) {
+                capacity *= 2;
+                local.row = realloc(local.row, capacity * sizeof(int));
+                local.col = realloc(local.col, capacity * sizeof(int));
+                local.values = realloc(local.values, capacity * type->size);
+                assert(local.row != NULL && local.col != NULL && local.values != NULL);
+            }
+            local.row[local.nnz] = i;
+            local.col[local.nnz] = j;
+            type->random(matrix_dist_hash(seed, index),
+                         (char *)local.values + (size_t)local.nnz * type->size);
+            ++local.nnz;
+        }
+    }
+    s = matrix_sparse_from_coo(type, &local);
+    matrix_coo_free(&local);
+    return s;
+}
+
+void matrix_coo_free(struct matrix_coo *coo)
+{
+    free(coo->row);
+    free(coo->col);
+    free(coo->values);
+    coo->row = coo->col = NULL;
+    coo->values = NULL;
+}
@@ -0,0 +1,152 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_SPARSE_H
+#define LIBMATRIX_SPARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mpi.h>
+
+#include "libmatrix/dist.h"
+#include "libmatrix/types.h"
+
+/*
+ * Blocks with a larger fraction of nonzero elements are stored dense: at
+ * that density CSR storage is no smaller and the sparse multiply no faster.
+ */
+#define MATRIX_SPARSE_DENSE 0.25
+
+/*
+ * A local block of a sparse matrix, kept in one contiguous buffer of bytes
+ * bytes so that it is sent as it is: this header, then nnz values and, in
+ * compressed sparse row (CSR) storage, rows + 1 row offsets and nnz column
+ * indices, sorted within each row. A dense block holds all rows x cols
+ * values row-major and nnz is rows * cols.
+ */
+struct matrix_sparse {
+    int rows, cols;
+    int nnz;
+    int dense;
+    uint64_t bytes;
+    uint64_t pad;   // keeps the values 16-byte aligned
+};
+
+/*
+ * Coordinate (COO) lists of the nnz stored elements of a rows x cols
+ * matrix: element e is values[e] at (row[e], col[e]), 0-based.
+ */
+struct matrix_coo {
+    int rows, cols;
+    int nnz;
+    int *row, *col;
+    void *values;
+};
+
+/*
+ * Return the bytes of a block of rows x cols elements holding nnz values.
+ */
+size_t matrix_sparse_bytes(const struct matrix_type *type, int rows, int cols,
+                           int nnz, int dense);
+
+/*
+ * Return the values, the CSR row offsets and the column indices of a block.
+ */
+void *matrix_sparse_values(const struct matrix_sparse *s);
+int *matrix_sparse_row_ptr(const struct matrix_sparse *s,
+                           const struct matrix_type *type);
+int *matrix_sparse_col_idx(const struct matrix_sparse *s,
+                           const struct matrix_type *type);
+
+/*
+ * Grow the buffer *buf of *capacity bytes to at least bytes, keeping its
+ * contents, and return it.
+ */
+struct matrix_sparse *matrix_sparse_reserve(void **buf, size_t *capacity,
+                                            size_t bytes);
+
+/*
+ * Build a block from COO lists in local coordinates, dense if it is denser
+ * than MATRIX_SPARSE_DENSE. Elements at the same position add up. Returns a
+ * block to free with free.
+ */
+struct matrix_sparse *matrix_sparse_from_coo(const struct matrix_type *type,
+                                             const struct matrix_coo *coo);
+
+/*
+ * Copy count columns (or rows) of block s starting at first into *buf, grown
+ * as needed, and return the copy, stored like s.
+ */
+struct matrix_sparse *matrix_sparse_columns(const struct matrix_type *type,
+                                            const struct matrix_sparse *s,
+                                            int first, int count, void **buf,
+                                            size_t *capacity);
+struct matrix_sparse *matrix_sparse_rows(const struct matrix_type *type,
+                                         const struct matrix_sparse *s,
+                                         int first, int count, void **buf,
+                                         size_t *capacity);
+
+/*
+ * Multiply the blocks A (M x K) and B (K x N) and accumulate the product in
+ * the dense row-major M x N matrix C with row stride ldc. Zeros of either
+ * block are skipped; two dense blocks go to matrix_gemm.
+ */
+void matrix_sparse_gemm(const struct matrix_type *type,
+                        const struct matrix_sparse *A,
+                        const struct matrix_sparse *B, void *C, int ldc);
+
+/*
+ * Distribute the global COO lists on root to local blocks on all processes
+ * of comm, a row-major prows x pcols cartesian communicator: every element
+ * travels to its owner, which builds its block. Only root reads global.
+ * Returns a block to free with free.
+ */
+struct matrix_sparse *matrix_sparse_scatter(const struct matrix_dist *d,
+                                            const struct matrix_type *type,
+                                            const struct matrix_coo *global,
+                                            int root, MPI_Comm comm);
+
+/*
+ * Sum the stored elements and the blocks stored dense of the local blocks s
+ * of all processes of comm into *nnz and *dense on every process.
+ */
+void matrix_sparse_count(const struct matrix_sparse *s, MPI_Comm comm,
+                         int64_t *nnz, int *dense);
+
+/*
+ * Generate the local block of a random sparse matrix: the matrix
+ * matrix_dist_generate fills from seed, with each element kept with
+ * probability density, also a function of seed and its global position
+ * only. Returns a block to free with free.
+ */
+struct matrix_sparse *matrix_sparse_generate(const struct matrix_dist *d,
+                                             const struct matrix_type *type,
+                                             uint64_t seed, double density);
+
+/*
+ * Free the lists of a COO matrix.
+ */
+void matrix_coo_free(struct matrix_coo *coo);
+
+#endif /* LIBMATRIX_SPARSE_H */
@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Type-specialized multiply of sparse blocks. sparse.c includes this file
+ * once per element type, with SPARSE_TYPE set to the C type and SPARSE_ID
+ * to its name in MATRIX_TYPES; every function defined here is suffixed with
+ * the name.
+ */
+#define SPARSE_CAT_(a, b) a##_##b
+#define SPARSE_CAT(a, b) SPARSE_CAT_(a, b)
+#define SPARSE_FN(name) SPARSE_CAT(name, SPARSE_ID)
+
+/*
+ * Row by row (Gustavson's) multiply: every nonzero a(i, k) of a row of A
+ * scales row k of B into row i of C. Rows of A, stored dense or CSR, are
+ * independent and shared among the threads; rows of B are walked dense or
+ * CSR alike.
+ */
+static void SPARSE_FN(gemm)(const struct matrix_sparse *A,
+                            const struct matrix_sparse *B,
+                            SPARSE_TYPE *C, int ldc)
+{
+    const int threads = matrix_threads();
+    const SPARSE_TYPE *a = matrix_sparse_values(A);
+    const SPARSE_TYPE *b = matrix_sparse_values(B);
+    const int *a_row = A->dense ? NULL : (const int *)(a + A->nnz);
+    const int *a_col = A->dense ? NULL : a_row + A->rows + 1;
+    const int *b_row = B->dense ? NULL : (const int *)(b + B->nnz);
+    const int *b_col = B->dense ? NULL : b_row + B->rows + 1;
+    int i;
+
+    OMP(omp parallel for schedule(dynamic, 16) num_threads(threads) if(threads > 1))
+    for (i = 0; i < A->rows; ++i) {
+        SPARSE_TYPE *c = &C[(size_t)i * ldc];
+        const int first = A->dense ? 0 : a_row[i];
+        const int last = A->dense ? A->cols : a_row[i+1];
+        int p, q, k;
+
+        for (p = first; p < last; ++p) {
+            const SPARSE_TYPE v = A->dense ? a[(size_t)i * A->cols + p] : a[p];
+            k = A->dense ? p : a_col[p];
+            if (v == 0) {
+                continue;
+            }
+            if (B->dense) {
+                const SPARSE_TYPE *row = &b[(size_t)k * B->cols];
+                for (q = 0; q < B->cols; ++q) {
+                    c[q] += v * row[q];
+                }
+            } else {
+                for (q = b_row[k]; q < b_row[k+1]; ++q) {
+                    c[b_col[q]] += v * b[q];
+                }
+            }
+        }
+    }
+}
+
+#undef SPARSE_FN
+#undef SPARSE_CAT
+#undef SPARSE_CAT_
+#undef SPARSE_TYPE
+#undef SPARSE_ID
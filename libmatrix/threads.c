@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// Needed for the CPU affinity interface
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "libmatrix/threads.h"
+
+static int num_threads = 1;
+
+/*
+ * Bind each OpenMP thread to its own CPU of the process affinity mask. The
+ * OpenMP runtime keeps its threads alive between parallel regions of the
+ * same size, so the binding holds for every later local multiply.
+ */
+static void pin_threads(int threads)
+{
+#if defined(_OPENMP) && defined(HAVE_SCHED_H) && defined(HAVE_SCHED_SETAFFINITY)
+    cpu_set_t mask;
+    int cpus[CPU_SETSIZE];
+    int i, ncpus = 0;
+
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+        return;
+    }
+    for (i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &mask)) {
+            cpus[ncpus++] = i;
+        }
+    }
+    if (ncpus == 0) {
+        return;
+    }
+
+    #pragma omp parallel num_threads(threads)
+    {
+        cpu_set_t own;
+        CPU_ZERO(&own);
+        CPU_SET(cpus[omp_get_thread_num() % ncpus], &own);
+        sched_setaffinity(0, sizeof(own), &own);
+    }
+#else
+    (void)threads;
+#endif
+}
+
+/*
+ * Set the number of threads per local multiply and optionally pin them.
+ */
+int matrix_threads_init(int threads, int pin)
+{
+#ifdef _OPENMP
+    num_threads = threads > 1 ? threads : 1;
+    if (pin) {
+        pin_threads(num_threads);
+    }
+#else
+    (void)threads;
+    (void)pin;
+    num_threads = 1;
+#endif
+    return num_threads;
+}
+
+/*
+ * Return the number of threads per local multiply.
+ */
+int matrix_threads(void)
+{
+    return num_threads;
+}
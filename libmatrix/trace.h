@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_TRACE_H
+#define LIBMATRIX_TRACE_H
+
+/*
+ * Tracing of MPI calls and compute regions. The separate library
+ * libmatrix_trace wraps the MPI calls of the program it is linked into
+ * through the PMPI profiling interface; libmatrix itself wraps nothing, so
+ * linking it leaves a program's MPI calls and other PMPI tools alone.
+ * Tracing starts in MPI_Init (or MPI_Init_thread) if libmatrix_trace is
+ * linked and the environment variable MATRIX_TRACE names an output file;
+ * otherwise every wrapper just calls its PMPI function and the regions
+ * below cost a test.
+ *
+ * Each process records a timeline of its MPI calls, with the bytes each
+ * moved, and of its compute regions, and counts the bytes it sends to every
+ * other process point to point. MPI_Finalize merges the timelines of all
+ * processes into MATRIX_TRACE as Chrome trace JSON (chrome://tracing or
+ * ui.perfetto.dev, one row per rank) and rank 0 prints a summary table.
+ */
+
+/*
+ * What records the compute regions while tracing.
+ */
+struct matrix_tracer {
+    void (*begin)(const char *name);
+    void (*end)(void);
+};
+
+/*
+ * Record the compute regions with tracer from now on, or stop recording
+ * them if it is NULL. libmatrix_trace installs its tracer in MPI_Init.
+ */
+void matrix_trace_install(const struct matrix_tracer *tracer);
+
+/*
+ * Return nonzero if this process is tracing.
+ */
+int matrix_trace_enabled(void);
+
+/*
+ * Mark the beginning and end of a compute region. Regions nest; name must
+ * stay valid until MPI_Finalize, as string literals do.
+ */
+void matrix_trace_begin(const char *name);
+void matrix_trace_end(void);
+
+#endif /* LIBMATRIX_TRACE_H */
@@ -0,0 +1,844 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#if !defined(HAVE_MPI_BCAST_INIT) && defined(HAVE_MPIX_BCAST_INIT) && defined(HAVE_MPI_EXT_H)
+#include <mpi-ext.h>
+#endif
+
+#include "libmatrix/trace.h"
+
+#define TRACE_DEPTH 16
+#define TRACE_NAME 32
+
+/*
+ * A timed MPI call or compute region. peer is the world rank a point to
+ * point call sent bytes to, or -1.
+ */
+struct trace_event {
+    const char *name;
+    double begin, end;
+    long long bytes;
+    int peer;
+};
+
+/*
+ * Totals of one MPI call or compute region on one process.
+ */
+struct trace_stat {
+    char name[TRACE_NAME];
+    long long calls, bytes;
+    double time;
+};
+
+/*
+ * Totals of one MPI call or compute region over all processes.
+ */
+struct trace_total {
+    char name[TRACE_NAME];
+    long long calls, bytes;
+    double min, max, sum;
+    int procs;
+};
+
+/*
+ * A persistent request and what one start of it sends: its bytes, and the
+ * world rank of its receiver or -1.
+ */
+struct trace_request {
+    MPI_Request request;
+    long long bytes;
+    int peer;
+};
+
+/*
+ * Text that grows as it is printed to.
+ */
+struct trace_text {
+    char *data;
+    size_t length, capacity;
+};
+
+static struct {
+    int enabled;
+    int rank, size;
+    double epoch;
+    char file[1024];
+    struct trace_event *events;
+    size_t count, capacity;
+    long long *sent, *got;
+    struct trace_request *requests;
+    size_t nrequests, request_capacity;
+    const char *regions[TRACE_DEPTH];
+    double starts[TRACE_DEPTH];
+    int depth;
+} trace;
+
+/*
+ * Append an event that began at begin and ends now.
+ */
+static void trace_record(const char *name, double begin, long long bytes,
+                         int peer)
+{
+    struct trace_event *e;
+
+    if (trace.count == trace.capacity) {
+        trace.capacity = trace.capacity ? 2 * trace.capacity : 4096;
+        trace.events = realloc(trace.events,
+                               trace.capacity * sizeof(*trace.events));
+        assert(trace.events != NULL);
+    }
+    e = &trace.events[trace.count++];
+    e->name = name;
+    e->begin = begin;
+    e->end = PMPI_Wtime();
+    e->bytes = bytes;
+    e->peer = peer;
+    if (peer >= 0) {
+        trace.sent[peer] += bytes;
+    }
+}
+
+/*
+ * Bytes of count elements of type.
+ */
+static long long trace_bytes(int count, MPI_Datatype type)
+{
+    int size;
+
+    PMPI_Type_size(type, &size);
+    return (long long)count * size;
+}
+
+/*
+ * World rank of rank in group, or -1 for MPI_PROC_NULL and this process.
+ */
+static int trace_group_peer(MPI_Group group, int rank)
+{
+    MPI_Group world;
+    int peer;
+
+    if (rank == MPI_PROC_NULL) {
+        return -1;
+    }
+    PMPI_Comm_group(MPI_COMM_WORLD, &world);
+    PMPI_Group_translate_ranks(group, 1, &rank, world, &peer);
+    PMPI_Group_free(&world);
+    return (peer == trace.rank || peer == MPI_UNDEFINED) ? -1 : peer;
+}
+
+/*
+ * World rank of rank in comm, or -1 for MPI_PROC_NULL and this process.
+ */
+static int trace_peer(MPI_Comm comm, int rank)
+{
+    MPI_Group group;
+    int peer;
+
+    if (comm == MPI_COMM_WORLD) {
+        return (rank == MPI_PROC_NULL || rank == trace.rank) ? -1 : rank;
+    }
+    PMPI_Comm_group(comm, &group);
+    peer = trace_group_peer(group, rank);
+    PMPI_Group_free(&group);
+    return peer;
+}
+
+/*
+ * World rank of the process that exposes rank of win, or -1 for this one.
+ */
+static int trace_win_peer(MPI_Win win, int rank)
+{
+    MPI_Group group;
+    int peer;
+
+    PMPI_Win_get_group(win, &group);
+    peer = trace_group_peer(group, rank);
+    PMPI_Group_free(&group);
+    return peer;
+}
+
+/*
+ * Remember what every start of the persistent request sends.
+ */
+static void trace_persist(MPI_Request request, long long bytes, int peer)
+{
+    struct trace_request *r;
+
+    if (trace.nrequests == trace.request_capacity) {
+        trace.request_capacity = trace.request_capacity ?
+                                 2 * trace.request_capacity : 64;
+        trace.requests = realloc(trace.requests, trace.request_capacity *
+                                 sizeof(*trace.requests));
+        assert(trace.requests != NULL);
+    }
+    r = &trace.requests[trace.nrequests++];
+    r->request = request;
+    r->bytes = bytes;
+    r->peer = peer;
+}
+
+/*
+ * The persistent request, or NULL if it is not one.
+ */
+static struct trace_request *trace_find(MPI_Request request)
+{
+    size_t i;
+
+    for (i = 0; i < trace.nrequests; ++i) {
+        if (trace.requests[i].request == request) {
+            return &trace.requests[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Begin a compute region.
+ */
+static void trace_begin(const char *name)
+{
+    assert(trace.depth < TRACE_DEPTH);
+    trace.regions[trace.depth] = name;
+    trace.starts[trace.depth++] = PMPI_Wtime();
+}
+
+/*
+ * End the innermost compute region.
+ */
+static void trace_end(void)
+{
+    assert(trace.depth > 0);
+    --trace.depth;
+    trace_record(trace.regions[trace.depth], trace.starts[trace.depth], 0, -1);
+}
+
+static const struct matrix_tracer tracer = { trace_begin, trace_end };
+
+/*
+ * Start tracing if MATRIX_TRACE names an output file. The processes leave a
+ * barrier together, which aligns the origins of their clocks.
+ */
+static void trace_start(void)
+{
+    const char *file = getenv("MATRIX_TRACE");
+
+    if (file == NULL || *file == '\0') {
+        return;
+    }
+    strncpy(trace.file, file, sizeof(trace.file)-1);
+    PMPI_Comm_rank(MPI_COMM_WORLD, &trace.rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &trace.size);
+    trace.sent = calloc(trace.size, sizeof(*trace.sent));
+    trace.got = calloc(trace.size, sizeof(*trace.got));
+    assert(trace.sent != NULL && trace.got != NULL);
+    PMPI_Barrier(MPI_COMM_WORLD);
+    trace.epoch = PMPI_Wtime();
+    trace.enabled = 1;
+    matrix_trace_install(&tracer);
+}
+
+/*
+ * Print to text, growing it as needed.
+ */
+static void trace_printf(struct trace_text *text, const char *format, ...)
+{
+    va_list args;
+    int n;
+
+    while (1) {
+        va_start(args, format);
+        n = vsnprintf(text->data + text->length, text->capacity - text->length,
+                      format, args);
+        va_end(args);
+        assert(n >= 0);
+        if (text->length + n < text->capacity) {
+            text->length += n;
+            return;
+        }
+        text->capacity = text->capacity ? 2 * text->capacity : 65536;
+        while (text->capacity <= text->length + n) {
+            text->capacity *= 2;
+        }
+        text->data = realloc(text->data, text->capacity);
+        assert(text->data != NULL);
+    }
+}
+
+/*
+ * Write the timelines of all processes to the trace file, one JSON array
+ * of Chrome trace events. Every process formats its own events and writes
+ * them after those of the lower ranks with a collective write; each event
+ * but the first of rank 0 starts with the comma that separates it from the
+ * one before.
+ */
+static void trace_write_timeline(void)
+{
+    struct trace_text text = { NULL, 0, 0 };
+    const struct trace_event *e;
+    long long length, offset = 0;
+    MPI_File fh;
+    size_t i;
+
+    trace_printf(&text, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"args\":{\"name\":\"rank %d\"}}", trace.rank == 0 ? "[\n" : ",\n",
+                 trace.rank, trace.rank);
+    for (i = 0; i < trace.count; ++i) {
+        e = &trace.events[i];
+        trace_printf(&text, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                     "\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f",
+                     e->name, strncmp(e->name, "MPI_", 4) ? "compute" : "mpi",
+                     trace.rank, (e->begin - trace.epoch) * 1e6,
+                     (e->end - e->begin) * 1e6);
+        if (e->bytes > 0 || e->peer >= 0) {
+            trace_printf(&text, ",\"args\":{\"bytes\":%lld,\"peer\":%d}",
+                         e->bytes, e->peer);
+        }
+        trace_printf(&text, "}");
+    }
+    if (trace.rank == trace.size - 1) {
+        trace_printf(&text, "\n]\n");
+    }
+    assert(text.length <= INT_MAX);
+
+    length = text.length;
+    PMPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (trace.rank == 0) {
+        offset = 0;
+    }
+    if (PMPI_File_open(MPI_COMM_WORLD, trace.file,
+                       MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                       &fh) == MPI_SUCCESS) {
+        PMPI_File_set_size(fh, 0);
+        PMPI_File_write_at_all(fh, offset, text.data, (int)text.length,
+                               MPI_CHAR, MPI_STATUS_IGNORE);
+        PMPI_File_close(&fh);
+    } else if (trace.rank == 0) {
+        fprintf(stderr, "Cannot write the trace (%s)\n", trace.file);
+    }
+    free(text.data);
+}
+
+/*
+ * Order totals by their longest time on any process.
+ */
+static int trace_compare(const void *a, const void *b)
+{
+    const struct trace_total *x = a, *y = b;
+    return (x->max < y->max) - (x->max > y->max);
+}
+
+/*
+ * Reduce the totals of every MPI call and compute region and the bytes sent
+ * between every pair of processes to rank 0, and print them there. Bytes a
+ * process got from a window count as sent by the process that exposes it.
+ */
+static void trace_write_summary(void)
+{
+    struct trace_stat *stats = NULL, *all = NULL;
+    struct trace_total *totals = NULL;
+    long long *sent = NULL, *got = NULL;
+    int *counts = NULL, *displs = NULL;
+    int nstats = 0, ntotals = 0, nall = 0;
+    int i, j, r;
+    size_t e;
+
+    // Totals of this process
+    for (e = 0; e < trace.count; ++e) {
+        const struct trace_event *ev = &trace.events[e];
+        for (i = 0; i < nstats; ++i) {
+            if (strncmp(stats[i].name, ev->name, TRACE_NAME-1) == 0) {
+                break;
+            }
+        }
+        if (i == nstats) {
+            stats = realloc(stats, (nstats + 1) * sizeof(*stats));
+            assert(stats != NULL);
+            memset(&stats[i], '\0', sizeof(*stats));
+            strncpy(stats[i].name, ev->name, TRACE_NAME-1);
+            ++nstats;
+        }
+        stats[i].calls++;
+        stats[i].bytes += ev->bytes;
+        stats[i].time += ev->end - ev->begin;
+    }
+
+    // Collect them on rank 0
+    if (trace.rank == 0) {
+        counts = calloc(trace.size, sizeof(int));
+        displs = calloc(trace.size, sizeof(int));
+        sent = calloc((size_t)trace.size * trace.size, sizeof(long long));
+        got = calloc((size_t)trace.size * trace.size, sizeof(long long));
+        assert(counts != NULL && displs != NULL && sent != NULL && got != NULL);
+    }
+    i = nstats * (int)sizeof(*stats);
+    PMPI_Gather(&i, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (trace.rank == 0) {
+        for (r = 0; r < trace.size; ++r) {
+            displs[r] = nall * (int)sizeof(*stats);
+            nall += counts[r] / (int)sizeof(*stats);
+        }
+        all = calloc(nall + 1, sizeof(*all));
+        totals = calloc(nall + 1, sizeof(*totals));
+        assert(all != NULL && totals != NULL);
+    }
+    PMPI_Gatherv(stats, i, MPI_BYTE, all, counts, displs, MPI_BYTE, 0,
+                 MPI_COMM_WORLD);
+    PMPI_Gather(trace.sent, trace.size, MPI_LONG_LONG, sent, trace.size,
+                MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    PMPI_Gather(trace.got, trace.size, MPI_LONG_LONG, got, trace.size,
+                MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    if (trace.rank == 0) {
+        for (r = 0; r < trace.size; ++r) {
+            for (j = 0; j < trace.size; ++j) {
+                sent[(size_t)j * trace.size + r] +=
+                    got[(size_t)r * trace.size + j];
+            }
+        }
+        for (i = 0; i < nall; ++i) {
+            for (j = 0; j < ntotals; ++j) {
+                if (strcmp(totals[j].name, all[i].name) == 0) {
+                    break;
+                }
+            }
+            if (j == ntotals) {
+                strcpy(totals[j].name, all[i].name);
+                totals[j].min = all[i].time;
+                ++ntotals;
+            }
+            totals[j].calls += all[i].calls;
+            totals[j].bytes += all[i].bytes;
+            totals[j].sum += all[i].time;
+            if (all[i].time < totals[j].min) {
+                totals[j].min = all[i].time;
+            }
+            if (all[i].time > totals[j].max) {
+                totals[j].max = all[i].time;
+            }
+            totals[j].procs++;
+        }
+        qsort(totals, ntotals, sizeof(*totals), trace_compare);
+
+        // A process that never made a call spent no time in it
+        printf("Trace of %d processes written to %s.\n", trace.size, trace.file);
+        printf("%-24s %10s %12s %12s %12s %14s\n", "Call or region", "Calls",
+               "Min (s)", "Avg (s)", "Max (s)", "Bytes");
+        for (j = 0; j < ntotals; ++j) {
+            printf("%-24s %10lld %12.6f %12.6f %12.6f %14lld\n", totals[j].name,
+                   totals[j].calls,
+                   totals[j].procs < trace.size ? 0.0 : totals[j].min,
+                   totals[j].sum / trace.size, totals[j].max, totals[j].bytes);
+        }
+        printf("Bytes sent point to point (sender: receiver=bytes):\n");
+        for (r = 0; r < trace.size; ++r) {
+            printf("%6d:", r);
+            for (j = 0; j < trace.size; ++j) {
+                if (sent[(size_t)r * trace.size + j] > 0) {
+                    printf(" %d=%lld", j, sent[(size_t)r * trace.size + j]);
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    free(stats);
+    free(all);
+    free(totals);
+    free(sent);
+    free(got);
+    free(counts);
+    free(displs);
+}
+
+/*
+ * Wrap an MPI call: time it and record it if tracing, otherwise just call
+ * its PMPI function.
+ */
+#define TRACE_CALL(name, call, bytes, peer)                     \
+    {                                                           \
+        double begin_;                                          \
+        int rc_;                                                \
+                                                                \
+        if (!trace.enabled) {                                   \
+            return call;                                        \
+        }                                                       \
+        begin_ = PMPI_Wtime();                                  \
+        rc_ = call;                                             \
+        trace_record(name, begin_, bytes, peer);                \
+        return rc_;                                             \
+    }
+
+int MPI_Init(int *argc, char ***argv)
+{
+    int rc = PMPI_Init(argc, argv);
+    if (rc == MPI_SUCCESS) {
+        trace_start();
+    }
+    return rc;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
+{
+    int rc = PMPI_Init_thread(argc, argv, required, provided);
+    if (rc == MPI_SUCCESS) {
+        trace_start();
+    }
+    return rc;
+}
+
+int MPI_Finalize(void)
+{
+    if (trace.enabled) {
+        trace.enabled = 0;
+        matrix_trace_install(NULL);
+        trace_write_timeline();
+        trace_write_summary();
+        free(trace.events);
+        free(trace.sent);
+        free(trace.got);
+        free(trace.requests);
+    }
+    return PMPI_Finalize();
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
+                  MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+TRACE_CALL("MPI_Allreduce",
+           PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm),
+           trace_bytes(count, datatype), -1)
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count,
+               MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm)
+TRACE_CALL("MPI_Reduce",
+           PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm),
+           trace_bytes(count, datatype), -1)
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root,
+              MPI_Comm comm)
+TRACE_CALL("MPI_Bcast",
+           PMPI_Bcast(buffer, count, datatype, root, comm),
+           trace_bytes(count, datatype), -1)
+
+int MPI_Ibcast(void *buffer, int count, MPI_Datatype datatype, int root,
+               MPI_Comm comm, MPI_Request *request)
+TRACE_CALL("MPI_Ibcast",
+           PMPI_Ibcast(buffer, count, datatype, root, comm, request),
+           trace_bytes(count, datatype), -1)
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest,
+              int tag, MPI_Comm comm, MPI_Request *request)
+TRACE_CALL("MPI_Isend",
+           PMPI_Isend(buf, count, datatype, dest, tag, comm, request),
+           trace_bytes(count, datatype), trace_peer(comm, dest))
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source,
+              int tag, MPI_Comm comm, MPI_Request *request)
+TRACE_CALL("MPI_Irecv",
+           PMPI_Irecv(buf, count, datatype, source, tag, comm, request),
+           0, -1)
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 int dest, int sendtag, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status)
+TRACE_CALL("MPI_Sendrecv",
+           PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag,
+                         recvbuf, recvcount, recvtype, source, recvtag,
+                         comm, status),
+           trace_bytes(sendcount, sendtype), trace_peer(comm, dest))
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+TRACE_CALL("MPI_Wait", PMPI_Wait(request, status), 0, -1)
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[])
+TRACE_CALL("MPI_Waitall", PMPI_Waitall(count, requests, statuses), 0, -1)
+
+int MPI_Barrier(MPI_Comm comm)
+TRACE_CALL("MPI_Barrier", PMPI_Barrier(comm), 0, -1)
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info,
+                     MPI_Comm comm, void *baseptr, MPI_Win *win)
+TRACE_CALL("MPI_Win_allocate",
+           PMPI_Win_allocate(size, disp_unit, info, comm, baseptr, win),
+           0, -1)
+
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info,
+                            MPI_Comm comm, void *baseptr, MPI_Win *win)
+TRACE_CALL("MPI_Win_allocate_shared",
+           PMPI_Win_allocate_shared(size, disp_unit, info, comm, baseptr,
+                                    win),
+           0, -1)
+
+int MPI_Win_free(MPI_Win *win)
+TRACE_CALL("MPI_Win_free", PMPI_Win_free(win), 0, -1)
+
+int MPI_Win_lock_all(int mode, MPI_Win win)
+TRACE_CALL("MPI_Win_lock_all", PMPI_Win_lock_all(mode, win), 0, -1)
+
+int MPI_Win_unlock_all(MPI_Win win)
+TRACE_CALL("MPI_Win_unlock_all", PMPI_Win_unlock_all(win), 0, -1)
+
+int MPI_Win_sync(MPI_Win win)
+TRACE_CALL("MPI_Win_sync", PMPI_Win_sync(win), 0, -1)
+
+/*
+ * A persistent call sends nothing when it is set up; what it will send is
+ * remembered, and counted once for every start.
+ */
+int MPI_Send_init(const void *buf, int count, MPI_Datatype datatype, int dest,
+                  int tag, MPI_Comm comm, MPI_Request *request)
+{
+    double begin;
+    int rc;
+
+    if (!trace.enabled) {
+        return PMPI_Send_init(buf, count, datatype, dest, tag, comm, request);
+    }
+    begin = PMPI_Wtime();
+    rc = PMPI_Send_init(buf, count, datatype, dest, tag, comm, request);
+    trace_record("MPI_Send_init", begin, 0, -1);
+    if (rc == MPI_SUCCESS) {
+        trace_persist(*request, trace_bytes(count, datatype),
+                      trace_peer(comm, dest));
+    }
+    return rc;
+}
+
+int MPI_Recv_init(void *buf, int count, MPI_Datatype datatype, int source,
+                  int tag, MPI_Comm comm, MPI_Request *request)
+TRACE_CALL("MPI_Recv_init",
+           PMPI_Recv_init(buf, count, datatype, source, tag, comm, request),
+           0, -1)
+
+#if defined(HAVE_MPI_BCAST_INIT) || (defined(HAVE_MPIX_BCAST_INIT) && defined(HAVE_MPI_EXT_H))
+#if defined(HAVE_MPI_BCAST_INIT)
+#define TRACE_BCAST_INIT MPI_Bcast_init
+#define TRACE_PBCAST_INIT PMPI_Bcast_init
+#else
+#define TRACE_BCAST_INIT MPIX_Bcast_init
+#define TRACE_PBCAST_INIT PMPIX_Bcast_init
+#endif
+int TRACE_BCAST_INIT(void *buffer, int count, MPI_Datatype datatype, int root,
+                     MPI_Comm comm, MPI_Info info, MPI_Request *request)
+{
+    double begin;
+    int rc;
+
+    if (!trace.enabled) {
+        return TRACE_PBCAST_INIT(buffer, count, datatype, root, comm, info,
+                                 request);
+    }
+    begin = PMPI_Wtime();
+    rc = TRACE_PBCAST_INIT(buffer, count, datatype, root, comm, info, request);
+    trace_record("MPI_Bcast_init", begin, 0, -1);
+    if (rc == MPI_SUCCESS) {
+        trace_persist(*request, trace_bytes(count, datatype), -1);
+    }
+    return rc;
+}
+#endif
+
+/*
+ * Start persistent requests, counting the bytes each start sends.
+ */
+static int trace_start_requests(const char *name, int count,
+                                MPI_Request requests[])
+{
+    const struct trace_request *r;
+    long long total = 0;
+    double begin;
+    int i, rc;
+
+    begin = PMPI_Wtime();
+    rc = PMPI_Startall(count, requests);
+    trace_record(name, begin, 0, -1);
+    for (i = 0; i < count; ++i) {
+        r = trace_find(requests[i]);
+        if (r != NULL) {
+            if (r->peer >= 0) {
+                trace.sent[r->peer] += r->bytes;
+            }
+            total += r->bytes;
+        }
+    }
+    trace.events[trace.count-1].bytes = total;
+    return rc;
+}
+
+int MPI_Start(MPI_Request *request)
+{
+    if (!trace.enabled) {
+        return PMPI_Start(request);
+    }
+    return trace_start_requests("MPI_Start", 1, request);
+}
+
+int MPI_Startall(int count, MPI_Request requests[])
+{
+    if (!trace.enabled) {
+        return PMPI_Startall(count, requests);
+    }
+    return trace_start_requests("MPI_Startall", count, requests);
+}
+
+/*
+ * Forget a persistent request when it is freed; MPI may reuse its handle.
+ */
+int MPI_Request_free(MPI_Request *request)
+{
+    struct trace_request *r;
+
+    if (trace.enabled && (r = trace_find(*request)) != NULL) {
+        *r = trace.requests[--trace.nrequests];
+    }
+    return PMPI_Request_free(request);
+}
+
+/*
+ * The target sends what a get reads, so the bytes are counted as got from
+ * it rather than by trace_record.
+ */
+int MPI_Rget(void *origin_addr, int origin_count,
+             MPI_Datatype origin_datatype, int target_rank,
+             MPI_Aint target_disp, int target_count,
+             MPI_Datatype target_datatype, MPI_Win win, MPI_Request *request)
+{
+    long long bytes;
+    double begin;
+    int peer, rc;
+
+    if (!trace.enabled) {
+        return PMPI_Rget(origin_addr, origin_count, origin_datatype,
+                         target_rank, target_disp, target_count,
+                         target_datatype, win, request);
+    }
+    begin = PMPI_Wtime();
+    rc = PMPI_Rget(origin_addr, origin_count, origin_datatype, target_rank,
+                   target_disp, target_count, target_datatype, win, request);
+    bytes = trace_bytes(origin_count, origin_datatype);
+    trace_record("MPI_Rget", begin, bytes, -1);
+    peer = trace_win_peer(win, target_rank);
+    if (peer >= 0) {
+        trace.got[peer] += bytes;
+    }
+    return rc;
+}
+
+/*
+ * Every process sends a different amount to every other process, so the
+ * bytes are counted per receiver here rather than by trace_record.
+ */
+int MPI_Alltoallw(const void *sendbuf, const int sendcounts[],
+                  const int sdispls[], const MPI_Datatype sendtypes[],
+                  void *recvbuf, const int recvcounts[], const int rdispls[],
+                  const MPI_Datatype recvtypes[], MPI_Comm comm)
+{
+    long long bytes, total = 0;
+    double begin;
+    int i, size, peer, rc;
+
+    if (!trace.enabled) {
+        return PMPI_Alltoallw(sendbuf, sendcounts, sdispls, sendtypes,
+                              recvbuf, recvcounts, rdispls, recvtypes, comm);
+    }
+    begin = PMPI_Wtime();
+    rc = PMPI_Alltoallw(sendbuf, sendcounts, sdispls, sendtypes,
+                        recvbuf, recvcounts, rdispls, recvtypes, comm);
+    trace_record("MPI_Alltoallw", begin, 0, -1);
+    PMPI_Comm_size(comm, &size);
+    for (i = 0; i < size; ++i) {
+        peer = trace_peer(comm, i);
+        if (peer >= 0 && sendcounts[i] > 0) {
+            bytes = trace_bytes(sendcounts[i], sendtypes[i]);
+            trace.sent[peer] += bytes;
+            total += bytes;
+        }
+    }
+    trace.events[trace.count-1].bytes = total;
+    return rc;
+}
+
+int MPI_File_open(MPI_Comm comm, const char *filename, int amode,
+                  MPI_Info info, MPI_File *fh)
+TRACE_CALL("MPI_File_open",
+           PMPI_File_open(comm, filename, amode, info, fh), 0, -1)
+
+int MPI_File_close(MPI_File *fh)
+TRACE_CALL("MPI_File_close", PMPI_File_close(fh), 0, -1)
+
+int MPI_File_read_all(MPI_File fh, void *buf, int count,
+                      MPI_Datatype datatype, MPI_Status *status)
+TRACE_CALL("MPI_File_read_all",
+           PMPI_File_read_all(fh, buf, count, datatype, status),
+           trace_bytes(count, datatype), -1)
+
+int MPI_File_write_all(MPI_File fh, const void *buf, int count,
+                       MPI_Datatype datatype, MPI_Status *status)
+TRACE_CALL("MPI_File_write_all",
+           PMPI_File_write_all(fh, buf, count, datatype, status),
+           trace_bytes(count, datatype), -1)
+
+int MPI_File_write_at(MPI_File fh, MPI_Offset offset, const void *buf,
+                      int count, MPI_Datatype datatype, MPI_Status *status)
+TRACE_CALL("MPI_File_write_at",
+           PMPI_File_write_at(fh, offset, buf, count, datatype, status),
+           trace_bytes(count, datatype), -1)
+
+#ifdef HAVE_MPI_FILE_IREAD_ALL
+int MPI_File_iread_all(MPI_File fh, void *buf, int count,
+                       MPI_Datatype datatype, MPI_Request *request)
+TRACE_CALL("MPI_File_iread_all",
+           PMPI_File_iread_all(fh, buf, count, datatype, request),
+           trace_bytes(count, datatype), -1)
+
+int MPI_File_iwrite_all(MPI_File fh, const void *buf, int count,
+                        MPI_Datatype datatype, MPI_Request *request)
+TRACE_CALL("MPI_File_iwrite_all",
+           PMPI_File_iwrite_all(fh, buf, count, datatype, request),
+           trace_bytes(count, datatype), -1)
+#endif
+
+int MPI_File_iread(MPI_File fh, void *buf, int count, MPI_Datatype datatype,
+                   MPI_Request *request)
+TRACE_CALL("MPI_File_iread",
+           PMPI_File_iread(fh, buf, count, datatype, request),
+           trace_bytes(count, datatype), -1)
+
+int MPI_File_iwrite(MPI_File fh, const void *buf, int count,
+                    MPI_Datatype datatype, MPI_Request *request)
+TRACE_CALL("MPI_File_iwrite",
+           PMPI_File_iwrite(fh, buf, count, datatype, request),
+           trace_bytes(count, datatype), -1)
@@ -0,0 +1,625 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+// Needed for the CPU affinity interface
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/dist.h"
+#include "libmatrix/gemm.h"
+#include "libmatrix/threads.h"
+#include "libmatrix/tune.h"
+
+// Side of the blocks of C whose local multiply is timed, the smallest inner
+// dimension timed and the time each measurement takes at least
+#define TUNE_SIZE 512
+#define TUNE_DEPTH 16
+#define TUNE_TIME 0.02
+
+// Sizes of the small and large messages timed
+#define TUNE_SMALL 8
+#define TUNE_LARGE (1 << 20)
+
+// Time of a trial run
+#define TUNE_TRIAL_TIME 0.1
+
+// Names of the algorithms in a profile, in the order of their enum
+static const char *algorithms[] = { "cannon", "summa", "25d" };
+
+/*
+ * Return the least common multiple of a and b.
+ */
+static int lcm(int a, int b)
+{
+    int m;
+
+    for (m = a; m % b != 0; m += a)
+        ;
+    return m;
+}
+
+/*
+ * Return the number of cores of this process: the CPUs of its affinity
+ * mask, divided between the ranks of its node in proportion to their masks,
+ * so that ranks bound to their own cores or sockets keep them and unbound
+ * ranks share the node. Collective over comm.
+ */
+static int tune_cores(MPI_Comm comm)
+{
+    MPI_Comm node;
+    int cores = 1;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+#if defined(HAVE_SCHED_H) && defined(HAVE_SCHED_SETAFFINITY)
+    {
+        cpu_set_t mask, all;
+        int own, sum;
+
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+            CPU_ZERO(&mask);
+        }
+        own = CPU_COUNT(&mask);
+        MPI_Allreduce(&mask, &all, sizeof(mask), MPI_BYTE, MPI_BOR, node);
+        MPI_Allreduce(&own, &sum, 1, MPI_INT, MPI_SUM, node);
+        if (sum > 0) {
+            cores = own * CPU_COUNT(&all) / sum;
+        }
+    }
+#endif
+    MPI_Comm_free(&node);
+    return cores > 1 ? cores : 1;
+}
+
+/*
+ * Return the GFLOP/s of repeated local multiplies of a TUNE_SIZE square
+ * block of C with an inner dimension of depth, out of A and B.
+ */
+static double tune_gemm(const struct matrix_type *type, int depth,
+                        const void *A, const void *B, void *C)
+{
+    double start, elapsed;
+    int reps = 0;
+
+    matrix_gemm(type, TUNE_SIZE, TUNE_SIZE, depth, A, depth, B, TUNE_SIZE,
+                C, TUNE_SIZE);
+    start = MPI_Wtime();
+    do {
+        matrix_gemm(type, TUNE_SIZE, TUNE_SIZE, depth, A, depth, B,
+                    TUNE_SIZE, C, TUNE_SIZE);
+        ++reps;
+        elapsed = MPI_Wtime() - start;
+    } while (elapsed < TUNE_TIME);
+    return type->flops * (double)TUNE_SIZE * TUNE_SIZE * depth * reps
+         / elapsed * 1e-9;
+}
+
+/*
+ * Return the seconds of a message of bytes from rank 0 to the last rank of
+ * comm, half of the round trip, on rank 0.
+ */
+static double tune_pingpong(MPI_Comm comm, char *buffer, int bytes, int reps)
+{
+    double start;
+    int rank, procs, i;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+    MPI_Barrier(comm);
+    start = MPI_Wtime();
+    for (i = 0; i < reps; ++i) {
+        if (rank == 0) {
+            MPI_Send(buffer, bytes, MPI_BYTE, procs - 1, 0, comm);
+            MPI_Recv(buffer, bytes, MPI_BYTE, procs - 1, 0, comm,
+                     MPI_STATUS_IGNORE);
+        } else if (rank == procs - 1) {
+            MPI_Recv(buffer, bytes, MPI_BYTE, 0, 0, comm, MPI_STATUS_IGNORE);
+            MPI_Send(buffer, bytes, MPI_BYTE, 0, 0, comm);
+        }
+    }
+    return (MPI_Wtime() - start) / reps / 2;
+}
+
+/*
+ * Return the seconds of a broadcast of bytes from rank 0 over comm on the
+ * slowest process.
+ */
+static double tune_bcast(MPI_Comm comm, char *buffer, int bytes, int reps)
+{
+    double start, elapsed, slowest;
+    int i;
+
+    MPI_Barrier(comm);
+    start = MPI_Wtime();
+    for (i = 0; i < reps; ++i) {
+        MPI_Bcast(buffer, bytes, MPI_BYTE, 0, comm);
+    }
+    elapsed = (MPI_Wtime() - start) / reps;
+    MPI_Allreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return slowest;
+}
+
+/*
+ * Measure the machine parameters of comm.
+ */
+void matrix_tune_measure(MPI_Comm comm, const struct matrix_type *type,
+                         int threads, struct matrix_machine *machine)
+{
+    struct matrix_dist dist;
+    void *A, *B, *C;
+    char *buffer;
+    double small, large;
+    const int saved = matrix_threads();
+    int cores, t, i, depth;
+
+    memset(machine, '\0', sizeof(*machine));
+    MPI_Comm_size(comm, &machine->procs);
+
+    // Powers of two up to the cores every process has, and the cores
+    // themselves, or just the threads asked for
+    cores = tune_cores(comm);
+    MPI_Allreduce(MPI_IN_PLACE, &cores, 1, MPI_INT, MPI_MIN, comm);
+    if (threads > 0) {
+        machine->threads[machine->nthreads++] = threads;
+    } else {
+        for (t = 1; t <= cores && machine->nthreads < MATRIX_TUNE_THREADS; t *= 2) {
+            machine->threads[machine->nthreads++] = t;
+        }
+        if (machine->threads[machine->nthreads-1] < cores
+            && machine->nthreads < MATRIX_TUNE_THREADS) {
+            machine->threads[machine->nthreads++] = cores;
+        }
+    }
+
+    // Local multiplies at every thread count and inner dimension
+    A = malloc((size_t)TUNE_SIZE * TUNE_SIZE * type->size);
+    B = malloc((size_t)TUNE_SIZE * TUNE_SIZE * type->size);
+    C = calloc((size_t)TUNE_SIZE * TUNE_SIZE, type->acc->size);
+    assert(A != NULL && B != NULL && C != NULL);
+    matrix_dist_init(&dist, TUNE_SIZE, TUNE_SIZE, TUNE_SIZE, 1, 1, 0, 0);
+    matrix_dist_generate(&dist, type, 1, A);
+    matrix_dist_generate(&dist, type, 2, B);
+    for (t = 0; t < machine->nthreads; ++t) {
+        machine->threads[t] = matrix_threads_init(machine->threads[t], 0);
+        for (i = 0, depth = TUNE_DEPTH; i < MATRIX_TUNE_DEPTHS; ++i, depth *= 2) {
+            machine->gflops[t][i] = tune_gemm(type, depth, A, B, C);
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, machine->gflops,
+                  MATRIX_TUNE_THREADS * MATRIX_TUNE_DEPTHS, MPI_DOUBLE,
+                  MPI_MIN, comm);
+    matrix_threads_init(saved, 0);
+    free(A);
+    free(B);
+    free(C);
+
+    // Point-to-point messages between the ranks furthest apart, likely on
+    // different nodes, and broadcasts over all of them
+    if (machine->procs > 1) {
+        buffer = calloc(TUNE_LARGE, 1);
+        assert(buffer != NULL);
+        tune_pingpong(comm, buffer, TUNE_SMALL, 10);
+        small = tune_pingpong(comm, buffer, TUNE_SMALL, 100);
+        large = tune_pingpong(comm, buffer, TUNE_LARGE, 10);
+        machine->latency = small;
+        machine->bandwidth = (TUNE_LARGE - TUNE_SMALL)
+                           / (large > small ? large - small : large);
+        MPI_Bcast(&machine->latency, 1, MPI_DOUBLE, 0, comm);
+        MPI_Bcast(&machine->bandwidth, 1, MPI_DOUBLE, 0, comm);
+
+        tune_bcast(comm, buffer, TUNE_SMALL, 10);
+        small = tune_bcast(comm, buffer, TUNE_SMALL, 100);
+        large = tune_bcast(comm, buffer, TUNE_LARGE, 10);
+        machine->bcast_latency = small;
+        machine->bcast_bandwidth = (TUNE_LARGE - TUNE_SMALL)
+                                 / (large > small ? large - small : large);
+        free(buffer);
+    }
+}
+
+/*
+ * Return the GFLOP/s of a local multiply with threads threads and an inner
+ * dimension of depth, interpolated between the measured depths.
+ */
+static double tune_rate(const struct matrix_machine *machine, int threads,
+                        int depth)
+{
+    const double *gflops = machine->gflops[0];
+    double x;
+    int t, i;
+
+    for (t = 0; t < machine->nthreads; ++t) {
+        if (machine->threads[t] == threads) {
+            gflops = machine->gflops[t];
+        }
+    }
+    x = log2((double)depth / TUNE_DEPTH);
+    if (x <= 0.0) {
+        return gflops[0] * depth / TUNE_DEPTH;
+    }
+    if (x >= MATRIX_TUNE_DEPTHS - 1) {
+        return gflops[MATRIX_TUNE_DEPTHS-1];
+    }
+    i = (int)x;
+    return gflops[i] + (x - i) * (gflops[i+1] - gflops[i]);
+}
+
+/*
+ * Return the seconds of a broadcast of bytes over q of the machine's
+ * processes, scaled from its broadcast over all of them as a binomial tree.
+ */
+static double tune_bcast_time(const struct matrix_machine *machine, int q,
+                              double bytes)
+{
+    if (q <= 1) {
+        return 0.0;
+    }
+    return ceil(log2(q)) / ceil(log2(machine->procs))
+         * (machine->bcast_latency + bytes / machine->bcast_bandwidth);
+}
+
+/*
+ * Predict the multiply time of tuning.
+ */
+double matrix_tune_model(const struct matrix_machine *machine,
+                         const struct matrix_tuning *tuning)
+{
+    const struct matrix_type *type = tuning->type;
+    const int M = tuning->M, K = tuning->K, N = tuning->N;
+    const int prows = tuning->prows, pcols = tuning->pcols;
+    const int slices = lcm(prows, pcols);
+    const int nb = tuning->block;
+    int steps, depth, width, k;
+    double rows, cols, compute, transfer;
+
+    // Each step multiplies depth of the inner dimension in local multiplies
+    // of width: Cannon's slices are whole blocks, multiplied at once on a
+    // square grid, and SUMMA's panels are multiplied whole. Either takes
+    // the block size as it is, as the context does with an explicit one.
+    if (tuning->algorithm == MATRIX_CANNON) {
+        steps = slices;
+        depth = (K + nb - 1) / nb;
+        depth = (depth + slices - 1) / slices * nb;
+        if (depth > K) {
+            depth = K;
+        }
+        width = prows == pcols ? depth : nb;
+    } else {
+        // Panels stop at block boundaries, as in the context
+        depth = tuning->panel < nb ? tuning->panel : nb;
+        for (steps = 0, k = 0; k < K; ++steps) {
+            k += nb - k % nb < depth ? nb - k % nb : depth;
+        }
+        if (depth > K) {
+            depth = K;
+        }
+        width = depth;
+    }
+
+    // Process (0, 0) holds the most blocks
+    rows = matrix_numroc(M, nb, 0, prows);
+    cols = matrix_numroc(N, nb, 0, pcols);
+    compute = type->flops * rows * cols * depth
+            / (tune_rate(machine, tuning->threads, width) * 1e9);
+
+    if (tuning->algorithm == MATRIX_CANNON) {
+        transfer = prows * pcols == 1 ? 0.0 : machine->latency
+                 + (rows * matrix_numroc(K, nb, 0, pcols)
+                 + matrix_numroc(K, nb, 0, prows) * cols)
+                 * type->size / machine->bandwidth;
+    } else {
+        transfer = tune_bcast_time(machine, pcols, rows * depth * type->size)
+                 + tune_bcast_time(machine, prows, depth * cols * type->size);
+    }
+
+    // The first transfer is waited for, the others hide behind the
+    // multiplies or the multiplies behind them
+    return transfer + (steps - 1) * (compute > transfer ? compute : transfer)
+         + compute;
+}
+
+/*
+ * Insert tuning into best, the count fastest so far sorted by seconds, if
+ * it is faster than the last. A tie with one on the same grid with the same
+ * threads is left out: the model cannot tell them apart, and a trial of
+ * both would crowd out another grid.
+ */
+static void tune_keep(struct matrix_tuning *best, int count,
+                      const struct matrix_tuning *tuning)
+{
+    int i;
+
+    if (tuning->seconds >= best[count-1].seconds) {
+        return;
+    }
+    for (i = 0; i < count; ++i) {
+        if (best[i].seconds == tuning->seconds
+            && best[i].prows == tuning->prows && best[i].pcols == tuning->pcols
+            && best[i].threads == tuning->threads) {
+            return;
+        }
+    }
+    for (i = count - 1; i > 0 && best[i-1].seconds > tuning->seconds; --i) {
+        best[i] = best[i-1];
+    }
+    best[i] = *tuning;
+}
+
+/*
+ * Run the multiply of tuning on random matrices, with K cut down to whole
+ * steps of about TUNE_TRIAL_TIME by the model, and return the slowest
+ * process's time of the faster of two multiplies after a first one, scaled
+ * back up to K. A multiply whose steps take longer runs just once. Returns
+ * DBL_MAX if the grid does not fit comm.
+ */
+static double tune_trial(MPI_Comm comm, const struct matrix_tuning *tuning)
+{
+    const struct matrix_type *type = tuning->type;
+    struct matrix_config config;
+    struct matrix_context *ctx;
+    struct matrix_context_stats stats;
+    const struct matrix_dist *dist_A, *dist_B, *dist_C;
+    void *local_A, *local_B, *local_C;
+    double elapsed, slowest, best = DBL_MAX;
+    int unit, K = tuning->K, runs = 3, i;
+
+    // Cannon's algorithm cuts whole blocks from every slice, SUMMA whole
+    // panels
+    unit = tuning->algorithm == MATRIX_CANNON
+         ? tuning->block * lcm(tuning->prows, tuning->pcols) : tuning->panel;
+    if (tuning->seconds > TUNE_TRIAL_TIME) {
+        K = (int)ceil(TUNE_TRIAL_TIME / tuning->seconds * tuning->K / unit) * unit;
+        if (K <= 0 || K > tuning->K) {
+            K = tuning->K;
+        }
+        if (tuning->seconds * K / tuning->K > 2 * TUNE_TRIAL_TIME) {
+            runs = 1;
+        }
+    }
+
+    memset(&config, '\0', sizeof(config));
+    config.algorithm = tuning->algorithm;
+    config.type = type;
+    config.M = tuning->M;
+    config.K = K;
+    config.N = tuning->N;
+    config.prows = tuning->prows;
+    config.pcols = tuning->pcols;
+    config.block = tuning->block;
+    config.panel = tuning->panel;
+    config.overlap = 1;
+    config.persistent = tuning->algorithm != MATRIX_SUMMA;
+    matrix_threads_init(tuning->threads, 0);
+    if (matrix_context_create(comm, &config, &ctx) != MPI_SUCCESS) {
+        return DBL_MAX;
+    }
+
+    dist_A = matrix_context_dist(ctx, 0);
+    dist_B = matrix_context_dist(ctx, 1);
+    dist_C = matrix_context_dist(ctx, 2);
+    local_A = malloc((size_t)dist_A->local_rows * dist_A->local_cols * type->size);
+    local_B = malloc((size_t)dist_B->local_rows * dist_B->local_cols * type->size);
+    local_C = calloc((size_t)dist_C->local_rows * dist_C->local_cols, type->acc->size);
+    assert((local_A != NULL || dist_A->local_rows * dist_A->local_cols == 0)
+           && (local_B != NULL || dist_B->local_rows * dist_B->local_cols == 0)
+           && (local_C != NULL || dist_C->local_rows * dist_C->local_cols == 0));
+    matrix_dist_generate(dist_A, type, 1, local_A);
+    matrix_dist_generate(dist_B, type, 2, local_B);
+
+    // The first multiply warms up the buffers and connections
+    for (i = 0; i < runs; ++i) {
+        MPI_Barrier(matrix_context_comm(ctx));
+        matrix_context_multiply(ctx, local_A, local_B, local_C, &stats);
+        elapsed = stats.skew_time + stats.loop_time;
+        MPI_Allreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX,
+                      matrix_context_comm(ctx));
+        if ((i > 0 || runs == 1) && slowest < best) {
+            best = slowest;
+        }
+    }
+
+    free(local_A);
+    free(local_B);
+    free(local_C);
+    matrix_context_free(ctx);
+    return best * tuning->K / K;
+}
+
+/*
+ * Tune Cannon's algorithm and SUMMA.
+ */
+void matrix_tune(MPI_Comm comm, const struct matrix_machine *machine,
+                 const struct matrix_type *type, int M, int K, int N,
+                 int trials, struct matrix_tuning tuned[2])
+{
+    // SUMMA's panel widths besides the block size
+    static const int panels[] = { 32, 64, 128, 256, 512, 1024 };
+    struct matrix_tuning best[2][8], tuning;
+    const int saved = matrix_threads();
+    int algorithm, procs, nb0, nb, slices, p, t, i;
+
+    if (trials < 1) {
+        trials = 1;
+    } else if (trials > 8) {
+        trials = 8;
+    }
+    MPI_Comm_size(comm, &procs);
+    memset(&tuning, '\0', sizeof(tuning));
+    tuning.type = type;
+    tuning.procs = procs;
+    tuning.M = M;
+    tuning.K = K;
+    tuning.N = N;
+    for (algorithm = 0; algorithm < 2; ++algorithm) {
+        for (i = 0; i < trials; ++i) {
+            best[algorithm][i] = tuning;
+            best[algorithm][i].seconds = DBL_MAX;
+        }
+    }
+
+    // Model every grid, the default block size and up to three halvings of
+    // it, the panel widths and the thread counts
+    for (tuning.prows = 1; tuning.prows <= procs; ++tuning.prows) {
+        if (procs % tuning.prows != 0) {
+            continue;
+        }
+        tuning.pcols = procs / tuning.prows;
+        nb0 = matrix_dist_block(M, K, N, tuning.prows, tuning.pcols);
+        slices = lcm(tuning.prows, tuning.pcols);
+        for (nb = nb0; nb > 0 && nb >= nb0 / 8; nb /= 2) {
+            tuning.block = nb;
+            for (t = 0; t < machine->nthreads; ++t) {
+                tuning.threads = machine->threads[t];
+
+                // Cannon's default block size gives every slice a block;
+                // a larger one would leave steps idle
+                tuning.algorithm = MATRIX_CANNON;
+                tuning.block = nb < (K + slices - 1) / slices
+                             ? nb : (K + slices - 1) / slices;
+                tuning.panel = 0;
+                tuning.seconds = matrix_tune_model(machine, &tuning);
+                tune_keep(best[MATRIX_CANNON], trials, &tuning);
+                tuning.block = nb;
+
+                tuning.algorithm = MATRIX_SUMMA;
+                for (p = -1; p < (int)(sizeof(panels) / sizeof(panels[0])); ++p) {
+                    tuning.panel = p < 0 ? nb : panels[p];
+                    if (p >= 0 && (tuning.panel >= nb || tuning.panel > K)) {
+                        continue;
+                    }
+                    tuning.seconds = matrix_tune_model(machine, &tuning);
+                    tune_keep(best[MATRIX_SUMMA], trials, &tuning);
+                }
+            }
+        }
+    }
+
+    // Run the best of each by the model and keep the fastest
+    for (algorithm = 0; algorithm < 2; ++algorithm) {
+        tuned[algorithm] = best[algorithm][0];
+        tuned[algorithm].seconds = DBL_MAX;
+        for (i = 0; i < trials && best[algorithm][i].seconds < DBL_MAX; ++i) {
+            tuning = best[algorithm][i];
+            tuning.seconds = tune_trial(comm, &best[algorithm][i]);
+            if (tuning.seconds < tuned[algorithm].seconds) {
+                tuned[algorithm] = tuning;
+            }
+        }
+    }
+    matrix_threads_init(saved, 0);
+}
+
+/*
+ * Look up a tuned multiply in a profile.
+ */
+int matrix_tune_load(const char *path, struct matrix_tuning *tuning,
+                     MPI_Comm comm)
+{
+    struct matrix_tuning line;
+    char buffer[256], algorithm[16], dtype[16];
+    double values[7] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    FILE *fp;
+    int rank;
+
+    // The last matching line wins, so a profile can be tuned again
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0 && (fp = fopen(path, "r")) != NULL) {
+        while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+            if (buffer[0] == '#'
+                || sscanf(buffer, "%15s %15s %d %dx%dx%d %dx%d %d %d %d %lf",
+                          algorithm, dtype, &line.procs, &line.M, &line.K,
+                          &line.N, &line.prows, &line.pcols, &line.block,
+                          &line.panel, &line.threads, &line.seconds) != 12) {
+                continue;
+            }
+            if (strcmp(algorithm, algorithms[tuning->algorithm]) == 0
+                && matrix_type_find(dtype) == tuning->type
+                && line.procs == tuning->procs && line.M == tuning->M
+                && line.K == tuning->K && line.N == tuning->N
+                && line.prows * line.pcols == line.procs && line.block > 0
+                && line.panel >= 0 && line.threads > 0) {
+                values[0] = 1.0;
+                values[1] = line.prows;
+                values[2] = line.pcols;
+                values[3] = line.block;
+                values[4] = line.panel;
+                values[5] = line.threads;
+                values[6] = line.seconds;
+            }
+        }
+        fclose(fp);
+    }
+
+    MPI_Bcast(values, 7, MPI_DOUBLE, 0, comm);
+    if (values[0] == 0.0) {
+        return 1;
+    }
+    tuning->prows = (int)values[1];
+    tuning->pcols = (int)values[2];
+    tuning->block = (int)values[3];
+    tuning->panel = (int)values[4];
+    tuning->threads = (int)values[5];
+    tuning->seconds = values[6];
+    return 0;
+}
+
+/*
+ * Append tuned multiplies to a profile.
+ */
+int matrix_tune_save(const char *path, const struct matrix_tuning *tunings,
+                     int count)
+{
+    FILE *fp;
+    int i;
+
+    fp = fopen(path, "a");
+    if (fp == NULL) {
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) == 0) {
+        fprintf(fp, "# algorithm dtype procs MxKxN grid block panel threads seconds\n");
+    }
+    for (i = 0; i < count; ++i) {
+        fprintf(fp, "%s %s %d %dx%dx%d %dx%d %d %d %d %.6f\n",
+                algorithms[tunings[i].algorithm], tunings[i].type->name,
+                tunings[i].procs, tunings[i].M, tunings[i].K, tunings[i].N,
+                tunings[i].prows, tunings[i].pcols, tunings[i].block,
+                tunings[i].panel, tunings[i].threads, tunings[i].seconds);
+    }
+    return fclose(fp) != 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_TUNE_H
+#define LIBMATRIX_TUNE_H
+
+#include <mpi.h>
+
+#include "libmatrix/context.h"
+#include "libmatrix/types.h"
+
+/*
+ * Number of inner dimensions and thread counts at which the local multiply
+ * rate is measured.
+ */
+#define MATRIX_TUNE_DEPTHS 6
+#define MATRIX_TUNE_THREADS 8
+
+/*
+ * Configurations of each algorithm that matrix_tune runs by default.
+ */
+#define MATRIX_TUNE_TRIALS 2
+
+/*
+ * Machine parameters measured on a communicator of procs processes. gflops
+ * is the rate of the slowest process's local multiply, of a 512 x 512
+ * block of C with threads[t] threads and an inner dimension of 16, 32, ...
+ * 512. A point-to-point message of n bytes between the first and the last
+ * rank takes latency + n / bandwidth seconds, and a broadcast over all
+ * procs bcast_latency + n / bcast_bandwidth.
+ */
+struct matrix_machine {
+    int procs;
+    int nthreads;
+    int threads[MATRIX_TUNE_THREADS];
+    double gflops[MATRIX_TUNE_THREADS][MATRIX_TUNE_DEPTHS];
+    double latency, bandwidth;
+    double bcast_latency, bcast_bandwidth;
+};
+
+/*
+ * A multiply of an M x K by a K x N matrix of type on procs processes run
+ * with algorithm, Cannon's algorithm or SUMMA, on a prows x pcols grid in
+ * blocks of block, SUMMA's panels of panel, and threads threads per
+ * process. seconds is the time of its multiply, the initial skew and the
+ * loop, measured by a trial run or predicted by the cost model.
+ */
+struct matrix_tuning {
+    enum matrix_algorithm algorithm;
+    const struct matrix_type *type;
+    int procs;
+    int M, K, N;
+    int prows, pcols;
+    int block;
+    int panel;
+    int threads;
+    double seconds;
+};
+
+/*
+ * Measure the machine parameters of comm for multiplies of type, trying
+ * threads threads per process or, if threads is 0, every power of two up to
+ * the cores of each process: the CPUs of its affinity mask, shared with the
+ * other ranks of its node whose masks overlap. Collective over comm.
+ */
+void matrix_tune_measure(MPI_Comm comm, const struct matrix_type *type,
+                         int threads, struct matrix_machine *machine);
+
+/*
+ * Predict the multiply time of tuning from the machine parameters. Cannon's
+ * algorithm runs lcm(prows, pcols) steps, each a local multiply overlapped
+ * with the shift of the local blocks of A and B to the neighbours; SUMMA
+ * runs K / panel steps, each a local multiply overlapped with a broadcast
+ * of a panel of A along the process row and of B along the column, as a
+ * binomial tree. Both wait for the slowest process, which holds the most
+ * blocks.
+ */
+double matrix_tune_model(const struct matrix_machine *machine,
+                         const struct matrix_tuning *tuning);
+
+/*
+ * Choose the fastest configuration of Cannon's algorithm and of SUMMA for
+ * the multiply of an M x K by a K x N matrix of type on comm, into
+ * tuned[MATRIX_CANNON] and tuned[MATRIX_SUMMA]. The cost model ranks every
+ * process grid, block size, panel width and thread count of machine, and
+ * the best trials configurations of each algorithm by the model are run on
+ * random matrices, with K cut down so that a run takes about a tenth of a
+ * second and the time scaled back up. Collective over comm.
+ */
+void matrix_tune(MPI_Comm comm, const struct matrix_machine *machine,
+                 const struct matrix_type *type, int M, int K, int N,
+                 int trials, struct matrix_tuning tuned[2]);
+
+/*
+ * Look up the algorithm, type, procs, M, K and N of tuning in the profile
+ * at path, a text file of one tuned multiply per line, and fill in the rest
+ * of tuning. Collective over comm; only rank 0 reads the file. Returns
+ * nonzero if the file or the line is missing.
+ */
+int matrix_tune_load(const char *path, struct matrix_tuning *tuning,
+                     MPI_Comm comm);
+
+/*
+ * Append count tunings to the profile at path, creating it if needed. Only
+ * the calling process writes. Returns nonzero if the file cannot be written.
+ */
+int matrix_tune_save(const char *path, const struct matrix_tuning *tunings,
+                     int count);
+
+#endif /* LIBMATRIX_TUNE_H */
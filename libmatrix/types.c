@@ -0,0 +1,265 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/types.h"
+
+/*
+ * Text format of each element type, as printed and read back. Complex numbers are written as a+bi,
+ * or as a or bi alone.
+ */
+static int read_int(FILE *fp, void *x)
+{
+    return fscanf(fp, "%d", (int *)x) == 1;
+}
+
+static int format_int(char *buf, size_t size, const void *x)
+{
+    return snprintf(buf, size, "%5d", *(const int *)x);
+}
+
+static int read_int64(FILE *fp, void *x)
+{
+    return fscanf(fp, "%" SCNd64, (int64_t *)x) == 1;
+}
+
+static int format_int64(char *buf, size_t size, const void *x)
+{
+    return snprintf(buf, size, "%5" PRId64, *(const int64_t *)x);
+}
+
+/*
+ * Quantized elements are read as int and must fit their type.
+ */
+#define MATRIX_TYPE_TEXT_NARROW(id, type, min, max)             \
+    static int read_##id(FILE *fp, void *x)                     \
+    {                                                           \
+        int value;                                              \
+        if (fscanf(fp, "%d", &value) != 1 || value < (min)      \
+            || value > (max)) {                                 \
+            return 0;                                           \
+        }                                                       \
+        *(type *)x = (type)value;                               \
+        return 1;                                               \
+    }                                                           \
+                                                                \
+    static int format_##id(char *buf, size_t size, const void *x) \
+    {                                                           \
+        return snprintf(buf, size, "%5d", (int)*(const type *)x); \
+    }
+MATRIX_TYPE_TEXT_NARROW(int8, int8_t, INT8_MIN, INT8_MAX)
+MATRIX_TYPE_TEXT_NARROW(int16, int16_t, INT16_MIN, INT16_MAX)
+#undef MATRIX_TYPE_TEXT_NARROW
+
+static int read_float(FILE *fp, void *x)
+{
+    return fscanf(fp, "%f", (float *)x) == 1;
+}
+
+static int format_float(char *buf, size_t size, const void *x)
+{
+    return snprintf(buf, size, "%9.6g", *(const float *)x);
+}
+
+static int read_double(FILE *fp, void *x)
+{
+    return fscanf(fp, "%lf", (double *)x) == 1;
+}
+
+static int format_double(char *buf, size_t size, const void *x)
+{
+    return snprintf(buf, size, "%12.9g", *(const double *)x);
+}
+
+static int read_cdouble(FILE *fp, void *x)
+{
+    char token[64], *end;
+    double re, im = 0.0;
+
+    if (fscanf(fp, "%63s", token) != 1) {
+        return 0;
+    }
+    re = strtod(token, &end);
+    if (*end == 'i' && end[1] == '\0') {
+        // Imaginary only: bi
+        im = re;
+        re = 0.0;
+    } else if (*end != '\0') {
+        // Both parts: a+bi or a-bi
+        im = strtod(end, &end);
+        if (*end != 'i' || end[1] != '\0') {
+            return 0;
+        }
+    }
+    *(double complex *)x = CMPLX(re, im);
+    return 1;
+}
+
+static int format_cdouble(char *buf, size_t size, const void *x)
+{
+    const double complex z = *(const double complex *)x;
+    return snprintf(buf, size, "%12.9g%+.9gi", creal(z), cimag(z));
+}
+
+/*
+ * Squared magnitude of an element, for the norm of a matrix.
+ */
+#define MATRIX_TYPE_NORM2(id, type, mpi)                        \
+    static double norm2_##id(const void *x)                     \
+    {                                                           \
+        const double complex z = *(const type *)x;              \
+        return creal(z) * creal(z) + cimag(z) * cimag(z);       \
+    }
+MATRIX_TYPES(MATRIX_TYPE_NORM2)
+MATRIX_QTYPES(MATRIX_TYPE_NORM2)
+#undef MATRIX_TYPE_NORM2
+
+/*
+ * Random elements. Integers stay small so that products of any realistic
+ * inner dimension cannot overflow.
+ */
+#define MATRIX_TYPE_RANDOM_INT(id, type)                        \
+    static void random_##id(uint64_t h, void *x)                \
+    {                                                           \
+        *(type *)x = (type)(h % 19) - 9;                        \
+    }
+MATRIX_TYPE_RANDOM_INT(int, int)
+MATRIX_TYPE_RANDOM_INT(int64, int64_t)
+MATRIX_TYPE_RANDOM_INT(int8, int8_t)
+MATRIX_TYPE_RANDOM_INT(int16, int16_t)
+#undef MATRIX_TYPE_RANDOM_INT
+
+static double random_real(uint64_t bits, int width)
+{
+    return ldexp((double)bits, 1 - width) - 1.0;
+}
+
+static void random_float(uint64_t h, void *x)
+{
+    *(float *)x = (float)random_real(h >> 40, 24);
+}
+
+static void random_double(uint64_t h, void *x)
+{
+    *(double *)x = random_real(h >> 11, 53);
+}
+
+static void random_cdouble(uint64_t h, void *x)
+{
+    *(double complex *)x = CMPLX(random_real(h >> 32, 32),
+                                 random_real(h & 0xffffffffULL, 32));
+}
+
+/*
+ * The longest text of each element type: the widest value of its format,
+ * such as INT_MIN or a negative float with a three digit exponent.
+ */
+#define WIDTH_int 11
+#define WIDTH_int64 20
+#define WIDTH_float 13
+#define WIDTH_double 16
+#define WIDTH_cdouble 33
+#define WIDTH_int8 5
+#define WIDTH_int16 6
+
+/*
+ * Operations per multiply-add: a complex one takes four real multiplies and
+ * four real additions.
+ */
+#define FLOPS_int 2
+#define FLOPS_int64 2
+#define FLOPS_float 2
+#define FLOPS_double 2
+#define FLOPS_cdouble 8
+#define FLOPS_int8 2
+#define FLOPS_int16 2
+
+/*
+ * Type of C: quantized products accumulate in int.
+ */
+#define ACC_int (&types[MATRIX_int])
+#define ACC_int64 (&types[MATRIX_int64])
+#define ACC_float (&types[MATRIX_float])
+#define ACC_double (&types[MATRIX_double])
+#define ACC_cdouble (&types[MATRIX_cdouble])
+#define ACC_int8 (&types[MATRIX_int])
+#define ACC_int16 (&types[MATRIX_int])
+
+#define MATRIX_TYPE_ENTRY(id, type, mpi) \
+    { MATRIX_##id, #id, sizeof(type), mpi, WIDTH_##id, read_##id, \
+      format_##id, norm2_##id, FLOPS_##id, random_##id, ACC_##id },
+static const struct matrix_type types[] = {
+    MATRIX_TYPES(MATRIX_TYPE_ENTRY)
+    MATRIX_QTYPES(MATRIX_TYPE_ENTRY)
+};
+#undef MATRIX_TYPE_ENTRY
+
+/*
+ * Look up an element type by name. The complex type is listed as cdouble
+ * internally and accepted as complex.
+ */
+const struct matrix_type *matrix_type_find(const char *name)
+{
+    int i;
+
+    if (strcmp(name, "complex") == 0) {
+        name = "cdouble";
+    }
+    for (i = 0; i < MATRIX_NTYPES; ++i) {
+        if (strcmp(name, types[i].name) == 0) {
+            return &types[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Return the user facing names of all element types.
+ */
+const char *matrix_type_names(void)
+{
+    return "int, int64, float, double, complex, int8, int16";
+}
+
+/*
+ * Return the largest K with K max_a max_b <= INT_MAX for a quantized type.
+ */
+long long matrix_type_exact_k(const struct matrix_type *type, double max_a,
+                              double max_b)
+{
+    if (type->acc == type || max_a * max_b < 1.0) {
+        return -1;
+    }
+    return (long long)(INT_MAX / (max_a * max_b));
+}
@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef LIBMATRIX_TYPES_H
+#define LIBMATRIX_TYPES_H
+
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <mpi.h>
+
+/*
+ * Element types, as X(id, C type, MPI datatype). Type-specialized code is
+ * generated from one source for every entry, either by expanding this list
+ * or by including a template once per type.
+ */
+#define MATRIX_TYPES(X)                                 \
+    X(int,     int,            MPI_INT)                 \
+    X(int64,   int64_t,        MPI_INT64_T)             \
+    X(float,   float,          MPI_FLOAT)               \
+    X(double,  double,         MPI_DOUBLE)              \
+    X(cdouble, double complex, MPI_C_DOUBLE_COMPLEX)
+
+/*
+ * Quantized element types, as X(id, C type, MPI datatype). A and B are
+ * stored and sent as these narrow integers, and their products accumulate
+ * in an int C. The sum of K products of magnitudes up to |a| and |b| is
+ * exact as long as K |a| |b| <= INT_MAX, 2^31 - 1: at full range K up to
+ * 131071 for int8 (|a|, |b| <= 128) and only 1 for int16 (|a|, |b| <=
+ * 32768), and for int16 data within +-181 K up to 65550.
+ */
+#define MATRIX_QTYPES(X)                                \
+    X(int8,    int8_t,         MPI_INT8_T)              \
+    X(int16,   int16_t,        MPI_INT16_T)
+
+#define MATRIX_TYPE_ID(id, type, mpi) MATRIX_##id,
+enum matrix_dtype {
+    MATRIX_TYPES(MATRIX_TYPE_ID)
+    MATRIX_QTYPES(MATRIX_TYPE_ID)
+    MATRIX_NTYPES
+};
+#undef MATRIX_TYPE_ID
+
+/*
+ * An element type: its size, MPI datatype and text format. format writes
+ * at most width characters plus the terminating NUL, like snprintf, and
+ * norm2 returns the squared magnitude of an element. flops counts the
+ * arithmetic operations of one multiply-add, and random sets an element from
+ * a 64-bit hash: small integers in [-9, 9] or reals in [-1, 1). acc is the
+ * type products accumulate in, and so the type of C: int for the quantized
+ * types and the type itself otherwise.
+ */
+struct matrix_type {
+    enum matrix_dtype id;
+    const char *name;
+    size_t size;
+    MPI_Datatype mpi;
+    int width;
+    int (*read)(FILE *fp, void *x);
+    int (*format)(char *buf, size_t size, const void *x);
+    double (*norm2)(const void *x);
+    int flops;
+    void (*random)(uint64_t h, void *x);
+    const struct matrix_type *acc;
+};
+
+/*
+ * Look up an element type by name: int, int64, float, double, complex, or
+ * the quantized int8 and int16. Returns NULL for an unknown name.
+ */
+const struct matrix_type *matrix_type_find(const char *name);
+
+/*
+ * Return the name of every element type, separated by ", ".
+ */
+const char *matrix_type_names(void);
+
+/*
+ * Return the largest inner dimension K whose sums of products of magnitudes
+ * up to max_a and max_b are exact in the int C of a quantized type, or -1
+ * for any K: for the other types, which accumulate in their own type, or
+ * for a zero A or B.
+ */
+long long matrix_type_exact_k(const struct matrix_type *type, double max_a,
+                              double max_b);
+
+#endif /* LIBMATRIX_TYPES_H */
@@ -0,0 +1,447 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <complex.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/verify.h"
+
+/*
+ * Vector arithmetic of the check: integers in the unsigned type of their
+ * accumulator, which wraps like the multiply, reals in double. A quantized
+ * type shares the vectors of its int C.
+ */
+#define VEC_int unsigned int
+#define VEC_int64 uint64_t
+#define VEC_float double
+#define VEC_double double
+#define VEC_cdouble double complex
+#define VEC_int8 unsigned int
+#define VEC_int16 unsigned int
+
+#define VEC_MPI_int MPI_UNSIGNED
+#define VEC_MPI_int64 MPI_UINT64_T
+#define VEC_MPI_float MPI_DOUBLE
+#define VEC_MPI_double MPI_DOUBLE
+#define VEC_MPI_cdouble MPI_C_DOUBLE_COMPLEX
+#define VEC_MPI_int8 MPI_UNSIGNED
+#define VEC_MPI_int16 MPI_UNSIGNED
+
+/*
+ * Unit roundoff of C, or 0 for an exact check.
+ */
+#define EPS_int 0.0
+#define EPS_int64 0.0
+#define EPS_float FLT_EPSILON
+#define EPS_double DBL_EPSILON
+#define EPS_cdouble DBL_EPSILON
+#define EPS_int8 0.0
+#define EPS_int16 0.0
+
+/*
+ * Element j of the random vector of a trial: any 32 or 64 bits for the
+ * integers, reals in [-1, 1).
+ */
+#define UNIT(h) ((double)((h) >> 11) * 0x1p-52 - 1.0)
+#define RANDOM_int(seed, j) ((unsigned int)matrix_dist_hash(seed, j))
+#define RANDOM_int64(seed, j) matrix_dist_hash(seed, j)
+#define RANDOM_float(seed, j) UNIT(matrix_dist_hash(seed, j))
+#define RANDOM_double(seed, j) UNIT(matrix_dist_hash(seed, j))
+#define RANDOM_cdouble(seed, j) CMPLX(UNIT(matrix_dist_hash(seed, 2 * (j))), \
+                                      UNIT(matrix_dist_hash(seed, 2 * (j) + 1)))
+#define RANDOM_int8 RANDOM_int
+#define RANDOM_int16 RANDOM_int
+
+/*
+ * Comparison of two results: whether they differ, by how much relative to
+ * the bound of their difference, and how the elements add up. Integers
+ * count the differing elements, reals keep the largest relative one.
+ */
+#define DIFF_int(x, y) ((x) != (y))
+#define DIFF_int64(x, y) ((x) != (y))
+#define DIFF_float(x, y) ((x) != (y))
+#define DIFF_double(x, y) ((x) != (y))
+#define DIFF_cdouble(x, y) ((x) != (y))
+#define DIFF_int8 DIFF_int
+#define DIFF_int16 DIFF_int
+
+#define RATIO_int(x, y, b) ((void)(b), 1.0)
+#define RATIO_int64(x, y, b) ((void)(b), 1.0)
+#define RATIO_float(x, y, b) (fabs((x) - (y)) / (b))
+#define RATIO_double(x, y, b) (fabs((x) - (y)) / (b))
+#define RATIO_cdouble(x, y, b) (cabs((x) - (y)) / creal(b))
+#define RATIO_int8 RATIO_int
+#define RATIO_int16 RATIO_int
+
+#define WORST_int(w, d) ((w) + (d))
+#define WORST_int64(w, d) ((w) + (d))
+#define WORST_float(w, d) ((d) > (w) ? (d) : (w))
+#define WORST_double(w, d) ((d) > (w) ? (d) : (w))
+#define WORST_cdouble(w, d) ((d) > (w) ? (d) : (w))
+#define WORST_int8 WORST_int
+#define WORST_int16 WORST_int
+
+/*
+ * Magnitude of an element, for the rounding error bound of the real types.
+ */
+#define ABS_int(x) (x)
+#define ABS_int64(x) (x)
+#define ABS_float(x) fabs(x)
+#define ABS_double(x) fabs(x)
+#define ABS_cdouble(x) cabs(x)
+#define ABS_int8 ABS_int
+#define ABS_int16 ABS_int
+
+/*
+ * Per type: y += X x over the local array of elements of type t in the
+ * distribution d, dense or, with s, a sparse block, or |X| x with absolute,
+ * where x has an element per local column and y per local row; filling r
+ * and |r| with the vector of seed at the local columns of d; and comparing
+ * two results: the number of differing elements for the integers, the
+ * largest difference relative to its bound for reals.
+ */
+#define VERIFY_FUNCTIONS(id, type, mpi)                                     \
+    static void matvec_##id(const struct matrix_type *t,                   \
+                            const struct matrix_dist *d, const void *local, \
+                            const struct matrix_sparse *s, const void *x,   \
+                            void *y, int absolute)                          \
+    {                                                                       \
+        const VEC_##id *lx = x;                                             \
+        VEC_##id *ly = y, sum;                                              \
+        const type *a = s != NULL ? matrix_sparse_values(s) : local;        \
+        const int *row_ptr = NULL, *col_idx = NULL;                         \
+        int i, e;                                                           \
+                                                                            \
+        if (s != NULL && !s->dense) {                                       \
+            row_ptr = matrix_sparse_row_ptr(s, t);                          \
+            col_idx = matrix_sparse_col_idx(s, t);                          \
+        }                                                                   \
+        for (i = 0; i < d->local_rows; ++i) {                               \
+            const type *row = row_ptr != NULL ? &a[row_ptr[i]]              \
+                            : &a[(size_t)i * d->local_cols];                \
+            const int n = row_ptr != NULL ? row_ptr[i + 1] - row_ptr[i]     \
+                        : d->local_cols;                                    \
+            const int *cols = row_ptr != NULL ? &col_idx[row_ptr[i]] : NULL; \
+            sum = 0;                                                        \
+            for (e = 0; e < n; ++e) {                                       \
+                const VEC_##id v = absolute ? (VEC_##id)ABS_##id(row[e])    \
+                                            : (VEC_##id)row[e];             \
+                sum += v * lx[cols != NULL ? cols[e] : e];                  \
+            }                                                               \
+            ly[i] += sum;                                                   \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static void random_##id(uint64_t seed, const struct matrix_dist *d,     \
+                            void *r, void *r_abs)                           \
+    {                                                                       \
+        VEC_##id *v = r, *v_abs = r_abs;                                    \
+        int j, g;                                                           \
+        for (j = 0; j < d->local_cols; ++j) {                               \
+            g = matrix_indxl2g(j, d->nb, d->mycol, d->pcols);               \
+            v[j] = RANDOM_##id(seed, (uint64_t)g);                          \
+            v_abs[j] = ABS_##id(v[j]);                                      \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static double compare_##id(int n, const void *z, const void *w,         \
+                               const void *bound)                           \
+    {                                                                       \
+        const VEC_##id *a = z, *b = w, *c = bound;                          \
+        double worst = 0.0, diff;                                           \
+        int i;                                                              \
+        for (i = 0; i < n; ++i) {                                           \
+            if (DIFF_##id(a[i], b[i]) == 0) {                               \
+                continue;                                                   \
+            }                                                               \
+            diff = RATIO_##id(a[i], b[i], c[i]);                            \
+            worst = WORST_##id(worst, diff);                                \
+        }                                                                   \
+        return worst;                                                       \
+    }
+MATRIX_TYPES(VERIFY_FUNCTIONS)
+MATRIX_QTYPES(VERIFY_FUNCTIONS)
+#undef VERIFY_FUNCTIONS
+
+/*
+ * The vector arithmetic of each element type, in the order of its ids.
+ */
+static const struct {
+    size_t size;
+    MPI_Datatype mpi;
+    double eps;
+    void (*matvec)(const struct matrix_type *t, const struct matrix_dist *d,
+                   const void *local, const struct matrix_sparse *s,
+                   const void *x, void *y, int absolute);
+    void (*random)(uint64_t seed, const struct matrix_dist *d, void *r,
+                   void *r_abs);
+    double (*compare)(int n, const void *z, const void *w, const void *bound);
+} ops[] = {
+#define VERIFY_OPS(id, type, mpi) \
+    { sizeof(VEC_##id), VEC_MPI_##id, EPS_##id, matvec_##id, random_##id, \
+      compare_##id },
+    MATRIX_TYPES(VERIFY_OPS)
+    MATRIX_QTYPES(VERIFY_OPS)
+#undef VERIFY_OPS
+};
+
+/*
+ * The move of B r from the process rows that sum it to the process columns
+ * that multiply A by it. Each process contributes the elements of its rows
+ * of B whose columns of A its process column owns, and an allgather along
+ * the process column gives every process all of its own: send lists the
+ * local rows of B it contributes, counts and displs the contributions of
+ * the column, and place the position of each local column of A in them.
+ */
+struct redistribution {
+    int count;
+    int *send;
+    int *counts, *displs;
+    int *place;
+};
+
+/*
+ * Work out the redistribution of the inner dimension from the rows of
+ * dist_B to the columns of dist_A, over the process column col_comm, ranked
+ * by process row.
+ */
+static void redistribution_init(struct redistribution *rd,
+                                const struct matrix_dist *dist_A,
+                                const struct matrix_dist *dist_B,
+                                MPI_Comm col_comm)
+{
+    int *next;
+    int procs, offset, p, l, j, g;
+
+    MPI_Comm_size(col_comm, &procs);
+    rd->send = malloc(((size_t)dist_B->local_rows + 1) * sizeof(int));
+    rd->place = malloc(((size_t)dist_A->local_cols + 1) * sizeof(int));
+    rd->counts = malloc(procs * sizeof(int));
+    rd->displs = malloc(procs * sizeof(int));
+    next = malloc(procs * sizeof(int));
+    assert(rd->send != NULL && rd->place != NULL && rd->counts != NULL
+           && rd->displs != NULL && next != NULL);
+
+    rd->count = 0;
+    for (l = 0; l < dist_B->local_rows; ++l) {
+        g = matrix_indxl2g(l, dist_B->nb, dist_B->myrow, dist_B->prows);
+        if ((g / dist_A->nb) % dist_A->pcols == dist_A->mycol) {
+            rd->send[rd->count++] = l;
+        }
+    }
+    MPI_Allgather(&rd->count, 1, MPI_INT, rd->counts, 1, MPI_INT, col_comm);
+    for (p = 0, offset = 0; p < procs; ++p) {
+        rd->displs[p] = next[p] = offset;
+        offset += rd->counts[p];
+    }
+    assert(offset == dist_A->local_cols);
+
+    // Every process row contributes its elements in ascending order
+    for (j = 0; j < dist_A->local_cols; ++j) {
+        g = matrix_indxl2g(j, dist_A->nb, dist_A->mycol, dist_A->pcols);
+        p = (g / dist_B->nb) % dist_B->prows;
+        rd->place[j] = next[p]++;
+    }
+    free(next);
+}
+
+/*
+ * Move vectors of elements of size bytes, held one after another in y at
+ * the n_y rows of B of this process, to x at its n_x columns of A. packed
+ * and gathered have room for vectors elements per contribution and per
+ * column; pair is the datatype of vectors elements.
+ */
+static void redistribute(const struct redistribution *rd, size_t size,
+                         int vectors, MPI_Datatype pair, const char *y,
+                         int n_y, char *x, int n_x, char *packed,
+                         char *gathered, MPI_Comm col_comm)
+{
+    int i, v;
+
+    for (i = 0; i < rd->count; ++i) {
+        for (v = 0; v < vectors; ++v) {
+            memcpy(packed + ((size_t)i * vectors + v) * size,
+                   y + ((size_t)v * n_y + rd->send[i]) * size, size);
+        }
+    }
+    MPI_Allgatherv(packed, rd->count, pair, gathered, rd->counts, rd->displs,
+                   pair, col_comm);
+    for (i = 0; i < n_x; ++i) {
+        for (v = 0; v < vectors; ++v) {
+            memcpy(x + ((size_t)v * n_x + i) * size,
+                   gathered + ((size_t)rd->place[i] * vectors + v) * size,
+                   size);
+        }
+    }
+}
+
+/*
+ * Free the lists of a redistribution.
+ */
+static void redistribution_free(struct redistribution *rd)
+{
+    free(rd->send);
+    free(rd->place);
+    free(rd->counts);
+    free(rd->displs);
+}
+
+/*
+ * Run the trials on dense or sparse A and B. Each one forms B r on the rows
+ * of B, summed along the process rows, moves it to the columns of A, then
+ * forms A (B r) and C r side by side, so that one more sum along the
+ * process rows completes both, and for the real types the bound |A| |B| |r|
+ * along with them. Every process row compares its own rows of C, and the
+ * process columns combine the outcomes.
+ */
+static int verify(const struct matrix_type *type,
+                  const struct matrix_dist *dist_A, const void *local_A,
+                  const struct matrix_sparse *sparse_A,
+                  const struct matrix_dist *dist_B, const void *local_B,
+                  const struct matrix_sparse *sparse_B,
+                  const struct matrix_dist *dist_C, const void *local_C,
+                  int trials, uint64_t seed, MPI_Comm comm, double *error)
+{
+    const int K = dist_A->cols;
+    const int n_r = dist_B->local_cols, n_s = dist_C->local_cols;
+    const int n_y = dist_B->local_rows, n_x = dist_A->local_cols;
+    const int n_z = dist_C->local_rows;
+    const size_t size = ops[type->id].size;
+    const MPI_Datatype mpi = ops[type->id].mpi;
+    const double eps = ops[type->acc->id].eps;
+    const int vectors = eps > 0.0 ? 2 : 1;
+    struct redistribution rd;
+    MPI_Comm row_comm, col_comm;
+    MPI_Datatype pair;
+    char *r, *s, *y, *x, *zw, *packed, *gathered;
+    double diff;
+    int t, failed = 0;
+
+    // C shares its rows with A and its columns with B
+    assert(dist_A->local_rows == n_z && n_r == n_s);
+
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, comm);
+    MPI_Comm_split(comm, dist_C->myrow, dist_C->mycol, &row_comm);
+    MPI_Comm_split(comm, dist_C->mycol, dist_C->myrow, &col_comm);
+    MPI_Type_contiguous(vectors, mpi, &pair);
+    MPI_Type_commit(&pair);
+    redistribution_init(&rd, dist_A, dist_B, col_comm);
+
+    // Every vector has the length of the local blocks it meets
+    r = malloc((2 * (size_t)n_r + 1) * size);
+    s = malloc((2 * (size_t)n_s + 1) * size);
+    y = malloc((2 * (size_t)n_y + 1) * size);
+    x = malloc((2 * (size_t)n_x + 1) * size);
+    zw = malloc((3 * (size_t)n_z + 1) * size);
+    packed = malloc((2 * (size_t)rd.count + 1) * size);
+    gathered = malloc((2 * (size_t)n_x + 1) * size);
+    assert(r != NULL && s != NULL && y != NULL && x != NULL && zw != NULL
+           && packed != NULL && gathered != NULL);
+
+    *error = 0.0;
+    for (t = 0; t < trials; ++t) {
+        ops[type->id].random(seed + (uint64_t)t, dist_B, r,
+                             r + (size_t)n_r * size);
+        ops[type->id].random(seed + (uint64_t)t, dist_C, s,
+                             s + (size_t)n_s * size);
+
+        memset(y, 0, 2 * (size_t)n_y * size);
+        ops[type->id].matvec(type, dist_B, local_B, sparse_B, r, y, 0);
+        if (eps > 0.0) {
+            ops[type->id].matvec(type, dist_B, local_B, sparse_B,
+                                 r + (size_t)n_r * size, y + (size_t)n_y * size,
+                                 1);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, y, vectors * n_y, mpi, MPI_SUM, row_comm);
+        redistribute(&rd, size, vectors, pair, y, n_y, x, n_x, packed,
+                     gathered, col_comm);
+
+        memset(zw, 0, 3 * (size_t)n_z * size);
+        ops[type->id].matvec(type, dist_A, local_A, sparse_A, x, zw, 0);
+        ops[type->acc->id].matvec(type->acc, dist_C, local_C, NULL, s,
+                                  zw + (size_t)n_z * size, 0);
+        if (eps > 0.0) {
+            ops[type->id].matvec(type, dist_A, local_A, sparse_A,
+                                 x + (size_t)n_x * size,
+                                 zw + 2 * (size_t)n_z * size, 1);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, zw, (vectors + 1) * n_z, mpi, MPI_SUM,
+                      row_comm);
+
+        // Integers add up the differing elements, reals keep the largest
+        diff = ops[type->id].compare(n_z, zw, zw + (size_t)n_z * size,
+                                     zw + 2 * (size_t)n_z * size);
+        MPI_Allreduce(MPI_IN_PLACE, &diff, 1, MPI_DOUBLE,
+                      eps > 0.0 ? MPI_MAX : MPI_SUM, col_comm);
+        failed += eps > 0.0 ? diff > 4.0 * sqrt((double)K) * eps : diff > 0.0;
+        if (diff > *error) {
+            *error = diff;
+        }
+    }
+
+    free(r);
+    free(s);
+    free(y);
+    free(x);
+    free(zw);
+    free(packed);
+    free(gathered);
+    redistribution_free(&rd);
+    MPI_Type_free(&pair);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    return failed;
+}
+
+int matrix_verify(const struct matrix_type *type,
+                  const struct matrix_dist *dist_A, const void *local_A,
+                  const struct matrix_dist *dist_B, const void *local_B,
+                  const struct matrix_dist *dist_C, const void *local_C,
+                  int trials, uint64_t seed, MPI_Comm comm, double *error)
+{
+    return verify(type, dist_A, local_A, NULL, dist_B, local_B, NULL, dist_C,
+                  local_C, trials, seed, comm, error);
+}
+
+int matrix_verify_sparse(const struct matrix_type *type,
+                         const struct matrix_dist *dist_A,
+                         const struct matrix_sparse *local_A,
+                         const struct matrix_dist *dist_B,
+                         const struct matrix_sparse *local_B,
+                         const struct matrix_dist *dist_C, const void *local_C,
+                         int trials, uint64_t seed, MPI_Comm comm,
+                         double *error)
+{
+    return verify(type, dist_A, NULL, local_A, dist_B, NULL, local_B, dist_C,
+                  local_C, trials, seed, comm, error);
+}
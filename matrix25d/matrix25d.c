@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/context.h"
+#include "libmatrix/dist.h"
+#include "libmatrix/program.h"
+
+void describe(const struct matrix_program_run *run,
+              const struct matrix_context *ctx);
+void report(const struct matrix_program_run *run,
+            const struct matrix_program_times *times);
+int max_replicas(int procs);
+int parse_option(struct matrix_options *opts, int c, const char *arg);
+
+/*
+ * Options of the 2.5D algorithm, listed among the shared options of
+ * libmatrix.
+ */
+static const struct matrix_program_option matrix25d_options[] = {
+    { "replicas", required_argument, 'c',
+      "    --replicas|-c:    layers c of copies of A and B, where np must be\n"
+      "                      c * q * q with c dividing q (default: the most\n"
+      "                      layers that fit np)\n" },
+    { "shift", required_argument, 's',
+      "    --shift|-s:       block shifts: overlap (default) posts nonblocking\n"
+      "                      shifts into a second buffer pair during the\n"
+      "                      multiply, blocking uses MPI_Sendrecv\n" },
+    { NULL, 0, 0, NULL }
+};
+
+static const struct matrix_program program = {
+    "matrix25d",
+    MATRIX_25D,
+    0,
+    matrix25d_options,
+    parse_option,
+    NULL,
+    describe,
+    report
+};
+
+/*
+ * Read a file of an M x K and a K x N matrix and multiply them in parallel
+ * using the 2.5D algorithm. The np processes form c layers of q x q grids,
+ * np = c * q * q, where c divides q. Layer 0 holds A, B and C distributed
+ * 2D block-cyclically as in Cannon's generalized algorithm. It broadcasts A
+ * and B to the other layers; layer l then skews its copy as Cannon's
+ * algorithm would after l * q / c steps and runs the next q / c steps, and
+ * the partial products of all layers are summed into C on layer 0.
+ *
+ * Each layer shifts only 1/c of the blocks Cannon's algorithm shifts on a
+ * q x q grid, so adding layers cuts the bandwidth per process at the cost
+ * of c copies of A and B. c = 1 is Cannon's algorithm and c = np^(1/3) the
+ * 3D algorithm, in which every layer runs a single step.
+ *
+ * If 1 process is indicated, sequential multiplication is used which can be
+ * useful for reference to the parallel algorithm.
+ *
+ * Example:
+ *
+ * Two 6x6 matrices may be multiplied sequentially with np = 1, on np = 4
+ * as Cannon's algorithm on one 2x2 grid (3x3 blocks), or on np = 8 as 2
+ * layers of 2x2 grids, each running 1 of the 2 steps. np = 64 gives 4
+ * layers of 4x4 grids by default, the 3D algorithm, or with --replicas 1 a
+ * single 8x8 grid.
+ */
+int main(int argc, char *argv[])
+{
+    struct matrix_program_run run;
+    struct matrix_config config;
+
+    if (matrix_program_start(&program, &argc, &argv, &run) != 0) {
+        return matrix_program_finish(&run);
+    }
+
+    if (run.procs == 1) {
+        matrix_program_sequential(&run);
+    } else {
+        // The context stacks the layers of process grids and sets up the
+        // distributions of A, B and C, the copies of the other layers and
+        // the shift buffers
+        matrix_program_config(&run.opts, MATRIX_25D, run.type, run.M, run.K,
+                              run.N, &config);
+        config.replicas = run.opts.replicas > 0 ? run.opts.replicas
+                        : max_replicas(run.procs);
+        matrix_program_parallel(&run, &config);
+    }
+    return matrix_program_finish(&run);
+}
+
+
+/*
+ * Print the blocks of the distributed matrices and the layers of grids.
+ */
+void describe(const struct matrix_program_run *run,
+              const struct matrix_context *ctx)
+{
+    const struct matrix_dist *dist_C = matrix_context_dist(ctx, 2);
+
+    printf("Distributed the %dx%d and %dx%d matrices on %d processes "
+           "in %dx%d blocks.\n", run->M, run->K, run->K, run->N, run->procs,
+           dist_C->nb, dist_C->nb);
+    printf("Using %d layers of %dx%d process grids.\n",
+           matrix_context_layers(ctx), dist_C->prows, dist_C->pcols);
+    if (matrix_context_persistent(ctx)) {
+        printf("Shifting blocks with persistent requests.\n");
+    }
+}
+
+/*
+ * Print the time of the multiply and its shifts.
+ */
+void report(const struct matrix_program_run *run,
+            const struct matrix_program_times *times)
+{
+    printf("Multiply and shift time: %.6f seconds with %s shifts.\n",
+           times->loop, run->opts.overlap ? "overlapped" : "blocking");
+}
+
+/*
+ * Return the most layers c that np processes can form, with np = c * q * q
+ * and c dividing q. 1 layer always fits a perfect square.
+ */
+int max_replicas(int procs)
+{
+    int c, q, best = 1;
+
+    for (c = 2; c * c * c <= procs; ++c) {
+        q = (int)(sqrt(procs / c) + 0.5);
+        if (q * q * c == procs && q % c == 0) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+/*
+ * Parse an option of the 2.5D algorithm. Returns nonzero if arg is invalid.
+ */
+int parse_option(struct matrix_options *opts, int c, const char *arg)
+{
+    switch (c) {
+        case 'c':
+            opts->replicas = atoi(arg);
+            if (opts->replicas <= 0) {
+                return 1;
+            }
+            break;
+        case 's':
+            if (strcmp(arg, "overlap") == 0) {
+                opts->overlap = 1;
+            } else if (strcmp(arg, "blocking") == 0) {
+                opts->overlap = 0;
+            } else {
+                return 1;
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
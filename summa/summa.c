@@ -27,362 +27,302 @@
 #include "config.h"
 #endif
 
-#include <assert.h>
-#include <errno.h>
 #include <getopt.h>
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <mpi.h>
 
-#ifdef HAVE_ATTRIBUTE_CLEANUP
-#define AUTO_PTR(fn) __attribute__((cleanup(fn)))
-#else
-#define AUTO_PTR(fn)
-#endif
+#include "libmatrix/context.h"
+#include "libmatrix/dist.h"
+#include "libmatrix/ooc.h"
+#include "libmatrix/program.h"
+#include "libmatrix/threads.h"
+
+int multiply_ooc(const struct matrix_options *opts,
+                 const struct matrix_type *type, int M, int K, int N);
 
-void free_buffer(int **A);
-void initialize(int argc, char *argv[], int *N, int **A, int **B, int **C);
-void matrix_mult(int N, int *A, int *B, int *C);
-void matrix_read(FILE *fp, int *N, int **A, int **B);
-void matrix_print(const char *desc, int N, int *A);
+void describe(const struct matrix_program_run *run,
+              const struct matrix_context *ctx);
+void report(const struct matrix_program_run *run,
+            const struct matrix_program_times *times);
+int parse_option(struct matrix_options *opts, int c, const char *arg);
+int check_options(const struct matrix_options *opts);
 
 /*
- * Print program usage.
+ * Options of SUMMA, listed among the shared options of libmatrix.
  */
-void usage()
-{
-    fprintf(stderr, "usage: summa <options>\n"
-                    "  Options are:\n"
-                    "    --help|-h:        print this help\n"
-                    "    --matrix|-m:      matrix input file\n"
-    );
-}
+static const struct matrix_program_option summa_options[] = {
+    { "panel", required_argument, 'w',
+      "    --panel|-w:       panel width (default: the block size)\n" },
+    { "shared", required_argument, 'S',
+      "    --shared|-S:      share A and B in memory between the ranks of a\n"
+      "                      node (0) or of groups of this many ranks, and\n"
+      "                      broadcast panels between nodes only\n" },
+    { "engine", required_argument, 'e',
+      "    --engine|-e:      panel transfers: bcast (default) broadcasts each\n"
+      "                      panel along its row and column, rma fetches\n"
+      "                      panels one-sided with MPI_Rget\n" },
+    { "slow", required_argument, 'x',
+      "    --slow|-x:        run the local multiply of this rank with the\n"
+      "                      scalar micro-kernel, to compare the engines\n"
+      "                      under an imbalanced load\n" },
+    { "memory", required_argument, 'M',
+      "    --memory|-M:      out-of-core mode: stream A and B from a binary\n"
+      "                      matrix file and C to a binary --output file\n"
+      "                      using at most this many MiB per process\n" },
+    { NULL, 0, 0, NULL }
+};
+
+static const struct matrix_program program = {
+    "summa",
+    MATRIX_SUMMA,
+    MATRIX_PROGRAM_GRID | MATRIX_PROGRAM_SPARSE | MATRIX_PROGRAM_BATCH
+    | MATRIX_PROGRAM_PROFILE,
+    summa_options,
+    parse_option,
+    check_options,
+    describe,
+    report
+};
 
 /*
- * Read a file of two square (N x N) matrices and multiply them in parallel
- * using the Summa block algorithm. The number of processes assigned must be
- * in the range [1 <= np <= N*N] where np is a perfect square and N/sqrt(np)
- * is an integral number.
+ * Read a file of an M x K and a K x N matrix and multiply them in parallel
+ * using the Summa block algorithm. Any number of processes np is arranged as
+ * a prows x pcols grid, as square as possible unless --grid gives its shape.
  *
  * If 1 process is indicated, sequential multiplication is used which can be
  * useful for reference to the parallel algorithm.
  *
- * If N*N is indicated, each cell of the resultant matrix is assigned a single
- * process.
+ * The matrices are distributed 2D block-cyclically: they are cut into
+ * nb x nb blocks, dealt out round-robin along both grid dimensions, and each
+ * process packs the blocks it owns into one local matrix. Any M, K and N
+ * work; ragged edge blocks are stored at their real size.
  *
- * If np is indicated, a submatrix (block) of size N/sqrt(np) x N/sqrt(np)
- * is assigned to each process.
+ * The inner dimension is processed in panels of a chosen width that need not
+ * match the block size. The broadcasts of the next panel are in flight while
+ * the current panel is multiplied.
  *
  * Example:
  *
  * Two 6x6 matrices may be multiplied sequentially with np = 1 or in parallel
  * with np = 4 (4 blocks of 3x3); np = 9 (9 blocks of 2x2); or np = 36
- * (1 cell per process).
+ * (1 cell per process). Two 7x7 matrices may use np = 4 with blocks of 2x2
+ * (--block 2), giving processes 4x4, 4x3, 3x4 and 3x3 local matrices. On
+ * np = 6 the grid is 3x2 (or 2x3 with --grid 2x3), and the default block
+ * size of 2 gives processes 2x4 and 2x2 local matrices of C.
  */
 int main(int argc, char *argv[])
 {
-    // Rank 0 matrices
-    AUTO_PTR(free_buffer) int *A = NULL;
-    AUTO_PTR(free_buffer) int *B = NULL;
-    AUTO_PTR(free_buffer) int *C = NULL;
-
-    // Local submatrices
-    AUTO_PTR(free_buffer) int *local_A = NULL;
-    AUTO_PTR(free_buffer) int *local_B = NULL;
-    AUTO_PTR(free_buffer) int *local_C = NULL;
-
-    AUTO_PTR(free_buffer) int *local_A_save = NULL;
-    AUTO_PTR(free_buffer) int *local_B_save = NULL;
-
-    int N = 0;
-    int i;
-    int rank, rank_row, rank_col;
-    int procs;
-    const int periods[2] = { 1, 1 };
-    const int starts[2] = { 0, 0 };
-    const int reorder = 1;
-    const int cart_row_dims[2] = { 1, 0 };
-    const int cart_col_dims[2] = { 0, 1 };
-    MPI_Comm cart_comm, cart_row_comm, cart_col_comm;
-    MPI_Datatype block_t, resized_block_t;
-
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &procs);
-
-    if (rank == 0) {
-        initialize(argc, argv, &N, &A, &B, &C);
-        if (procs == 1) {
-            // Use sequential multiplication if just 1 proc
-            printf("Using sequential multiplication on 1 process.\n");
-            matrix_print("Matrix A", N, A);
-            matrix_print("Matrix B", N, B);
-            matrix_mult(N, A, B, C);
-            matrix_print("Matrix C", N, C);
-        }
-    }
-
-    if (procs == 1) {
-        MPI_Finalize();
-        return 0;
-    }
-
-    // Number of processes must be a perfect square
-    const double fprocs_sqrt = sqrt(procs);
-    const int procs_sqrt = fprocs_sqrt;
-    if (procs_sqrt != fprocs_sqrt) {
-        if (rank == 0) {
-            fprintf(stderr, "Number of processes (%d) is not a perfect square\n", procs);
-        }
-        MPI_Finalize();
-        return 0;
-    }
-
-    // Broadcast N, the matrix dimension, to all processes
-    MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-    // Matrices must be partitioned into equal sized blocks
-    if (N % procs_sqrt != 0) {
-        if (rank == 0) {
-            fprintf(stderr, "Cannot partition %dx%d matrices on %d processes. "
-                    "Ensure N/SQRT(processes) is an integral number.\n", N, N, procs);
-        }
-        MPI_Finalize();
-        return 0;
-    }
-
-    // Runtime knowledge
-    const int N_sub = N / procs_sqrt;
-    const int N_sub_squared = N_sub * N_sub;
-    const int array_sizes[2] = { N, N };
-    const int block_sizes[2] = { N_sub, N_sub };
-    const int cart_dims[2] = { procs_sqrt, procs_sqrt };
-    AUTO_PTR(free_buffer) int *block_counts = calloc(procs, sizeof(int));
-    AUTO_PTR(free_buffer) int *block_displs = calloc(procs, sizeof(int));
-
-    // One block per process
-    for (i = 0; i < procs; ++i) {
-        block_counts[i] = 1;
-    }
-
-    // The starting extents of each block
-    for (i = 0; i < procs; ++i) {
-        int row = i / procs_sqrt;
-        int col = i % procs_sqrt;
-        block_displs[i] = row * N_sub * procs_sqrt + col;
-    }
-
-    // Create subarray type to scatter blocks with one message
-    MPI_Type_create_subarray(2, array_sizes, block_sizes, starts, MPI_ORDER_C,
-                             MPI_INT, &block_t);
-    MPI_Type_create_resized(block_t, 0, N_sub * sizeof(int), &resized_block_t);
-    MPI_Type_commit(&resized_block_t);
-
-    // Use a cartesian process topology with subtopologies for rows and cols
-    MPI_Cart_create(MPI_COMM_WORLD, 2, cart_dims, periods, reorder, &cart_comm);
-    MPI_Cart_sub(cart_comm, cart_row_dims, &cart_row_comm);
-    MPI_Cart_sub(cart_comm, cart_col_dims, &cart_col_comm);
-    MPI_Comm_rank(cart_comm, &rank);
-    MPI_Comm_rank(cart_row_comm, &rank_row);
-    MPI_Comm_rank(cart_col_comm, &rank_col);
-
-    // Allocate local submatrices (blocks)
-    local_A = calloc(N_sub_squared, sizeof(*local_A));
-    local_B = calloc(N_sub_squared, sizeof(*local_B));
-    local_C = calloc(N_sub_squared, sizeof(*local_C));
-    local_A_save = calloc(N_sub_squared, sizeof(*local_A));
-    local_B_save = calloc(N_sub_squared, sizeof(*local_B));
-
-    // Rank 0 scatters blocks of size N_sub x N_sub to all processes
-    MPI_Scatterv(A, block_counts, block_displs, resized_block_t,
-                 local_A, N_sub_squared, MPI_INT, 0, cart_comm);
-    MPI_Scatterv(B, block_counts, block_displs, resized_block_t,
-                 local_B, N_sub_squared, MPI_INT, 0, cart_comm);
-
-    // Save originally scattered local blocks so we can restore them for bcasts
-    memcpy(local_A_save, local_A, N_sub_squared * sizeof(*local_A));
-    memcpy(local_B_save, local_B, N_sub_squared * sizeof(*local_B));
+    struct matrix_program_run run;
+    struct matrix_config config;
 
-    if (rank == 0) {
-        printf("Partitioned the %dx%d matrices on %d processes of %dx%d each.\n",
-               N, N, procs, N_sub, N_sub);
-        matrix_print("Matrix A", N, A);
-        matrix_print("Matrix B", N, B);
+    if (matrix_program_start(&program, &argc, &argv, &run) != 0) {
+        return matrix_program_finish(&run);
     }
 
-    // Each process broadcasts and then accumulates its local data
-    for (i = 0; i < procs_sqrt; ++i) {
-        if (rank_col == i) {
-            // Restore original local A for bcast
-            memcpy(local_A, local_A_save, N_sub_squared * sizeof(*local_A));
-        }
-        // Broadcast A to all columns
-        MPI_Bcast(local_A, N_sub_squared, MPI_INT, i, cart_col_comm);
-
-        if (rank_row == i) {
-            // Restore original local B for bcast
-            memcpy(local_B, local_B_save, N_sub_squared * sizeof(*local_B));
-        }
-        // Broadcast B to all rows
-        MPI_Bcast(local_B, N_sub_squared, MPI_INT, i, cart_row_comm);
-
-        // Multiply and accumulate local block
-        matrix_mult(N_sub, local_A, local_B, local_C);
+    // Out-of-core mode streams everything through the file system instead;
+    // sparse matrices always take the parallel path, which handles 1 process
+    if (run.opts.memory > 0) {
+        run.status = multiply_ooc(&run.opts, run.type, run.M, run.K, run.N);
+    } else if (run.procs == 1 && !run.opts.sparse) {
+        matrix_program_sequential(&run);
+    } else {
+        // The context sets up the process grid, the distributions of A, B
+        // and C and the panel buffers
+        matrix_program_config(&run.opts, MATRIX_SUMMA, run.type, run.M,
+                              run.K, run.N, &config);
+        matrix_program_parallel(&run, &config);
     }
+    return matrix_program_finish(&run);
+}
 
-    // Rank 0 gathers the final C matrix from all process local_C blocks
-    MPI_Gatherv(local_C, N_sub_squared, MPI_INT, C, block_counts,
-                block_displs, resized_block_t, 0, cart_comm);
 
-    if (rank == 0) {
-        matrix_print("Matrix C", N, C);
+/*
+ * Print the grid and blocks of the distributed matrices and how panels
+ * reach the processes.
+ */
+void describe(const struct matrix_program_run *run,
+              const struct matrix_context *ctx)
+{
+    const struct matrix_dist *dist_C = matrix_context_dist(ctx, 2);
+
+    printf("Distributed the %dx%d and %dx%d matrices on a %dx%d grid of "
+           "%d processes in %dx%d blocks.\n", run->M, run->K, run->K, run->N,
+           dist_C->prows, dist_C->pcols, run->procs, dist_C->nb, dist_C->nb);
+    printf("%s panels of width %d.\n", run->opts.rma ? "Fetching"
+           : "Broadcasting", matrix_context_panel(ctx));
+    if (matrix_context_persistent(ctx)) {
+        printf("Using persistent broadcasts.\n");
     }
-
-    MPI_Type_free(&resized_block_t);
-    MPI_Finalize();
-
-#ifndef HAVE_ATTRIBUTE_CLEANUP
-    if (rank == 0) {
-        free(A);
-        free(B);
-        free(C);
+    if (run->opts.shared) {
+        printf("Sharing blocks in memory between %d ranks per node.\n",
+               matrix_context_node_ranks(ctx));
     }
-    free(local_A);
-    free(local_B);
-    free(local_C);
-    free(local_A_save);
-    free(local_B_save);
-    free(block_count);
-    free(block_displs);
-#endif
-
-    return 0;
 }
 
-
 /*
- * Free a buffer.
+ * Print the time of the multiply and its transfers, and how much the
+ * fastest and the mean process waited for the slowest.
  */
-void free_buffer(int **A)
+void report(const struct matrix_program_run *run,
+            const struct matrix_program_times *times)
 {
-    free (*A);
+    printf("Multiply and %s time: %.6f seconds.\n",
+           run->opts.rma ? "fetch" : "broadcast", times->loop);
+    printf("Loop times: min %.6f, mean %.6f, max %.6f seconds.\n",
+           times->min_loop, times->mean_loop, times->loop);
 }
 
 /*
- * Initialize rank 0 only: parse options, read and set up matrices.
+ * Parse an option of SUMMA. Returns nonzero if arg is invalid.
  */
-void initialize(int argc, char *argv[], int *N, int **A, int **B, int **C)
+int parse_option(struct matrix_options *opts, int c, const char *arg)
 {
-    FILE *fp = NULL;
-    char filename[256];
-    int c, help = 0;
-
-    memset(filename, '\0', sizeof(filename));
-
-    while (1) {
-        static struct option long_options[] = {
-            {"help",       no_argument,       0, 'h' },
-            {"matrix",     required_argument, 0, 'm' },
-            {0, 0, 0, 0}
-        };
-
-        int option_index = 0;
-        c = getopt_long(argc, argv, "hm:", long_options, &option_index);
-
-        if (c == -1)
+    switch (c) {
+        case 'w':
+            opts->panel = atoi(arg);
+            break;
+        case 'S':
+            opts->shared = 1;
+            opts->node_size = atoi(arg);
+            if (opts->node_size < 0) {
+                return 1;
+            }
+            break;
+        case 'e':
+            if (strcmp(arg, "bcast") == 0) {
+                opts->rma = 0;
+            } else if (strcmp(arg, "rma") == 0) {
+                opts->rma = 1;
+            } else {
+                return 1;
+            }
+            break;
+        case 'x':
+            opts->slow = atoi(arg);
+            break;
+        case 'M':
+            opts->memory = atoi(arg);
+            break;
+        default:
             break;
-
-        switch (c) {
-            case 'h':
-                help = 1;
-                break;
-            case 'm':
-                strncpy(filename, optarg, sizeof(filename)-1);
-                break;
-            default:
-                break;
-        }
-    }
-
-    if (help) {
-        usage();
-        exit(0);
-    }
-    if (filename[0] == '\0') {
-        usage();
-        exit(2);
-    }
-
-    fp = fopen(filename, "r");
-    if (fp == NULL) {
-        fprintf(stderr,"%s (%s)\n", strerror(errno), filename);
-        exit(1);
     }
-    matrix_read(fp, N, A, B);
-    fclose(fp);
-
-    *C = calloc(*N * *N, sizeof(*C));
-    assert(*C != NULL);
+    return 0;
 }
 
 /*
- * Multiply arrays A, B sequentially and accumulate result in C.
+ * Reject the options that SUMMA's transfers and out-of-core mode do not
+ * combine with. Returns nonzero after printing why.
  */
-void matrix_mult(int N, int *A, int *B, int *C)
+int check_options(const struct matrix_options *opts)
 {
-    int i, j, k;
-    for (i = 0; i < N; ++i) {
-        for (j = 0; j < N; ++j) {
-            for (k = 0; k < N; ++k) {
-                C[i*N+j] += A[i*N+k] * B[k*N+j];
-            }
-        }
+    if (opts->shared && opts->rma) {
+        fprintf(stderr, "--shared and --engine rma do not combine\n");
+        return 1;
     }
+    if (opts->sparse && (opts->shared || opts->rma)) {
+        fprintf(stderr, "Sparse matrices always use broadcasts\n");
+        return 1;
+    }
+    if (opts->memory <= 0) {
+        return 0;
+    }
+    if (opts->profile[0] != '\0') {
+        fprintf(stderr, "--profile applies to multiplies in memory, without --memory\n");
+        return 1;
+    }
+    if (opts->batch[0] != '\0') {
+        fprintf(stderr, "--batch takes its output files from the manifest\n");
+        return 1;
+    }
+    if (opts->verify > 0) {
+        fprintf(stderr, "--verify needs A, B and C in memory, without --memory\n");
+        return 1;
+    }
+    if (!opts->binary || opts->output[0] == '\0' || opts->text || opts->quiet) {
+        fprintf(stderr, "--memory needs a binary --matrix file and a binary "
+                        "--output file\n");
+        return 1;
+    }
+    return 0;
 }
 
 /*
- * Read N and two N x N integer matrices from file.
+ * Multiply out of core: every process of a prows x pcols grid computes
+ * its blocks of C a tile at a time, streaming the panels of A and B it needs
+ * from the matrix file and the finished tiles to the output file, within
+ * the memory budget. The processes do not communicate; each reads the
+ * panels that SUMMA would otherwise broadcast. Returns the exit status 2 if
+ * the processes do not fit the grid, otherwise 0.
  */
-void matrix_read(FILE *fp, int *N, int **A, int **B)
+int multiply_ooc(const struct matrix_options *opts,
+                 const struct matrix_type *type, int M, int K, int N)
 {
-    int i;
-    int N_squared = 0;
-
-    fscanf(fp, "%d", N);
-    assert((N != NULL) && (*N >= 1) && (*N <= 1000));
-    N_squared = *N * *N;
-
-    *A = calloc(N_squared, sizeof(**A));
-    assert(*A != NULL);
+    char error[MPI_MAX_ERROR_STRING];
+    struct matrix_ooc_stats stats;
+    struct matrix_dist dist_C;
+    double start, loop_time;
+    double max_compute_time = 0.0, max_wait_time = 0.0, max_loop_time = 0.0;
+    int procs, rank, rc, len;
+    int prows = opts->prows, pcols = opts->pcols;
+    int coords[2];
+    const int periods[2] = { 0, 0 };
+    MPI_Comm cart_comm;
 
-    *B = calloc(N_squared, sizeof(**B));
-    assert(*B != NULL);
-
-    i = 0;
-    while(i < N_squared) {
-        fscanf(fp, "%d", &(*A)[i]);
-        ++i;
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (matrix_dist_grid(procs, &prows, &pcols) != 0) {
+        if (rank == 0) {
+            fprintf(stderr, "Number of processes (%d) does not fit a %dx%d grid\n",
+                    procs, opts->prows, opts->pcols);
+        }
+        return 2;
     }
 
-    i = 0;
-    while(i < N_squared) {
-        fscanf(fp, "%d", &(*B)[i]);
-        ++i;
+    const int cart_dims[2] = { prows, pcols };
+    const int nb = opts->block > 0 ? opts->block
+                 : matrix_dist_block(M, K, N, prows, pcols);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, cart_dims, periods, 1, &cart_comm);
+    MPI_Comm_rank(cart_comm, &rank);
+    MPI_Cart_coords(cart_comm, rank, 2, coords);
+    matrix_dist_init(&dist_C, M, N, nb, prows, pcols, coords[0], coords[1]);
+
+    start = MPI_Wtime();
+    rc = matrix_ooc_gemm(opts->matrix, opts->output, type, &dist_C, K,
+                         (size_t)opts->memory << 20, cart_comm, &stats);
+    loop_time = MPI_Wtime() - start;
+    if (rc == MPI_ERR_NO_MEM) {
+        fprintf(stderr, "Rank %d cannot fit a tile in %d MiB\n", rank, opts->memory);
+        MPI_Abort(cart_comm, 1);
+    } else if (rc != MPI_SUCCESS) {
+        MPI_Error_string(rc, error, &len);
+        fprintf(stderr, "%s (%s, %s)\n", error, opts->matrix, opts->output);
+        MPI_Abort(cart_comm, 1);
     }
-}
 
-/*
- * Print a matrix.
- */
-void matrix_print(const char *desc, int N, int *A)
-{
-    printf("---- %s ----\n", desc);
-    int i, j;
-    for (i = 0; i < N; ++i) {
-        for (j = 0; j < N; ++j) {
-            printf("%5d%c", A[i*N+j], (j == N-1) ? '\n' : ' ');
-        }
+    // The slowest process bounds the multiply
+    MPI_Reduce(&stats.compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX,
+               0, cart_comm);
+    MPI_Reduce(&stats.wait_time, &max_wait_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+               cart_comm);
+    MPI_Reduce(&loop_time, &max_loop_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+               cart_comm);
+
+    if (rank == 0) {
+        printf("Streamed the %dx%d and %dx%d matrices out of core on a %dx%d "
+               "grid of %d processes in %dx%d blocks.\n", M, K, K, N, prows,
+               pcols, procs, nb, nb);
+        printf("Rank 0 used tiles of %dx%d and panels of width %d within "
+               "%d MiB.\n", stats.tile_rows, stats.tile_cols, stats.panel,
+               opts->memory);
+        printf("Wrote the %dx%d matrix C to %s.\n", M, N, opts->output);
+        printf("Local multiply time: %.6f seconds with %d threads per process.\n",
+               max_compute_time, matrix_threads());
+        printf("I/O wait time: %.6f seconds.\n", max_wait_time);
+        printf("Out-of-core time: %.6f seconds.\n", max_loop_time);
     }
+
+    MPI_Comm_free(&cart_comm);
+    return 0;
 }
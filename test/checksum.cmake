@@ -0,0 +1,77 @@
+#
+# MIT License
+#
+# Copyright (c) 2019 Philip Kovacs
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# Run REFERENCE and COMMAND, lists of a command and its arguments in which
+# empty items are dropped, and check that they compute the same C. With
+# OUTPUT and REFERENCE_OUTPUT the two binary files of C must match;
+# otherwise every checksum of C that COMMAND prints, one per product of a
+# batch, must match the one of REFERENCE.
+#
+# usage: cmake -DREFERENCE=... -DCOMMAND=... [-DREFERENCE_OUTPUT=...
+#        -DOUTPUT=...] -P checksum.cmake
+#
+
+# Run a command and return the checksums of C it prints
+function(run_checksums command result)
+    list(REMOVE_ITEM command "")
+    execute_process(COMMAND ${command}
+        RESULT_VARIABLE status
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE out)
+    if(NOT status EQUAL 0)
+        string(REPLACE ";" " " line "${command}")
+        message(FATAL_ERROR "${line} failed (${status}):\n${out}")
+    endif()
+    string(REGEX MATCHALL "[Cc]hecksum of C[^:]*: [0-9a-f]+" lines "${out}")
+    set(digests "")
+    foreach(line IN LISTS lines)
+        string(REGEX REPLACE ".*: " "" digest "${line}")
+        list(APPEND digests ${digest})
+    endforeach()
+    set(${result} ${digests} PARENT_SCOPE)
+endfunction()
+
+run_checksums("${REFERENCE}" expected)
+run_checksums("${COMMAND}" actual)
+
+if(DEFINED OUTPUT)
+    file(SHA256 ${REFERENCE_OUTPUT} expected)
+    file(SHA256 ${OUTPUT} actual)
+    if(NOT actual STREQUAL expected)
+        message(FATAL_ERROR "${OUTPUT} differs from ${REFERENCE_OUTPUT}")
+    endif()
+    return()
+endif()
+
+list(LENGTH expected count)
+if(NOT count EQUAL 1 OR NOT actual)
+    message(FATAL_ERROR "No checksums to compare: ${expected} and ${actual}")
+endif()
+foreach(digest IN LISTS actual)
+    if(NOT digest STREQUAL expected)
+        message(FATAL_ERROR "Checksum ${digest} differs from ${expected}")
+    endif()
+endforeach()
+message(STATUS "Checksums match: ${expected}")
@@ -0,0 +1,267 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Philip Kovacs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Check matrix_gemm against the textbook triple loop for every element type
+ * and every micro-kernel the CPU runs, blocked and with Strassen-Winograd,
+ * alone and with threads sharing the multiply, on ragged sizes that leave
+ * partial micro-tiles and cache blocks, with padded leading dimensions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <complex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmatrix/gemm.h"
+#include "libmatrix/threads.h"
+#include "libmatrix/types.h"
+
+/*
+ * Row padding of A, B and C, whose elements the multiply must not touch.
+ */
+#define PAD 3
+
+/*
+ * M x N x K shapes: single elements, partial micro-tiles, and more than one
+ * GEMM_MC block of rows and GEMM_KC block of the inner dimension.
+ */
+static const int shapes[][3] = {
+    { 1, 1, 1 },
+    { 7, 5, 3 },
+    { 33, 17, 65 },
+    { 97, 45, 257 },
+    { 130, 301, 270 },
+};
+
+/*
+ * Strassen-Winograd cutoff small enough to split the larger shapes, with
+ * odd halves, more than once.
+ */
+#define STRASSEN_CUTOFF 16
+
+/*
+ * Thread counts; 3 leaves the threads uneven shares of the slivers.
+ */
+static const int threads[] = { 1, 3 };
+
+static const char *const kernels[] = { "scalar", "sse4.1", "avx2", "avx512" };
+
+#define TYPE_NAME(id, type, mpi) #id,
+static const char *const type_names[] = {
+    MATRIX_TYPES(TYPE_NAME)
+    MATRIX_QTYPES(TYPE_NAME)
+};
+#undef TYPE_NAME
+
+/*
+ * Hash element i of the matrix numbered seed (splitmix64).
+ */
+static uint64_t hash(uint64_t seed, uint64_t i)
+{
+    uint64_t z = seed * 0x9e3779b97f4a7c15ULL + i;
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * C += AB by the triple loop, with C of the accumulating type of A and B.
+ */
+#define REFERENCE(id, type, acc)                                        \
+    static void reference_##id(int M, int N, int K, const void *A,      \
+                               int lda, const void *B, int ldb, void *C, \
+                               int ldc)                                 \
+    {                                                                   \
+        const type *a = A, *b = B;                                      \
+        acc *c = C;                                                     \
+        int i, j, k;                                                    \
+                                                                        \
+        for (i = 0; i < M; ++i) {                                       \
+            for (j = 0; j < N; ++j) {                                   \
+                acc sum = c[(size_t)i * ldc + j];                       \
+                for (k = 0; k < K; ++k) {                               \
+                    sum += (acc)a[(size_t)i * lda + k]                  \
+                         * (acc)b[(size_t)k * ldb + j];                 \
+                }                                                       \
+                c[(size_t)i * ldc + j] = sum;                           \
+            }                                                           \
+        }                                                               \
+    }
+#define REFERENCE_TYPE(id, type, mpi) REFERENCE(id, type, type)
+#define REFERENCE_QTYPE(id, type, mpi) REFERENCE(id, type, int)
+MATRIX_TYPES(REFERENCE_TYPE)
+MATRIX_QTYPES(REFERENCE_QTYPE)
+#undef REFERENCE_TYPE
+#undef REFERENCE_QTYPE
+#undef REFERENCE
+
+/*
+ * The squared difference of two elements of C.
+ */
+#define DIFFERENCE(id, acc)                                             \
+    static double difference_##id(const void *x, const void *y)         \
+    {                                                                   \
+        const acc d = *(const acc *)x - *(const acc *)y;                \
+        return (double)(d * conj(d));                                   \
+    }
+#define DIFFERENCE_TYPE(id, type, mpi) DIFFERENCE(id, type)
+#define DIFFERENCE_QTYPE(id, type, mpi) DIFFERENCE(id, int)
+MATRIX_TYPES(DIFFERENCE_TYPE)
+MATRIX_QTYPES(DIFFERENCE_QTYPE)
+#undef DIFFERENCE_TYPE
+#undef DIFFERENCE_QTYPE
+#undef DIFFERENCE
+
+struct reference {
+    void (*multiply)(int M, int N, int K, const void *A, int lda,
+                     const void *B, int ldb, void *C, int ldc);
+    double (*difference)(const void *x, const void *y);
+};
+
+#define REFERENCE_ENTRY(id, type, mpi) { reference_##id, difference_##id },
+static const struct reference references[] = {
+    MATRIX_TYPES(REFERENCE_ENTRY)
+    MATRIX_QTYPES(REFERENCE_ENTRY)
+};
+#undef REFERENCE_ENTRY
+
+/*
+ * Fill a matrix of rows with row stride ld, padding included, with random
+ * elements.
+ */
+static void fill(const struct matrix_type *type, uint64_t seed, int rows,
+                 int ld, char *x)
+{
+    size_t i;
+
+    for (i = 0; i < (size_t)rows * ld; ++i) {
+        type->random(hash(seed, i), x + i * type->size);
+    }
+}
+
+/*
+ * Largest squared error allowed in an element of C of an inner dimension
+ * of K: rounding for the reals, none for the integers.
+ */
+static double tolerance(const struct matrix_type *type, int K)
+{
+    switch (type->id) {
+    case MATRIX_float:
+        return (1e-5 * K) * (1e-5 * K);
+    case MATRIX_double:
+    case MATRIX_cdouble:
+        return (1e-12 * K) * (1e-12 * K);
+    default:
+        return 0.0;
+    }
+}
+
+/*
+ * Multiply one shape of type both ways and count the elements of C,
+ * padding included, that differ.
+ */
+static int check(const struct matrix_type *type, int M, int N, int K)
+{
+    const struct matrix_type *acc = type->acc;
+    const struct reference *ref = &references[type->id];
+    const int lda = K + PAD, ldb = N + PAD, ldc = N + PAD;
+    const double tol = tolerance(type, K);
+    char *A, *B, *C, *R;
+    size_t i;
+    int errors = 0;
+
+    A = malloc((size_t)M * lda * type->size);
+    B = malloc((size_t)K * ldb * type->size);
+    C = malloc((size_t)M * ldc * acc->size);
+    R = malloc((size_t)M * ldc * acc->size);
+    assert(A != NULL && B != NULL && C != NULL && R != NULL);
+    fill(type, 1, M, lda, A);
+    fill(type, 2, K, ldb, B);
+    fill(acc, 3, M, ldc, C);
+    memcpy(R, C, (size_t)M * ldc * acc->size);
+
+    matrix_gemm(type, M, N, K, A, lda, B, ldb, C, ldc);
+    ref->multiply(M, N, K, A, lda, B, ldb, R, ldc);
+
+    for (i = 0; i < (size_t)M * ldc; ++i) {
+        if (ref->difference(C + i * acc->size, R + i * acc->size) > tol) {
+            ++errors;
+        }
+    }
+    free(A);
+    free(B);
+    free(C);
+    free(R);
+    return errors;
+}
+
+int main(void)
+{
+    const struct matrix_type *type;
+    size_t k, n, t, s;
+    int strassen, errors, failures = 0;
+
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (matrix_gemm_set_kernel(kernels[k]) != 0) {
+            printf("Skipping the %s micro-kernel, which this CPU lacks.\n",
+                   kernels[k]);
+            continue;
+        }
+        for (n = 0; n < sizeof(type_names) / sizeof(type_names[0]); ++n) {
+            type = matrix_type_find(type_names[n]);
+            assert(type != NULL);
+            for (t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+                matrix_threads_init(threads[t], 0);
+                for (strassen = 0; strassen <= STRASSEN_CUTOFF;
+                     strassen += STRASSEN_CUTOFF) {
+                    matrix_gemm_set_strassen(strassen);
+                    for (s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+                        errors = check(type, shapes[s][0], shapes[s][1],
+                                       shapes[s][2]);
+                        if (errors > 0) {
+                            printf("FAIL %s %s%s %d threads %dx%dx%d: "
+                                   "%d elements differ\n", kernels[k],
+                                   type->name, strassen ? " strassen" : "",
+                                   threads[t], shapes[s][0], shapes[s][1],
+                                   shapes[s][2], errors);
+                            ++failures;
+                        }
+                    }
+                }
+            }
+            printf("Checked %s on the %s micro-kernel.\n", type->name,
+                   kernels[k]);
+        }
+    }
+    return failures > 0;
+}